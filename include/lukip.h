@@ -11,6 +11,7 @@
 #include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "../src/lukip_assert.h"
 
@@ -19,6 +20,45 @@
 /** Must be called first before other Lukip macros to initialize the framework. */
 #define LUKIP_INIT() (init_lukip())
 
+/**
+ * @brief Initializes the framework like LUKIP_INIT(), but also reads options from main's arguments.
+ * 
+ * Arguments Lukip doesn't know are left alone for the program. The known ones are:
+ * --failed-first: Runs the tests which failed last time before the rest.
+ * --only-failed: Only runs the tests which failed last time.
+ * --stop-early: Skips every test after the first one that fails.
+ * --skip-unchanged: Skips tests that passed last time if their inputs didn't change.
+ * --cache-file=PATH: Keeps the results between runs in PATH instead of ".lukip_cache".
+ * --no-cache: Doesn't read or save results between runs.
+ * --seed=N: Generates the same cases of properties as the run which printed that seed.
+ * --jobs=N: Runs the cases of properties (and rows of tables) on N threads instead of one per core.
+ * --fuzz-dir=PATH: Keeps the inputs of fuzz tests in PATH instead of "fuzz".
+ * --fuzz-time=SECONDS: How long each fuzz test gets fuzzed for in fuzzing builds (10 by default).
+ * --fuzz-runs=N: The most inputs each fuzz test tries in fuzzing builds.
+ * 
+ * @param argc main's argc.
+ * @param argv main's argv.
+ */
+#define LUKIP_INIT_ARGS(argc, argv) (init_lukip_args(argc, argv))
+
+/**
+ * @brief Adds a file which every test's cached result depends on (for --skip-unchanged).
+ * 
+ * A test's source file and the object file next to it are always checked,
+ * so this is for the rest of what it links against, like ADD_DEPENDENCY("src/parser.o").
+ * 
+ * @param path The file's path (should be a string literal or otherwise outlive the tests).
+ */
+#define ADD_DEPENDENCY(path) (lkp_add_dependency(path))
+
+/**
+ * @brief Runs the tests that are waiting to be reordered (like with --failed-first).
+ * 
+ * This already happens by itself at the end of the program, when a suite ends
+ * and when LUKIP_STATUS() is called, so it's only needed to run them at a specific point.
+ */
+#define RUN_TESTS() (lkp_run_tests())
+
 /** Declares a test case function (should be run later). */
 #define TEST_CASE(name) void name()
 
@@ -64,6 +104,107 @@
 /** Makes both a new setup and teardown at once. */
 #define MAKE_FIXTURE(setupFunc, teardownFunc) (lkp_make_fixture(setupFunc, teardownFunc))
 
+/** Declares a function that is to be used as a one-time setup of a whole suite. */
+#define DECLARE_SUITE_SETUP(name) void name()
+
+/** Declares a one-time suite setup only visible in the current translation unit. */
+#define PRIVATE_DECLARE_SUITE_SETUP(name) static DECLARE_SUITE_SETUP(name)
+
+/** Declares a function that is to be used as a one-time teardown of a whole suite. */
+#define DECLARE_SUITE_TEARDOWN(name) void name()
+
+/** Declares a one-time suite teardown only visible in the current translation unit. */
+#define PRIVATE_DECLARE_SUITE_TEARDOWN(name) static DECLARE_SUITE_TEARDOWN(name)
+
+/**
+ * @brief Declares a one-time setup of a suite, which gets a pointer to the suite's fixture.
+ * 
+ * @param name The setup's name.
+ * @param type The type of the fixture (a struct usually), passed as "type *fixture".
+ */
+#define SUITE_SETUP(name, type) LKP_FIXTURE_FUNC(, name, type)
+
+/** Declares a one-time teardown of a suite, which gets a pointer to the suite's fixture. */
+#define SUITE_TEARDOWN(name, type) LKP_FIXTURE_FUNC(, name, type)
+
+/** Declares a setup that's called before every test of a suite with the suite's fixture. */
+#define FIXTURE_SETUP(name, type) LKP_FIXTURE_FUNC(, name, type)
+
+/** Declares a teardown that's called after every test of a suite with the suite's fixture. */
+#define FIXTURE_TEARDOWN(name, type) LKP_FIXTURE_FUNC(, name, type)
+
+/** Declares a test case which gets a pointer to its suite's fixture (run with TEST_FIXTURE). */
+#define FIXTURE_TEST_CASE(name, type) LKP_FIXTURE_FUNC(, name, type)
+
+/** Declares a fixture test case only visible in the current translation unit. */
+#define PRIVATE_FIXTURE_TEST_CASE(name, type) LKP_FIXTURE_FUNC(static, name, type)
+
+/**
+ * @brief Defines name as a LkpFixtureFunc, which converts its fixture to type * for the body.
+ * 
+ * The body following the macro becomes a separate static function taking "type *fixture",
+ * so fixture functions are never called through a cast function pointer.
+ */
+#define LKP_FIXTURE_FUNC(linkage, name, type) \
+    static void lkp_fixture_body_##name(type *fixture); \
+    linkage void name(void *lkpFixture) { lkp_fixture_body_##name(lkpFixture); } \
+    static void lkp_fixture_body_##name(type *fixture)
+
+/**
+ * @brief Starts a suite of tests which share one fixture.
+ * 
+ * Lukip allocates a zeroed fixture of the passed type and calls the suite setup on it once.
+ * Every TEST_FIXTURE() until END_SUITE() then gets a pointer to that same fixture.
+ * Suites can be nested, and the global setup/teardown still run around every test.
+ * 
+ * @param type The type of the fixture.
+ * @param suiteSetup Declared with SUITE_SETUP() (can be NULL).
+ * @param suiteTeardown Declared with SUITE_TEARDOWN(), called at END_SUITE() (can be NULL).
+ */
+#define BEGIN_SUITE(type, suiteSetup, suiteTeardown) \
+    (lkp_begin_suite(sizeof(type), suiteSetup, suiteTeardown))
+
+/** Sets the FIXTURE_SETUP() and FIXTURE_TEARDOWN() called around every test of the suite. */
+#define MAKE_SUITE_FIXTURE(setupFunc, teardownFunc) \
+    (lkp_make_suite_fixture(setupFunc, teardownFunc))
+
+/** Ends the current suite, which calls its teardown and frees its fixture. */
+#define END_SUITE() (lkp_end_suite())
+
+/**
+ * @brief Tests the passed function with the current suite's fixture.
+ * 
+ * @param funcToTest A test declared with FIXTURE_TEST_CASE().
+ */
+#define TEST_FIXTURE(funcToTest) \
+    (lkp_test_fixture_func(funcToTest, #funcToTest, LKP_LINE_INFO))
+
+/**
+ * @brief Runs every following test in its own forked process.
+ * 
+ * A test which crashes, exits or hangs then only fails itself instead of the whole program,
+ * and can't leak its changes to global state into later tests.
+ * Setting the LUKIP_ISOLATE environment variable to 1 does the same from the start.
+ * 
+ * @note Isolation needs fork(), so tests just run in-process on other platforms.
+ */
+#define ENABLE_ISOLATION() (lkp_set_isolation(true))
+
+/** Goes back to running tests in the main process. */
+#define DISABLE_ISOLATION() (lkp_set_isolation(false))
+
+/**
+ * @brief Turns this process into a "zygote" that every following test is forked from.
+ * 
+ * The suite setup is called once right away, so expensive state (loaded data, warm caches...)
+ * gets built once, then every test starts from a pristine copy of it thanks to copy-on-write.
+ * The usual setup and teardown still run around every test, inside of its child process.
+ * 
+ * @param suiteSetup The one-time setup (can be NULL).
+ * @param suiteTeardown Called once at the end of the program (can be NULL).
+ */
+#define MAKE_ZYGOTE(suiteSetup, suiteTeardown) (lkp_make_zygote(suiteSetup, suiteTeardown))
+
 /** Makes setup nothing. */
 #define RESET_SETUP() (lkp_make_setup(NULL))
 
@@ -80,7 +221,619 @@
  * 
  * @note The passed function should have no parameters or return value.
  */
-#define TEST(funcToTest) (lkp_test_func(funcToTest, LKP_LINE_INFO))
+#define TEST(funcToTest) (lkp_test_func(funcToTest, #funcToTest, LKP_LINE_INFO))
+
+/**
+ * @brief Tests the passed function, but skips it as a failure if it runs for too long.
+ * 
+ * @param funcToTest The function to unit-test.
+ * @param milliseconds How long the test's body can run for.
+ * 
+ * @note Timeouts need POSIX signals, they're ignored on other platforms.
+ * @note Unless the test runs isolated, the timeout jumps out of whatever it was doing,
+ * so a lock it held (like malloc's) stays held for the rest of the process.
+ */
+#define TEST_TIMEOUT(funcToTest, milliseconds) \
+    (lkp_test_func_timeout(funcToTest, #funcToTest, milliseconds, LKP_LINE_INFO))
+
+/**
+ * @brief Sets the timeout of every test that doesn't have its own.
+ * 
+ * The default comes from the LUKIP_TIMEOUT_MS environment variable, or no timeout if it's unset.
+ * 
+ * @param milliseconds The timeout, or 0 to let tests run forever.
+ */
+#define SET_DEFAULT_TIMEOUT(milliseconds) (lkp_set_default_timeout(milliseconds))
+
+/**
+ * @brief Declares a property, which is a test that gets run with many generated inputs.
+ * 
+ * The inputs come from the GEN_*() macros inside of it, and the asserts work as usual.
+ * A property can be called from several threads at once, so it shouldn't change global state.
+ */
+#define PROPERTY_CASE(name) void name(LkpGen *lkpGen)
+
+/** Declares a property only visible in the current translation unit. */
+#define PRIVATE_PROPERTY_CASE(name) static PROPERTY_CASE(name)
+
+/**
+ * @brief Tests a property against generated cases, spread over every core.
+ * 
+ * Once a case fails, it's shrunk into the simplest inputs that still fail,
+ * which are reported as a single failure along with the seed that reproduces them (--seed=N).
+ * 
+ * @param property A property declared with PROPERTY_CASE().
+ * @param cases How many cases to generate.
+ */
+#define TEST_PROPERTY(property, cases) \
+    (lkp_test_property(property, #property, cases, LKP_LINE_INFO))
+
+/**
+ * @brief Declares a fuzz test, which gets called with the bytes of an input.
+ * 
+ * @param name The fuzz test's name, which is also the name of the directory its inputs are in.
+ * @param data The name of the input's bytes parameter (const uint8_t *).
+ * @param size The name of the input's size parameter (const size_t).
+ */
+#define FUZZ_CASE(name, data, size) void name(const uint8_t *data, const size_t size)
+
+/** Declares a fuzz test only visible in the current translation unit. */
+#define PRIVATE_FUZZ_CASE(name, data, size) static FUZZ_CASE(name, data, size)
+
+/**
+ * @brief Runs a fuzz test on the empty input and every input saved for it.
+ * 
+ * The inputs are the corpus in "fuzz/<name>/corpus" and the reproducers of old failures
+ * in "fuzz/<name>/crashes", so they double as regression tests.
+ * Builds made with "make fuzz" (LKP_FUZZ) then mutate new inputs for --fuzz-time seconds,
+ * keep the ones which reach new edges, and save the first one that fails (or crashes).
+ * The default timeout applies to each input, rather than the whole fuzz test.
+ * 
+ * @param funcToTest A fuzz test declared with FUZZ_CASE().
+ */
+#define TEST_FUZZ(funcToTest) (lkp_test_fuzz(funcToTest, #funcToTest, LKP_LINE_INFO))
+
+/** Generates an integer between min and max (inclusive) inside of a property. */
+#define GEN_INT(min, max) (lkp_gen_int(lkpGen, min, max))
+
+/** Generates a floating number between min and max inside of a property. */
+#define GEN_FLOAT(min, max) (lkp_gen_float(lkpGen, min, max))
+
+/**
+ * @brief Fills a buffer with up to maxLength random bytes inside of a property.
+ * 
+ * @return How many bytes were generated.
+ */
+#define GEN_BYTES(buffer, maxLength) (lkp_gen_bytes(lkpGen, buffer, maxLength))
+
+/**
+ * @brief Fills a buffer with a printable string up to maxLength long inside of a property.
+ * 
+ * The buffer has to fit maxLength + 1 characters, for the NUL terminator.
+ * 
+ * @return The string's length.
+ */
+#define GEN_STRING(buffer, maxLength) (lkp_gen_string(lkpGen, buffer, maxLength))
+
+/**
+ * @brief Declares the generator of a differential test's inputs, using the GEN_*() macros.
+ * 
+ * @param name The generator's name.
+ * @param inputType The type of the input both implementations take (as const inputType *).
+ * @param outputType The type of the output both implementations write (as outputType *).
+ * @param input The name of the input parameter to fill.
+ */
+#define DIFFERENTIAL_GENERATOR(name, inputType, outputType, input) \
+    typedef inputType name##_input_type; \
+    typedef outputType name##_output_type; \
+    static void lkp_generator_body_##name(LkpGen *lkpGen, inputType *input); \
+    void name(LkpGen *lkpGen, void *lkpInput) { lkp_generator_body_##name(lkpGen, lkpInput); } \
+    static void lkp_generator_body_##name(LkpGen *lkpGen, inputType *input)
+
+/**
+ * @brief Declares a differential test of a reference implementation against a fast one.
+ * 
+ * Both implementations are functions like "void func(const inputType *, outputType *)",
+ * and their outputs (zeroed before every call) are compared byte by byte.
+ * 
+ * @param reference The implementation that's known to be right.
+ * @param fast The implementation being checked against it.
+ * @param generator A generator declared with DIFFERENTIAL_GENERATOR().
+ */
+#define DIFFERENTIAL_CASE(reference, fast, generator) \
+    LKP_DIFFERENTIAL_CASE(reference, fast, generator, -1)
+
+/**
+ * @brief Declares a differential test like DIFFERENTIAL_CASE(), whose outputs are floats.
+ * 
+ * The output type is compared as an array of doubles, which only have to be equal within places.
+ */
+#define DIFFERENTIAL_FLOATS_CASE(reference, fast, generator, places) \
+    LKP_DIFFERENTIAL_CASE(reference, fast, generator, places)
+
+/** Defines a differential test, comparing bytes if places is -1. */
+#define LKP_DIFFERENTIAL_CASE(reference, fast, generator, places) \
+    LKP_DIFF_THUNK(lkp_reference_##reference##_vs_##fast, reference, generator) \
+    LKP_DIFF_THUNK(lkp_fast_##reference##_vs_##fast, fast, generator) \
+    static const LkpDifferential reference##_vs_##fast = { \
+        lkp_reference_##reference##_vs_##fast, lkp_fast_##reference##_vs_##fast, generator, \
+        #reference, #fast, sizeof(generator##_input_type), sizeof(generator##_output_type), \
+        places \
+    }
+
+/** Defines a LkpDiffFunc calling an implementation with its generator's input and output types. */
+#define LKP_DIFF_THUNK(name, implementation, generator) \
+    static void name(const void *lkpInput, void *lkpOutput) { \
+        const generator##_input_type *lkpTypedInput = lkpInput; \
+        generator##_output_type *lkpTypedOutput = lkpOutput; \
+        implementation(lkpTypedInput, lkpTypedOutput); \
+    }
+
+/**
+ * @brief Compares the implementations of a differential test on generated inputs, over every core.
+ * 
+ * Inputs are run through each implementation in batches, so their throughputs get printed
+ * along with how many times as fast the fast one was. The first input they disagree on is
+ * shrunk like a property's, and reported with the seed that reproduces it.
+ * 
+ * @param reference The reference implementation of a DIFFERENTIAL_CASE().
+ * @param fast The fast implementation of the same DIFFERENTIAL_CASE().
+ * @param cases How many inputs to generate.
+ */
+#define TEST_DIFFERENTIAL(reference, fast, cases) \
+    (lkp_test_differential(&reference##_vs_##fast, #reference " vs " #fast, cases, LKP_LINE_INFO))
+
+/**
+ * @brief Declares a parameterized test, which gets called with every row of a file.
+ * 
+ * The row's values come from the ROW_*() macros inside of it, and the asserts work as usual.
+ * Rows run on several threads at once, so the test shouldn't change global state.
+ */
+#define PARAM_TEST_CASE(name) void name(const LkpRow *lkpRow)
+
+/** Declares a parameterized test only visible in the current translation unit. */
+#define PRIVATE_PARAM_TEST_CASE(name) static PARAM_TEST_CASE(name)
+
+/**
+ * @brief Runs a parameterized test on every row of a CSV file.
+ * 
+ * Every line is a row whose fields are split on commas (or in double quotes to have commas),
+ * except for empty lines and ones starting with '#', which can be used for a header.
+ * The file is streamed in chunks over every core instead of being loaded,
+ * and each failing row is reported with its index (starting from 0).
+ * 
+ * @param funcToTest A test declared with PARAM_TEST_CASE().
+ * @param path The CSV file.
+ */
+#define TEST_PARAMS_CSV(funcToTest, path) \
+    (lkp_test_params(funcToTest, #funcToTest, path, 0, LKP_LINE_INFO))
+
+/**
+ * @brief Runs a parameterized test on every record of a binary file.
+ * 
+ * The file is an array of recordType, like one written with fwrite(),
+ * and each record is a row which ROW_RECORD() returns.
+ * 
+ * @param funcToTest A test declared with PARAM_TEST_CASE().
+ * @param path The binary file.
+ * @param recordType The type of every record in the file.
+ */
+#define TEST_PARAMS_BINARY(funcToTest, path, recordType) \
+    (lkp_test_params(funcToTest, #funcToTest, path, sizeof(recordType), LKP_LINE_INFO))
+
+/** Returns how many fields the current CSV row has. */
+#define ROW_FIELDS() (lkp_row_fields(lkpRow))
+
+/** Returns a field (starting from 0) of the current CSV row as an integer. */
+#define ROW_INT(field) (lkp_row_int(lkpRow, field, LKP_LINE_INFO))
+
+/** Returns a field (starting from 0) of the current CSV row as a float. */
+#define ROW_FLOAT(field) (lkp_row_float(lkpRow, field, LKP_LINE_INFO))
+
+/**
+ * @brief Copies a field (starting from 0) of the current CSV row into a buffer as a string.
+ * 
+ * @return The field's length, or -1 if it didn't fit (which fails the row).
+ */
+#define ROW_STRING(field, buffer, size) (lkp_row_string(lkpRow, field, buffer, size, LKP_LINE_INFO))
+
+/** Returns a pointer to the current row's record in a binary file, as a const recordType *. */
+#define ROW_RECORD(recordType) \
+    ((const recordType *)lkp_row_record(lkpRow, sizeof(recordType), LKP_LINE_INFO))
+
+/**
+ * @brief Runs a test, then reruns it once per allocation site it hit, with that site failing.
+ * 
+ * The first run records where the test allocates from (with nothing failing),
+ * then each rerun makes the first allocation from one of those sites return NULL.
+ * Failures of a rerun are prefixed with the site, as an offset for "addr2line -e <program>".
+ * Pair it with ENABLE_ISOLATION() so a rerun that crashes only fails itself.
+ * 
+ * @param funcToTest The test, which should handle running out of memory gracefully.
+ */
+#define EXHAUSTIVE_ALLOC_FAILURE(funcToTest) \
+    (lkp_test_exhaustive_alloc(funcToTest, #funcToTest, LKP_LINE_INFO))
+
+/**
+ * @brief Makes the nth allocation from now (starting from 1) return NULL, until the test ends.
+ * 
+ * Needs the program linked with -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,
+ * and fails the test otherwise. Lukip's own allocations never fail.
+ */
+#define FAIL_NTH_ALLOCATION(nth) (lkp_inject_allocation_failure(nth, LKP_LINE_INFO))
+
+/** Makes a fraction (0 to 1) of allocations return NULL until the test ends, seeded by --seed. */
+#define FAIL_RANDOM_ALLOCATIONS(fraction) \
+    (lkp_inject_random_allocation_failures(fraction, LKP_LINE_INFO))
+
+/** Lets every allocation through again. */
+#define STOP_FAILING_ALLOCATIONS() (lkp_stop_failing_allocations())
+
+/** Returns how many allocations were made to fail since the failures were last set up. */
+#define FAILED_ALLOCATIONS() (lkp_failed_allocations())
+
+/**
+ * @brief Freezes the program's clocks at the current time until the test's body ends.
+ * 
+ * clock_gettime(), gettimeofday() and time() then only move when the clock is advanced,
+ * and sleeping (nanosleep(), usleep() and sleep()) advances it instantly instead of waiting.
+ * Sleeps on other threads wait until ADVANCE_TIME() moves the clock past their end.
+ * Needs the program linked with the wrapped clock functions (see LKP_CLOCK_WRAP_FLAGS),
+ * and fails the test otherwise. CPU time clocks are never virtual.
+ */
+#define START_VIRTUAL_CLOCK() (lkp_use_virtual_clock(LKP_LINE_INFO))
+
+/** Moves the virtual clock forward, returning once every sleep it ended has returned. */
+#define ADVANCE_TIME(milliseconds) (lkp_advance_virtual_clock(milliseconds, LKP_LINE_INFO))
+
+/** Goes back to the real clocks before the test's body ends, waking any virtual sleeps. */
+#define STOP_VIRTUAL_CLOCK() (lkp_stop_virtual_clock())
+
+/**
+ * @brief Keeps every file whose path starts with the prefix in memory until the test's body ends.
+ * 
+ * Files opened with open() under the prefix start out missing, and are backed by memfds
+ * so they run at memory speed. Only open(), read(), write(), fsync() and close() are wrapped,
+ * so fopen(), stat(), unlink() and the like still see the real disk.
+ * Needs the program linked with the wrapped I/O functions (see LKP_IO_WRAP_FLAGS),
+ * and fails the test otherwise.
+ */
+#define FAKE_FILES(prefix) (lkp_use_fake_files(prefix, LKP_LINE_INFO))
+
+/**
+ * @brief Makes a call on files whose path starts with the prefix fail until the test ends.
+ * 
+ * Only files opened after it (or after FAKE_FILES()) are matched, where "" matches all of them.
+ * 
+ * @param operation OPEN, READ, WRITE, FSYNC or CLOSE (close() still closes the descriptor).
+ * @param prefix The start of the paths it fails for.
+ * @param nth Which matching call from now fails (starting from 1), or 0 for every one of them.
+ * @param error The errno it fails with, like ENOSPC, EIO or EINTR.
+ */
+#define FAIL_IO(operation, prefix, nth, error) \
+    (lkp_inject_io_fault(LKP_IO_##operation, prefix, nth, error, LKP_LINE_INFO))
+
+/**
+ * @brief Makes reads or writes on files whose path starts with the prefix only go partway through.
+ * 
+ * @param operation READ or WRITE.
+ * @param prefix The start of the paths it's for.
+ * @param nth Which matching call from now is cut short (starting from 1), or 0 for every one.
+ * @param bytes The most bytes the call transfers.
+ */
+#define SHORTEN_IO(operation, prefix, nth, bytes) \
+    (lkp_inject_short_io(LKP_IO_##operation, prefix, nth, bytes, LKP_LINE_INFO))
+
+/** Returns how many I/O calls were made to fail or cut short in the current test. */
+#define INJECTED_IO_FAULTS() (lkp_injected_io_faults())
+
+/**
+ * @brief Makes a scripted peer that stands in for a network service, usually in a DECLARE_SETUP().
+ * 
+ * Its script is built with the PEER_*() macros, then run on its own thread by START_PEER(),
+ * and it's stopped by STOP_PEER() (usually in a DECLARE_TEARDOWN()), which fails the test
+ * if the script didn't go as expected. Only available on POSIX platforms.
+ * 
+ * @param kind SOCKETPAIR (the test gets a connected socket from PEER_FD())
+ *     or TCP (the test connects to 127.0.0.1 on PEER_PORT()).
+ */
+#define NEW_PEER(kind) (lkp_new_peer(LKP_PEER_##kind, LKP_LINE_INFO))
+
+/** Makes the peer wait for the client to send exactly this string (without its NUL). */
+#define PEER_EXPECT(peer, text) (lkp_peer_expect(peer, text, strlen(text)))
+
+/** Makes the peer wait for the client to send exactly these bytes. */
+#define PEER_EXPECT_BYTES(peer, data, size) (lkp_peer_expect(peer, data, size))
+
+/** Makes the peer send this string (without its NUL) to the client. */
+#define PEER_SEND(peer, text) (lkp_peer_send(peer, text, strlen(text)))
+
+/** Makes the peer send these bytes to the client. */
+#define PEER_SEND_BYTES(peer, data, size) (lkp_peer_send(peer, data, size))
+
+/** Makes the peer do nothing for some milliseconds. */
+#define PEER_DELAY(peer, milliseconds) (lkp_peer_delay(peer, milliseconds))
+
+/** Makes the peer wait this many milliseconds before each fragment of the sends after it. */
+#define PEER_LATENCY(peer, milliseconds) (lkp_peer_latency(peer, milliseconds))
+
+/** Splits the peer's sends after it into separate writes of at most this many bytes. */
+#define PEER_FRAGMENT(peer, bytes) (lkp_peer_fragment(peer, bytes))
+
+/** Makes the peer close the connection gracefully, ending its script. */
+#define PEER_CLOSE(peer) (lkp_peer_close(peer, false))
+
+/** Makes the peer reset the connection (RST on TCP), ending its script. */
+#define PEER_RESET(peer) (lkp_peer_close(peer, true))
+
+/** Starts running the peer's script. */
+#define START_PEER(peer) (lkp_run_peer(peer, LKP_LINE_INFO))
+
+/** Returns the test's end of a SOCKETPAIR peer, which the test closes itself. */
+#define PEER_FD(peer) (lkp_peer_fd(peer))
+
+/** Returns the port a TCP peer accepts its one connection on. */
+#define PEER_PORT(peer) (lkp_peer_port(peer))
+
+/** Stops and frees the peer, failing the test if a step failed or still waited on the client. */
+#define STOP_PEER(peer) (lkp_finish_peer(peer, LKP_LINE_INFO))
+
+/**
+ * @brief Generates a mock of a function, to be written once at file scope of a test file.
+ * 
+ * The mock replaces the function in programs linked with -Wl,--wrap=<name>, but only for calls
+ * from other object files than the one defining it. Until the mock is armed (by MOCK_RETURN(),
+ * MOCK_FAKE() or EXPECT_CALL()), calls go straight to the real function.
+ * Once armed it counts every call and records the arguments of the last LKP_MOCK_CALLS of them,
+ * and it's disarmed again at the end of the test.
+ * 
+ * @param returnType What the function returns (use MOCK_VOID_FUNC() if it's void).
+ * @param func The function's name.
+ * @param params Its parameters as type and name pairs, like (const char *, key, size_t, length),
+ *     or (void) if it has none. Array and function pointer types need a typedef.
+ */
+#define MOCK_FUNC(returnType, func, params) \
+    LKP_MOCK_STATE(returnType returned;, returnType, func, params); \
+    returnType __wrap_##func(LKP_MOCK_PARAMS params) { \
+        if (atomic_load_explicit(&func##_mock.mock.armed, memory_order_acquire)) { \
+            LKP_MOCK_RECORD(func, params); \
+            if (func##_mock.mock.behavior == LKP_MOCK_FAKE) { \
+                return func##_mock.fake(LKP_MOCK_ARGS params); \
+            } else if (func##_mock.mock.behavior == LKP_MOCK_RETURN) { \
+                return func##_mock.returned; \
+            } \
+        } \
+        return __real_##func(LKP_MOCK_ARGS params); \
+    } \
+    extern returnType __wrap_##func(LKP_MOCK_PARAMS params)
+
+/** Generates a mock of a function that returns void, like MOCK_FUNC(). */
+#define MOCK_VOID_FUNC(func, params) \
+    LKP_MOCK_STATE(, void, func, params); \
+    void __wrap_##func(LKP_MOCK_PARAMS params) { \
+        if (atomic_load_explicit(&func##_mock.mock.armed, memory_order_acquire)) { \
+            LKP_MOCK_RECORD(func, params); \
+            if (func##_mock.mock.behavior == LKP_MOCK_FAKE) { \
+                func##_mock.fake(LKP_MOCK_ARGS params); \
+                return; \
+            } else if (func##_mock.mock.behavior == LKP_MOCK_RETURN) { \
+                return; \
+            } \
+        } \
+        __real_##func(LKP_MOCK_ARGS params); \
+    } \
+    extern void __wrap_##func(LKP_MOCK_PARAMS params)
+
+/** Makes a mocked function return value until the end of the test, without calling it. */
+#define MOCK_RETURN(func, value) \
+    (func##_mock.returned = (value), \
+    lkp_arm_mock(&func##_mock.mock, LKP_MOCK_RETURN, __real_##func != NULL, LKP_LINE_INFO))
+
+/** Makes a mocked void function do nothing until the end of the test. */
+#define MOCK_IGNORE(func) \
+    (lkp_arm_mock(&func##_mock.mock, LKP_MOCK_RETURN, __real_##func != NULL, LKP_LINE_INFO))
+
+/** Makes a mocked function call a replacement with the same signature until the end of the test. */
+#define MOCK_FAKE(func, fakeFunc) \
+    (func##_mock.fake = (fakeFunc), \
+    lkp_arm_mock(&func##_mock.mock, LKP_MOCK_FAKE, __real_##func != NULL, LKP_LINE_INFO))
+
+/**
+ * @brief Expects a mocked function to be called exactly this many times by the end of the test.
+ * 
+ * If it isn't mocked otherwise, the calls still go to the real function (which makes it a spy).
+ */
+#define EXPECT_CALL(func, times) \
+    (lkp_expect_mock_calls(&func##_mock.mock, times, __real_##func != NULL, LKP_LINE_INFO))
+
+/** Returns how many times a mocked function was called since it was armed. */
+#define MOCK_CALLS(func) (atomic_load(&func##_mock.mock.calls))
+
+/**
+ * @brief Returns an argument a mocked function was called with.
+ * 
+ * Asking for a call that wasn't made (or was overwritten) fails and skips the rest of the test.
+ * 
+ * @param func The mocked function.
+ * @param call Which call since it was armed, starting from 0 (only the last LKP_MOCK_CALLS stay).
+ * @param param The name of the parameter, as it was written in MOCK_FUNC().
+ */
+#define MOCK_ARG(func, call, param) \
+    (func##_mock.calls[1 + lkp_mock_slot(&func##_mock.mock, call, LKP_LINE_INFO)].param)
+
+/** Sends a mocked function's calls back to the real one before the test ends. */
+#define RESTORE_MOCK(func) (lkp_disarm_mock(&func##_mock.mock))
+
+/**
+ * @brief Asserts that a statement dies the expected way, without taking the tests down with it.
+ * 
+ * The statement runs in a forked child (whose exit() doesn't print a report), and the parent
+ * records how it ended as an assert of the current test. It gets LKP_DEATH_TIMEOUT ms to die.
+ * Where there's no fork(), it's skipped with a warning.
+ * 
+ * @param statement The statement, like abort_on_corruption(&header).
+ * @param death KILLED_BY(signal), EXITED_WITH(status) or ANY_DEATH.
+ * @param stderrPattern An extended regex that what it wrote to stderr should contain,
+ *     or NULL for anything.
+ */
+#define ASSERT_DEATH(statement, death, stderrPattern) \
+    do { \
+        LkpDeathChild lkpDeathChild; \
+        if (lkp_fork_death(&lkpDeathChild)) { \
+            statement; \
+            lkp_survive_death(&lkpDeathChild); \
+        } \
+        lkp_verify_death(&lkpDeathChild, death, stderrPattern, #statement, LKP_LINE_INFO); \
+    } while (false)
+
+/** A death test's statement getting killed by a signal, like KILLED_BY(SIGABRT). */
+#define KILLED_BY(signal) (-(signal))
+
+/** A death test's statement exiting with a status, like EXITED_WITH(2). */
+#define EXITED_WITH(status) (status)
+
+/** A death test's statement dying in any way. */
+#define ANY_DEATH LKP_ANY_DEATH
+
+/**
+ * Asserts that the test's body caused at most max page faults (minor and major) so far.
+ * Only the faults of the thread running the body count, where the system can tell them apart.
+ * Inside of a generated case (properties, rows...), they only count since the case started.
+ */
+#define ASSERT_MAX_PAGE_FAULTS(max) (lkp_verify_page_faults(max, LKP_LINE_INFO))
+
+/** Asserts that the test's body was switched out at most max times (waiting or preempted). */
+#define ASSERT_MAX_CONTEXT_SWITCHES(max) (lkp_verify_context_switches(max, LKP_LINE_INFO))
+
+/**
+ * @brief Keeps the compiler from optimizing a value (and the work computing it) away.
+ * 
+ * A timed statement whose result isn't used otherwise can be removed by the optimizer,
+ * which leaves an empty loop to time. Passing the result through this is a statement itself,
+ * like LKP_DO_NOT_OPTIMIZE(lookup(table, key)), and works for numbers and pointers.
+ * A pointer also makes everything written through it count as used.
+ * 
+ * @param value The value to keep.
+ */
+#if defined(__GNUC__)
+    #define LKP_DO_NOT_OPTIMIZE(value) \
+        do { \
+            __asm__ volatile("" : : "g"(value) : "memory"); \
+        } while (false)
+#else
+    #define LKP_DO_NOT_OPTIMIZE(value) \
+        do { \
+            static volatile int lkpSink; \
+            lkpSink = (value) != 0; \
+            (void)lkpSink; \
+        } while (false)
+#endif
+
+/**
+ * @brief Asserts that a statement's runs take less than a budget at some percentile.
+ * 
+ * The statement runs iterations times on the real monotonic clock (even under a virtual clock),
+ * after a tenth as many untimed warmup runs. The clock's own overhead is measured first
+ * and taken off of every run. Failures show the distribution of the runs.
+ * Its result has to be used, or go through LKP_DO_NOT_OPTIMIZE(), for it to run at all.
+ * 
+ * @param statement The statement, like LKP_DO_NOT_OPTIMIZE(lookup(table, key)).
+ * @param percentile The percentile to compare, like 99 for p99.
+ * @param nanoseconds The budget its runs have to stay below at that percentile.
+ * @param iterations How many runs to time.
+ */
+#define ASSERT_PERCENTILE_BELOW(statement, percentile, nanoseconds, iterations) \
+    LKP_TIME_STATEMENT(statement, #statement, percentile, nanoseconds, iterations)
+
+/** Asserts that a statement's median run is under the budget, like ASSERT_PERCENTILE_BELOW. */
+#define ASSERT_DURATION_BELOW(statement, nanoseconds, iterations) \
+    LKP_TIME_STATEMENT(statement, #statement, 50, nanoseconds, iterations)
+
+/** Times a statement for the latency asserts, which name it before any macros in it expand. */
+#define LKP_TIME_STATEMENT(statement, name, percentile, nanoseconds, iterations) \
+    do { \
+        LkpLatency lkpLatency; \
+        lkp_begin_latency(&lkpLatency, iterations); \
+        while (lkp_next_sample(&lkpLatency)) { \
+            statement; \
+        } \
+        lkp_verify_latency(&lkpLatency.histogram, percentile, nanoseconds, name, LKP_LINE_INFO); \
+    } while (false)
+
+/**
+ * @brief Asserts that an operation run on many threads at once stays below a percentile budget.
+ * 
+ * Each thread times its own runs (with warmup and the clock's overhead taken off,
+ * like ASSERT_PERCENTILE_BELOW) and the threads' durations are merged once they all finished.
+ * The operation runs outside of the test's thread, so it shouldn't assert.
+ * 
+ * @param operation A void function(void *context, const int thread).
+ * @param context Passed to every run of the operation.
+ * @param threads How many threads to run it on.
+ * @param iterations How many runs to time on each thread.
+ * @param percentile The percentile to compare, like 99 for p99.
+ * @param nanoseconds The budget the runs have to stay below at that percentile.
+ */
+#define ASSERT_STRESS_PERCENTILE_BELOW( \
+    operation, context, threads, iterations, percentile, nanoseconds \
+) \
+    (lkp_verify_stress( \
+        operation, context, threads, iterations, percentile, nanoseconds, #operation, \
+        LKP_LINE_INFO \
+    ))
+
+/**
+ * @brief Declares a benchmark, which gets called with every input size of its range.
+ * 
+ * It prepares an input of size n, and times the work on it with MEASURE().
+ * 
+ * @param name The benchmark's name.
+ * @param n The name of the input size's parameter.
+ */
+#define BENCHMARK_CASE(name, n) void name(LkpBench *lkpBench, const long long n)
+
+/** Declares a benchmark only visible in the current translation unit. */
+#define PRIVATE_BENCHMARK_CASE(name, n) static BENCHMARK_CASE(name, n)
+
+/**
+ * @brief Times a statement inside of a benchmark, running it as often as its size calls for.
+ * 
+ * The runs are timed like ASSERT_PERCENTILE_BELOW's, and their median is the size's time.
+ * A statement that changes its input (like sorting it) has to prepare it again itself,
+ * and what it computes has to go through LKP_DO_NOT_OPTIMIZE() so it isn't optimized away.
+ */
+#define MEASURE(statement) \
+    do { \
+        LkpLatency lkpLatency; \
+        lkp_begin_latency(&lkpLatency, lkp_bench_iterations(lkpBench)); \
+        while (lkp_next_sample(&lkpLatency)) { \
+            statement; \
+        } \
+        lkp_bench_record(lkpBench, &lkpLatency.histogram); \
+    } while (false)
+
+/**
+ * @brief Runs a benchmark at every size from from to to, and fits its times to a complexity class.
+ * 
+ * The best fit (from O(1) up to O(n^3)) is shown with its coefficient after the tests.
+ * 
+ * @param name The benchmark.
+ * @param from The first size.
+ * @param to The largest size.
+ * @param multiplier What each size is multiplied by to get the next one.
+ */
+#define BENCHMARK_RANGE(name, from, to, multiplier) \
+    BENCHMARK_RANGE_AT_MOST(name, from, to, multiplier, LKP_O_ANY)
+
+/**
+ * @brief Runs a benchmark like BENCHMARK_RANGE(), failing it if it fits a class past complexity.
+ * 
+ * @param complexity The worst class allowed, like LKP_O_N_LOG_N.
+ */
+#define BENCHMARK_RANGE_AT_MOST(name, from, to, multiplier, complexity) \
+    (lkp_test_benchmark( \
+        name, #name, (LkpBenchRange){from, to, multiplier, complexity}, LKP_LINE_INFO \
+    ))
 
 /** 
  * Returns the current status of a lukip program. 1 if a unit failed, 0 otherwise.
@@ -873,4 +1626,40 @@
 #define ASSERT_CUSTOM(condition, ...) \
     (lkp_verify_condition((condition) == true, LKP_LINE_INFO, __VA_ARGS__))
 
+// =================================== FATAL =======================================================
+
+/**
+ * @brief Makes any Lukip assert fatal.
+ * 
+ * If the wrapped assert fails, the rest of the current test is skipped and Lukip jumps
+ * straight back to the test runner (the teardown still gets called).
+ * 
+ * @param assertion Any ASSERT_* macro, like REQUIRE(ASSERT_INT_EQUAL(length, 3)).
+ */
+#define REQUIRE(assertion) (lkp_begin_require(), (assertion), lkp_end_require())
+
+/** Like ASSERT_TRUE(), but skips the rest of the test if it fails. */
+#define REQUIRE_TRUE(val) (REQUIRE(ASSERT_TRUE(val)))
+
+/** Like ASSERT_FALSE(), but skips the rest of the test if it fails. */
+#define REQUIRE_FALSE(val) (REQUIRE(ASSERT_FALSE(val)))
+
+/** Like ASSERT_NULL(), but skips the rest of the test if it fails. */
+#define REQUIRE_NULL(val) (REQUIRE(ASSERT_NULL(val)))
+
+/** Like ASSERT_NOT_NULL(), but skips the rest of the test if it fails. */
+#define REQUIRE_NOT_NULL(val) (REQUIRE(ASSERT_NOT_NULL(val)))
+
+/** Like ASSERT_CONDITION(), but skips the rest of the test if it fails. */
+#define REQUIRE_CONDITION(condition) (REQUIRE(ASSERT_CONDITION(condition)))
+
+/** Like ASSERT_CUSTOM(), but skips the rest of the test with its message if it fails. */
+#define REQUIRE_CUSTOM(condition, ...) (REQUIRE(ASSERT_CUSTOM(condition, __VA_ARGS__)))
+
+/** Fails the test like ASSERT_RAISE_FAIL(), and skips the rest of it. */
+#define REQUIRE_RAISE_FAIL() (REQUIRE(ASSERT_RAISE_FAIL()))
+
+/** Fails the test with a message like ASSERT_RAISE_FAIL_MESSAGE(), and skips the rest of it. */
+#define REQUIRE_RAISE_FAIL_MESSAGE(...) (REQUIRE(ASSERT_RAISE_FAIL_MESSAGE(__VA_ARGS__)))
+
 #endif
@@ -0,0 +1,188 @@
+/**
+ * @file lukip_alloc_failure.c
+ * @brief Wraps malloc(), calloc() and realloc() to fail some of the program's allocations.
+ * 
+ * The linker's --wrap option sends every call to malloc() from the linked objects
+ * to __wrap_malloc() instead, which can reach the real one through __real_malloc().
+ * The real functions are weak references, so programs linked without --wrap still build
+ * (they're just NULL then, and nothing ever calls the wrappers).
+ * Lukip's own allocator calls the real functions directly, so it never fails on purpose.
+ * 
+ * @author Larmix
+ */
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "lukip_alloc_failure.h"
+#include "lukip_platform.h"
+#include "lukip_property.h"
+
+/** What happens to allocations that aren't exempt. */
+typedef enum {
+    MODE_NONE,
+    MODE_RECORD, /** Records their sites. */
+    MODE_NTH, /** Fails the one whose count is the target. */
+    MODE_RANDOM, /** Fails a fraction of them. */
+    MODE_SITE /** Fails the first one from the target site. */
+} FailureMode;
+
+#ifdef LKP_WRAP_ALLOCATIONS
+
+extern void *__real_calloc(size_t count, size_t size) __attribute__((weak));
+
+/** Start of the executable, provided by the GNU linker. */
+extern char __executable_start;
+
+#define CALLER_SITE() ((uintptr_t)__builtin_return_address(0))
+#define WRAPPED_ALLOCATIONS (__real_malloc != NULL)
+
+#else
+
+#define CALLER_SITE() ((uintptr_t)0)
+#define WRAPPED_ALLOCATIONS false
+
+#endif
+
+static atomic_int mode = MODE_NONE;
+static atomic_llong allocations = 0; /** Allocations since the mode changed. */
+static atomic_llong failures = 0; /** Allocations made to fail since the mode changed. */
+static long long nthTarget = 0;
+static uint64_t randomThreshold = 0; /** Random numbers below it fail, out of 2^64. */
+static uint64_t randomSeed = 0;
+static atomic_uintptr_t siteTarget = 0; /** Set back to 0 once the site failed. */
+static _Atomic uintptr_t sites[LKP_MAX_ALLOCATION_SITES]; /** Recorded sites, 0 where unused. */
+
+/** Adds the site to the recorded ones if it's new (and there's room left). */
+static void record_site(const uintptr_t site) {
+    for (int i = 0; i < LKP_MAX_ALLOCATION_SITES; i++) {
+        uintptr_t current = atomic_load(&sites[i]);
+        if (current == site) {
+            return;
+        }
+        if (current == 0 && atomic_compare_exchange_strong(&sites[i], &current, site)) {
+            return;
+        }
+        if (current == site) {
+            return; // Another thread recorded the same site in this slot first.
+        }
+    }
+}
+
+/** Decides whether an allocation from the passed site fails, recording it if needed. */
+static bool should_fail(const uintptr_t site) {
+    const int currentMode = atomic_load_explicit(&mode, memory_order_acquire);
+    if (currentMode == MODE_NONE) {
+        return false;
+    }
+    const long long index = atomic_fetch_add(&allocations, 1) + 1;
+    bool fail = false;
+    if (currentMode == MODE_RECORD) {
+        record_site(site);
+    } else if (currentMode == MODE_NTH) {
+        fail = index == nthTarget;
+    } else if (currentMode == MODE_RANDOM) {
+        uint64_t state = randomSeed ^ ((uint64_t)index * 0xD1B54A32D192ED03ULL);
+        fail = lkp_next_random(&state) < randomThreshold;
+    } else if (currentMode == MODE_SITE) {
+        uintptr_t target = site;
+        fail = atomic_compare_exchange_strong(&siteTarget, &target, 0);
+    }
+    if (fail) {
+        atomic_fetch_add(&failures, 1);
+    }
+    return fail;
+}
+
+#ifdef LKP_WRAP_ALLOCATIONS
+
+/** Called instead of malloc() by programs linked with --wrap=malloc. */
+void *__wrap_malloc(size_t size) {
+    return should_fail(CALLER_SITE()) ? NULL : __real_malloc(size);
+}
+
+/** Called instead of calloc() by programs linked with --wrap=calloc. */
+void *__wrap_calloc(size_t count, size_t size) {
+    return should_fail(CALLER_SITE()) ? NULL : __real_calloc(count, size);
+}
+
+/** Called instead of realloc() by programs linked with --wrap=realloc (failing keeps the block). */
+void *__wrap_realloc(void *pointer, size_t size) {
+    return should_fail(CALLER_SITE()) ? NULL : __real_realloc(pointer, size);
+}
+
+#endif
+
+/** Switches to a new mode, restarting the counts. */
+static void set_mode(const FailureMode newMode) {
+    atomic_store(&mode, MODE_NONE);
+    atomic_store(&allocations, 0);
+    atomic_store(&failures, 0);
+    atomic_store(&mode, newMode);
+}
+
+/** Only true when the program was linked with --wrap, which resolves the real functions. */
+bool lkp_allocation_failures_supported() {
+    return WRAPPED_ALLOCATIONS;
+}
+
+/** Fails the nth allocation from now. */
+void lkp_fail_nth_allocation(const long long nth) {
+    atomic_store(&mode, MODE_NONE);
+    nthTarget = nth;
+    set_mode(nth > 0 ? MODE_NTH : MODE_NONE);
+}
+
+/** Fails a seeded fraction of allocations from now. */
+void lkp_fail_random_allocations(const double fraction, const uint64_t seed) {
+    atomic_store(&mode, MODE_NONE);
+    randomSeed = seed;
+    randomThreshold = fraction >= 1 ? UINT64_MAX : (uint64_t)(fraction * 18446744073709551616.0);
+    set_mode(fraction > 0 ? MODE_RANDOM : MODE_NONE);
+}
+
+/** Fails the next allocation from the site. */
+void lkp_fail_allocation_site(const uintptr_t site) {
+    atomic_store(&mode, MODE_NONE);
+    atomic_store(&siteTarget, site);
+    set_mode(MODE_SITE);
+}
+
+/** Lets every allocation through again. */
+void lkp_stop_failing_allocations() {
+    set_mode(MODE_NONE);
+}
+
+/** Clears the recorded sites, then records new ones. */
+void lkp_record_allocation_sites() {
+    atomic_store(&mode, MODE_NONE);
+    for (int i = 0; i < LKP_MAX_ALLOCATION_SITES; i++) {
+        atomic_store(&sites[i], 0);
+    }
+    set_mode(MODE_RECORD);
+}
+
+/** Copies the recorded sites out, which stop at the first unused slot. */
+int lkp_allocation_sites(uintptr_t *sitesOut) {
+    int count = 0;
+    while (count < LKP_MAX_ALLOCATION_SITES && atomic_load(&sites[count]) != 0) {
+        sitesOut[count] = atomic_load(&sites[count]);
+        count++;
+    }
+    return count;
+}
+
+/** Returns how many allocations failed since the mode changed. */
+long long lkp_failed_allocations() {
+    return atomic_load(&failures);
+}
+
+/** The return address is after the call, so 1 is taken off to land on the call itself. */
+void lkp_describe_allocation_site(const uintptr_t site, char *buffer, const size_t size) {
+#ifdef LKP_WRAP_ALLOCATIONS
+    snprintf(buffer, size, "0x%zx", (size_t)(site - 1 - (uintptr_t)&__executable_start));
+#else
+    snprintf(buffer, size, "0x%zx", (size_t)site);
+#endif
+}
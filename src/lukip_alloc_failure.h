@@ -0,0 +1,98 @@
+/**
+ * @file lukip_alloc_failure.h
+ * @brief Header for making the allocations of tests fail on purpose.
+ * 
+ * Only works when the test program is linked with LKP_WRAP_FLAGS (which "make tests" does
+ * on Linux), so calls to them from the program go through Lukip first.
+ * Allocations made inside of libc itself (like by fopen() or strdup()) aren't affected.
+ * 
+ * @author Larmix
+ */
+
+#ifndef LUKIP_ALLOC_FAILURE_H
+#define LUKIP_ALLOC_FAILURE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#if defined(__GNUC__) && defined(__linux__)
+    #define LKP_WRAP_ALLOCATIONS /** Built with a GNU linker, which has --wrap. */
+
+    extern void *__real_malloc(size_t size) __attribute__((weak));
+    extern void *__real_realloc(void *pointer, size_t size) __attribute__((weak));
+
+    /** Allocates past the wrapper if the program has one, so it never fails on purpose. */
+    #define LKP_REAL_MALLOC(size) (__real_malloc != NULL ? __real_malloc(size) : malloc(size))
+
+    /** Reallocates past the wrapper if the program has one, like LKP_REAL_MALLOC(). */
+    #define LKP_REAL_REALLOC(pointer, size) \
+        (__real_realloc != NULL ? __real_realloc(pointer, size) : realloc(pointer, size))
+#else
+    #define LKP_REAL_MALLOC(size) (malloc(size))
+    #define LKP_REAL_REALLOC(pointer, size) (realloc(pointer, size))
+#endif
+
+/** Linker flags a program needs for its allocations to be made to fail. */
+#define LKP_WRAP_FLAGS "-Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc"
+
+/** Most distinct allocation sites a test can be rerun for. */
+#define LKP_MAX_ALLOCATION_SITES 256
+
+/** Returns whether the program was linked with the wrapped allocation functions. */
+bool lkp_allocation_failures_supported();
+
+/**
+ * @brief Makes an allocation fail, counting from the next one (which is 1).
+ * 
+ * @param nth Which allocation fails, or 0 to stop failing them.
+ */
+void lkp_fail_nth_allocation(const long long nth);
+
+/**
+ * @brief Makes a random fraction of allocations fail from now on.
+ * 
+ * Whether an allocation fails only depends on the seed and how many came before it,
+ * so the same seed fails the same allocations of a deterministic test.
+ * 
+ * @param fraction The chance of every allocation failing, between 0 and 1.
+ * @param seed The seed of the random failures.
+ */
+void lkp_fail_random_allocations(const double fraction, const uint64_t seed);
+
+/**
+ * @brief Makes the next allocation from a site fail, where a site is the code calling it.
+ * 
+ * @param site The return address of the allocation, as given by lkp_allocation_sites().
+ */
+void lkp_fail_allocation_site(const uintptr_t site);
+
+/** Stops failing (or recording) allocations. */
+void lkp_stop_failing_allocations();
+
+/** Forgets the recorded sites and starts recording the site of every allocation. */
+void lkp_record_allocation_sites();
+
+/**
+ * @brief Returns the sites that were recorded, in the order they were first hit.
+ * 
+ * @param[out] sites Where the sites are written, which holds LKP_MAX_ALLOCATION_SITES.
+ * 
+ * @return How many sites there are.
+ */
+int lkp_allocation_sites(uintptr_t *sites);
+
+/** Returns how many allocations were made to fail since the last change of what fails. */
+long long lkp_failed_allocations();
+
+/**
+ * @brief Writes where an allocation site is, as an offset in the executable for addr2line.
+ * 
+ * @param site The site.
+ * @param[out] buffer Where the description is written.
+ * @param size The size of the buffer.
+ */
+void lkp_describe_allocation_site(const uintptr_t site, char *buffer, const size_t size);
+
+#endif
@@ -7,18 +7,21 @@
 
 #include <stdio.h>
 
+#include "lukip_alloc_failure.h"
 #include "lukip_allocator.h"
 
 /**
  * @brief Allocates from the heap and checks for NULL itself. 
  * 
+ * Never made to fail by the allocation failures of tests, since Lukip can't go on without memory.
+ * 
  * @param size The amount of elements to be allocated.
  * @param elementSize The size of each element.
  * 
  * @return Allocated pointer.
  */
 void *lkp_allocate(const int size, const size_t elementSize) {
-    void *result = malloc(size * elementSize);
+    void *result = LKP_REAL_MALLOC(size * elementSize);
     if (result == NULL) {
         printf("Lukip failed to allocate memory.");
         exit(1);
@@ -36,7 +39,7 @@ void *lkp_allocate(const int size, const size_t elementSize) {
  * @return The new reallocated pointer.
  */
 void *lkp_reallocate(void *pointer, const int newSize, const size_t elementSize) {
-    void *result = realloc(pointer, newSize * elementSize);
+    void *result = LKP_REAL_REALLOC(pointer, newSize * elementSize);
     if (result == NULL) {
         printf("Lukip failed to reallocate a block of memory.");
         exit(1);
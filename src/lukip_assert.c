@@ -6,6 +6,7 @@
  */
 
 #include <errno.h>
+#include <signal.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
@@ -13,7 +14,23 @@
 
 #include "lukip_dynamic_array.h"
 #include "lukip_assert.h"
+#include "lukip_benchmark.h"
+#include "lukip_cache.h"
+#include "lukip_capture.h"
+#include "lukip_coverage.h"
+#include "lukip_differential.h"
+#include "lukip_fuzz.h"
+#include "lukip_isolation.h"
+#include "lukip_leaks.h"
 #include "lukip_output.h"
+#include "lukip_params.h"
+#include "lukip_property.h"
+#include "lukip_report.h"
+#include "lukip_timeout.h"
+
+#ifdef LKP_POSIX
+#include <regex.h>
+#endif
 
 /** Increase the capacity of a dynamically growable array. */
 #define GROW_CAPACITY(capacity) ((capacity) < 16 ? 16 : (capacity) * 2)
@@ -21,11 +38,25 @@
 /** Length of our temporary, global buffer. */
 #define BUFFER_LENGTH 256
 
+/** Value passed to the test's jump buffer when a REQUIRE() failed. */
+#define JUMP_REQUIRE 1
+
+/** Value passed to the test's jump buffer when the watchdog fired. */
+#define JUMP_TIMEOUT 2
+
 /** Dynamically growable string. */
 LKP_DECLARE_DA_STRUCT(DynamicMessage, char);
 
-static char buffer[BUFFER_LENGTH]; /** Temporary buffer. */
+static _Thread_local char buffer[BUFFER_LENGTH]; /** Temporary buffer of each thread. */
 static LukipUnit lukip; /** The unit which stores the unit-test's info. */
+static LkpCache cache; /** Results of the tests from the last run. */
+static uint64_t shuffleState; /** State of the generator the order of tests is drawn from. */
+
+/** Where the asserts of this thread go while it runs a property's case, otherwise NULL. */
+static _Thread_local LkpCaseSink *caseSink = NULL;
+
+/** Whether the body of a test with a timeout is currently running. */
+static volatile sig_atomic_t inTimedBody = 0;
 
 /** Initializes the passed dynamic message with a NUL terminator. Use this over LP_INIT_DA. */
 static void init_message(DynamicMessage *message) {
@@ -43,10 +74,25 @@ static void free_failure_messages(LkpTestFunc *failedFunc) {
 /** Initializes the Lukip unit to start the program, and sets end_lukip to run at exit. */
 void init_lukip() {
     LKP_INIT_DA(&lukip.tests);
+    LKP_INIT_DA(&lukip.pending);
     LKP_INIT_DA(&lukip.warnings);
+    LKP_INIT_DA(&lukip.dependencies);
+    lkp_init_options(&lukip.options);
+    lkp_load_cache(&cache, lukip.options.cachePath);
+    lkp_init_coverage();
 
     lukip.setup = NULL;
     lukip.teardown = NULL;
+    lukip.suite = NULL;
+    lukip.testJump = NULL;
+    lukip.requireMark = 0;
+    lukip.recordAllocationSites = false;
+    lukip.failingSite = 0;
+    lukip.defaultTimeout = lkp_env_timeout();
+    lukip.isolated = lkp_env_isolation();
+    lukip.deferTests = false;
+    lukip.skippedTests = 0;
+    lukip.suiteTeardown = NULL;
     lukip.startTime = clock();
     lukip.hasFailed = false;
     if (atexit(end_lukip) != 0) {
@@ -57,21 +103,95 @@ void init_lukip() {
     }
 }
 
+/**
+ * Initializes the unit, then applies the passed options. The cache is loaded again
+ * since the options might've moved it.
+ */
+void init_lukip_args(const int argc, char **argv) {
+    init_lukip();
+    lkp_parse_options(&lukip.options, argc, argv);
+    lukip.deferTests = lukip.options.failedFirst || lukip.options.shuffle
+        || lukip.options.bisect != NULL;
+    shuffleState = lukip.options.shuffleSeed;
+
+    lkp_free_cache(&cache);
+    lkp_load_cache(&cache, lukip.options.cachePath);
+}
+
+/** Returns the translation unit a test is defined in, as far as we know. */
+static const char *test_source(const LkpTestFunc *test) {
+    // Only known after an assert ran, so fall back to where it was called from.
+    return test->info.fileName != NULL ? test->info.fileName : test->caller.testInfo.fileName;
+}
+
+/** Records the results of every test that ran and saves them for the next run. */
+static void save_results() {
+    if (lukip.options.cachePath == NULL) {
+        return;
+    }
+    for (int i = 0; i < lukip.tests.length; i++) {
+        const LkpTestFunc *test = &lukip.tests.data[i];
+        const char *source = test_source(test);
+        const uint64_t hash = test->info.status == LKP_TEST_CACHED
+            ? 0 : lkp_hash_test_inputs(source, &lukip.dependencies);
+        lkp_update_cache(&cache, test, source, hash);
+    }
+    if (!lkp_save_cache(&cache, lukip.options.cachePath)) {
+        fprintf(
+            stderr, "Lukip failed to save results to \"%s\": %s (Errno %d)\n",
+            lukip.options.cachePath, strerror(errno), errno
+        );
+    }
+}
+
 /** Ends the Lukip unit, which is by displaying the results and freeing resources. */
 void end_lukip() {
+    if (lkp_in_child()) {
+        return; // A forked test which called exit(), only the parent reports.
+    }
+    char *output = lkp_end_capture();
+    if (output != NULL) {
+        // A test called exit() while captured, so there's nothing else to tell about it.
+        fputs(output, stdout);
+        free(output);
+    }
+    lkp_run_tests();
+    while (lukip.suite != NULL) {
+        lkp_end_suite();
+    }
+    if (lukip.suiteTeardown != NULL) {
+        lukip.suiteTeardown();
+    }
     lkp_show_results(&lukip);
+    save_results();
+    if (lukip.options.reportPath != NULL && !lkp_write_report(&lukip, lukip.options.reportPath)) {
+        fprintf(
+            stderr, "Lukip failed to write a report to \"%s\": %s (Errno %d)\n",
+            lukip.options.reportPath, strerror(errno), errno
+        );
+    }
+    lkp_free_cache(&cache);
+    lkp_free_hashes();
+    LKP_FREE_DA(&lukip.dependencies);
     for (int i = 0; i < lukip.warnings.length; i++) {
         free(lukip.warnings.data[i].message);
     }
     LKP_FREE_DA(&lukip.warnings);
 
     for (int i = 0; i < lukip.tests.length; i++) {
+        free(lukip.tests.data[i].output);
+        for (int j = 0; j < lukip.tests.data[i].latencies.length; j++) {
+            free(lukip.tests.data[i].latencies.data[j].histogram);
+        }
+        LKP_FREE_DA(&lukip.tests.data[i].latencies);
+        LKP_FREE_DA(&lukip.tests.data[i].scaling.points);
         if (lukip.tests.data[i].info.status == LKP_TEST_FAILURE) {
             free_failure_messages(&lukip.tests.data[i]);
             LKP_FREE_DA(&lukip.tests.data[i].failures);
         }
     }
     LKP_FREE_DA(&lukip.tests);
+    LKP_FREE_DA(&lukip.pending);
 }
 
 /** Initializes a LkpFuncInfo struct. */
@@ -90,7 +210,36 @@ static void init_line_info(LkpLineInfo *info) {
 /** Initializes a function which has tests. */
 static void init_test(LkpTestFunc *test) {
     LKP_INIT_DA(&test->failures);
+    test->name = NULL;
     test->testFunc = NULL;
+    test->fixtureFunc = NULL;
+    test->propertyFunc = NULL;
+    test->cases = 0;
+    test->fuzzFunc = NULL;
+    test->differential = NULL;
+    test->paramFunc = NULL;
+    test->paramPath = NULL;
+    test->recordSize = 0;
+    test->benchFunc = NULL;
+    test->benchRange = (LkpBenchRange){.from = 1, .to = 1, .multiplier = 2, .atMost = LKP_O_ANY};
+    test->suite = NULL;
+    test->setup = NULL;
+    test->teardown = NULL;
+    test->timeout = 0;
+    test->isolated = false;
+    test->exhaustiveAlloc = false;
+    test->timedOut = false;
+    test->output = NULL;
+    test->runs = 0;
+    test->passedRuns = 0;
+    test->meanMs = 0;
+    test->squaredDeviations = 0;
+    memset(&test->usage, 0, sizeof(test->usage));
+    LKP_INIT_DA(&test->latencies);
+    LKP_INIT_DA(&test->scaling.points);
+    test->scaling.complexity = LKP_O_ANY;
+    test->scaling.coefficient = 0;
+    test->scaling.error = 0;
     init_func_info(&test->info);
     init_line_info(&test->caller);
 }
@@ -101,9 +250,28 @@ static void init_test(LkpTestFunc *test) {
  * @return an integer which is 1 if a unit has failed, or 0 if none have failed so far.
  */
 int lkp_status() {
+    lkp_run_tests();
     return lukip.hasFailed ? 1 : 0;
 }
 
+/** Flaky tests both passed and failed, so they must've run at least twice. */
+bool lkp_is_flaky(const LkpTestFunc *test) {
+    return test->passedRuns > 0 && test->passedRuns < test->runs;
+}
+
+/** Takes the square root of the sample variance with Newton's method, so we don't need -lm. */
+double lkp_time_deviation(const LkpTestFunc *test) {
+    if (test->runs < 2 || test->squaredDeviations <= 0) {
+        return 0;
+    }
+    const double variance = test->squaredDeviations / (test->runs - 1);
+    double root = variance > 1 ? variance : 1;
+    for (int i = 0; i < 64; i++) {
+        root = (root + variance / root) / 2;
+    }
+    return root;
+}
+
 /**
  * @brief Allocates a formatted string from a va_list.
  * 
@@ -113,10 +281,12 @@ int lkp_status() {
  * @return The allocated string.
  */
 static char *lkp_vstrf_alloc(const char *format, va_list *args) {
-    vsnprintf(buffer, BUFFER_LENGTH, format, *args);
-    const size_t length = strlen(buffer) + 1; // +1 to account for NUL.
-    char *message = lkp_allocate((int)length, sizeof(char));
-    strncpy(message, buffer, length);
+    va_list measured;
+    va_copy(measured, *args);
+    const int length = vsnprintf(NULL, 0, format, measured) + 1; // +1 to account for NUL.
+    va_end(measured);
+    char *message = lkp_allocate(length, sizeof(char));
+    vsnprintf(message, length, format, *args);
     return message;
 }
 
@@ -129,6 +299,24 @@ char *lkp_strf_alloc(const char *format, ...) {
     return message;
 }
 
+/** Allocates bytes as escaped text, so they can be shown inside of quotes on a single line. */
+char *lkp_escape_bytes(const char *data, const size_t size, const size_t limit) {
+    char *escaped = lkp_allocate(limit * 4 + 4, sizeof(char));
+    size_t length = 0;
+    for (size_t i = 0; i < size && i < limit; i++) {
+        const unsigned char byte = (unsigned char)data[i];
+        if (byte == '\n' || byte == '\r') {
+            length += sprintf(escaped + length, "\\%c", byte == '\n' ? 'n' : 'r');
+        } else if (byte < 32 || byte > 126 || byte == '"' || byte == '\\') {
+            length += sprintf(escaped + length, "\\x%02x", byte);
+        } else {
+            escaped[length++] = (char)byte;
+        }
+    }
+    strcpy(escaped + length, size > limit ? "..." : "");
+    return escaped;
+}
+
 /**
  * @brief Appends a string to a DynamicMessage.
  * 
@@ -156,28 +344,15 @@ static void reverse_string(char *string) {
     }
 }
 
-/**
- * Calls a testing function (so its macros can be used),
- * then appends it. Also uses setup and teardown if they're set.
- */
-void lkp_test_func(const LkpEmptyFunc funcToTest, const LkpLineInfo caller) {
-    if (lukip.setup != NULL) {
-        lukip.setup();
-    }
-    LkpTestFunc testFunc;
-    init_test(&testFunc);
-    testFunc.caller = caller;
-    LKP_APPEND_DA(&lukip.tests, testFunc);
-
-    funcToTest();
-
-    if (lukip.teardown != NULL) {
-        lukip.teardown();
-    }
-}
-
 /** Sets information to success if it hasn't already failed or succeeded. */
 static void assert_success(const LkpFuncInfo newInfo) {
+    if (caseSink != NULL) {
+        caseSink->asserts++;
+        if (caseSink->info.fileName == NULL) {
+            caseSink->info = newInfo;
+        }
+        return;
+    }
     lukip.asserts++;
 
     LkpFuncInfo *info = &lukip.tests.data[lukip.tests.length - 1].info;
@@ -190,6 +365,16 @@ static void assert_success(const LkpFuncInfo newInfo) {
 
 /** Sets the function's status to fail and appends the failed assert. */
 static void assert_failure(const LkpLineInfo newInfo, char *message) {
+    if (caseSink != NULL) {
+        assert_success(newInfo.testInfo); // Just counts it and remembers where it is.
+        if (caseSink->message == NULL) {
+            caseSink->message = message;
+            caseSink->line = newInfo.line;
+        } else {
+            free(message);
+        }
+        return;
+    }
     lukip.asserts++;
     lukip.failedAsserts++;
 
@@ -204,6 +389,1195 @@ static void assert_failure(const LkpLineInfo newInfo, char *message) {
     LKP_APPEND_DA(&lukip.tests.data[lukip.tests.length - 1].failures, failure);
 }
 
+/**
+ * Skips the rest of a test that ran out of time. Only called by the watchdog's signal handler,
+ * so it's not async-signal-safe: whatever locks the test held stay held. Isolated tests
+ * don't get here, since their parent kills them instead.
+ */
+static void on_test_timeout() {
+    if (inTimedBody && lukip.testJump != NULL) {
+        inTimedBody = 0;
+        LKP_LONGJMP(*lukip.testJump, JUMP_TIMEOUT);
+    }
+}
+
+/** Returns where the current test was called from, named after the test as far as we know. */
+static LkpLineInfo current_test_location() {
+    const LkpTestFunc *test = &lukip.tests.data[lukip.tests.length - 1];
+    LkpLineInfo location = test->caller;
+    if (test->info.status != LKP_TEST_UNKNOWN) {
+        location.testInfo = test->info;
+    } else if (test->name != NULL) {
+        location.testInfo.funcName = test->name;
+    }
+    return location;
+}
+
+/** Fails the current test at the place it was called from, without an assert's line info. */
+static void fail_current_test(const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    char *message = lkp_vstrf_alloc(format, &args);
+    va_end(args);
+    assert_failure(current_test_location(), message);
+}
+
+/** Warns or fails the current test about what it leaked, depending on --fail-leaks. */
+static void report_leaks(char *leaks) {
+    if (lukip.options.leaks == LKP_LEAKS_FAIL) {
+        assert_failure(current_test_location(), leaks);
+    } else {
+        LkpWarning warning = {.location = current_test_location(), .message = leaks};
+        LKP_APPEND_DA(&lukip.warnings, warning);
+    }
+}
+
+/** Marks the current test as timed out, which is also a failure. */
+static void fail_timed_out(const int milliseconds, const char *consequence) {
+    lukip.tests.data[lukip.tests.length - 1].timedOut = true;
+    fail_current_test("Timed out after %d ms (%s).", milliseconds, consequence);
+}
+
+/** Calls the per-test setups of a suite and the ones it's nested in, outermost first. */
+static void setup_suite_test(const LkpSuite *suite) {
+    if (suite == NULL) {
+        return;
+    }
+    setup_suite_test(suite->outer);
+    if (suite->setup != NULL) {
+        suite->setup(suite->fixture);
+    }
+}
+
+/** Calls the per-test teardowns of a suite and the ones it's nested in, innermost first. */
+static void teardown_suite_test(const LkpSuite *suite) {
+    if (suite == NULL) {
+        return;
+    }
+    if (suite->teardown != NULL) {
+        suite->teardown(suite->fixture);
+    }
+    teardown_suite_test(suite->outer);
+}
+
+/**
+ * @brief Records the result of generated cases as a single assert.
+ * 
+ * Only the shrunk counterexample is recorded, instead of every case that failed.
+ * The seed is part of the message since it's what reproduces the same cases.
+ */
+static void record_cases(const LkpPropertyResult *result, const int timeout) {
+    if (result->timedOut) {
+        fail_timed_out(timeout, "stopped generating cases");
+    }
+    if (result->failedCase >= 0) {
+        const LkpLineInfo location = {
+            .testInfo = result->failure.info, .line = result->failure.line
+        };
+        char *message = lkp_strf_alloc(
+            "%s Counterexample: %s (case %d of --seed=" LKP_UINT_FMT ", shrunk %d times).",
+            result->failure.message, result->counterexample, result->failedCase,
+            lukip.options.seed, result->shrinks
+        );
+        assert_failure(location, message);
+    } else if (result->asserts > 0) {
+        assert_success(result->failure.info);
+    }
+}
+
+/** Checks a property against generated cases. */
+static void run_property(const LkpTestFunc *test, const int timeout) {
+    LkpPropertyResult result;
+    lkp_check_property(
+        test->propertyFunc, test->cases, lukip.options.seed, lukip.options.jobs, timeout, &result
+    );
+    record_cases(&result, timeout);
+    lkp_free_property_result(&result);
+}
+
+/** Compares a differential test's implementations, whose mismatches are asserted at its call. */
+static void run_differential(const LkpTestFunc *test, const int timeout) {
+    LkpLineInfo location = test->caller;
+    location.testInfo.funcName = test->name;
+    LkpDiffResult result;
+    lkp_compare_implementations(
+        test->differential, location, test->cases, lukip.options.seed, lukip.options.jobs,
+        timeout, &result
+    );
+    record_cases(&result.cases, timeout);
+    lkp_free_property_result(&result.cases);
+}
+
+/**
+ * @brief Runs a fuzz test, and records every input that failed it as its own failure.
+ * 
+ * Each failing input is a different reproducer, so its file is part of the failure's message.
+ * If none failed, the whole fuzz test counts as one assert.
+ */
+static void run_fuzz(const LkpTestFunc *test, const int timeout) {
+    LkpFuzzResult result;
+    lkp_run_fuzz_test(test->fuzzFunc, test->name, &lukip.options, timeout, &result);
+    for (int i = 0; i < result.failures.length; i++) {
+        const LkpFuzzFailure *failure = &result.failures.data[i];
+        LkpLineInfo location = {.testInfo = failure->failure.info, .line = failure->failure.line};
+        if (location.line == 0) {
+            location = current_test_location(); // Timed out, which isn't at any assert.
+        }
+        char *message = lkp_strf_alloc(
+            "%s Reproducer: %s", failure->failure.message, failure->path
+        );
+        assert_failure(location, message);
+    }
+    if (result.failures.length == 0 && result.asserts > 0) {
+        assert_success(result.info);
+    }
+    lkp_free_fuzz_result(&result);
+}
+
+/**
+ * @brief Runs a benchmark over its sizes, and keeps what it fitted in the test.
+ * 
+ * The fit is asserted at the benchmark's call, failing if it grew past the declared class
+ * or if too few sizes were measured to tell the classes apart.
+ */
+static void run_benchmark(const LkpTestFunc *test) {
+    LkpScaling *scaling = &lukip.tests.data[lukip.tests.length - 1].scaling;
+    LKP_FREE_DA(&scaling->points);
+    lkp_run_benchmark(test->benchFunc, &test->benchRange, scaling);
+
+    LkpLineInfo location = test->caller;
+    location.testInfo.funcName = test->name;
+    if (scaling->points.length < LKP_BENCH_MIN_SIZES) {
+        char *message = lkp_strf_alloc(
+            "`%s` measured %d sizes, but fitting a complexity needs at least %d.",
+            test->name, scaling->points.length, LKP_BENCH_MIN_SIZES
+        );
+        assert_failure(location, message);
+    } else if (test->benchRange.atMost != LKP_O_ANY
+            && scaling->complexity > test->benchRange.atMost) {
+        char *fit = lkp_describe_scaling(scaling);
+        char *message = lkp_strf_alloc(
+            "`%s` grows as %s, past the declared %s.",
+            test->name, fit, lkp_complexity_name(test->benchRange.atMost)
+        );
+        assert_failure(location, message);
+        free(fit);
+    } else {
+        assert_success(location.testInfo);
+    }
+}
+
+/**
+ * @brief Runs a parameterized test over its file, and records every failing row as its own failure.
+ * 
+ * Only the first failing rows are recorded one by one, and the rest are summed up in one failure.
+ * If none failed, every row together counts as one assert.
+ */
+static void run_params(const LkpTestFunc *test, const int timeout) {
+    LkpParamResult result;
+    lkp_run_param_test(
+        test->paramFunc, test->paramPath, test->recordSize, lukip.options.jobs, timeout, &result
+    );
+    if (result.error != NULL) {
+        fail_current_test("%s", result.error);
+    }
+    if (result.timedOut) {
+        fail_timed_out(timeout, "stopped running rows");
+    }
+    for (int i = 0; i < result.failures.length; i++) {
+        const LkpRowFailure *failure = &result.failures.data[i];
+        const LkpLineInfo location = {
+            .testInfo = failure->failure.info, .line = failure->failure.line
+        };
+        char *message = lkp_strf_alloc(
+            "Row %lld (%s): %s", failure->row, failure->text, failure->failure.message
+        );
+        assert_failure(location, message);
+    }
+    const long long unreported = result.rowsFailed - result.failures.length;
+    if (unreported > 0) {
+        fail_current_test("%lld more rows failed (of %lld).", unreported, result.rowsRun);
+    }
+    if (result.rowsFailed == 0 && result.asserts > 0) {
+        assert_success(result.info);
+    }
+    lkp_free_param_result(&result);
+}
+
+/**
+ * Calls the setups, the testing function (so its macros can be used) and the teardowns
+ * of the last appended test. The global fixture wraps the suite's ones.
+ * 
+ * The test body runs under its own jump buffer, so a failed REQUIRE() or the watchdog
+ * can skip the rest of it while still reaching the teardowns. Unless leaks are ignored,
+ * what the process holds before the setups is compared to what it holds after the teardowns.
+ */
+static void run_test_here(const int timeout) {
+    // Copied out since a test calling TEST() itself would move the tests array.
+    const int index = lukip.tests.length - 1;
+    const LkpTestFunc test = lukip.tests.data[index];
+    LkpResources resources;
+    if (lukip.options.leaks != LKP_LEAKS_IGNORE) {
+        lkp_snapshot_resources(&resources);
+    }
+    if (test.setup != NULL) {
+        test.setup();
+    }
+    setup_suite_test(test.suite);
+
+    LkpJumpBuf testJump;
+    LkpJumpBuf *volatile outerJump = lukip.testJump;
+    lukip.testJump = &testJump;
+    const LkpUsage outerStart = lukip.bodyStart;
+    lkp_measure_usage(&lukip.bodyStart);
+    // A test run from a timed one's body is timed by its own watchdog, then the outer one again.
+    const sig_atomic_t outerTimed = inTimedBody;
+    LkpWatchdog watchdog = {.armed = false};
+    const int jumpValue = LKP_SETJMP(testJump);
+    if (jumpValue == 0) {
+        // Tests that run many inputs (properties, fuzzing...) stop by themselves instead.
+        const bool timesItself = test.propertyFunc != NULL || test.fuzzFunc != NULL
+            || test.differential != NULL || test.paramFunc != NULL;
+        if (timeout > 0 && !timesItself && lkp_arm_watchdog(timeout, on_test_timeout, &watchdog)) {
+            inTimedBody = 1;
+        }
+        lkp_coverage_begin();
+        if (lukip.recordAllocationSites) {
+            lkp_record_allocation_sites();
+        } else if (lukip.failingSite != 0) {
+            lkp_fail_allocation_site(lukip.failingSite);
+        }
+        if (test.fixtureFunc != NULL) {
+            test.fixtureFunc(test.suite->fixture);
+        } else if (test.propertyFunc != NULL) {
+            run_property(&test, timeout);
+        } else if (test.fuzzFunc != NULL) {
+            run_fuzz(&test, timeout);
+        } else if (test.differential != NULL) {
+            run_differential(&test, timeout);
+        } else if (test.paramFunc != NULL) {
+            run_params(&test, timeout);
+        } else if (test.benchFunc != NULL) {
+            run_benchmark(&test);
+        } else {
+            test.testFunc();
+        }
+    }
+    inTimedBody = 0;
+    LkpUsage bodyEnd;
+    lkp_measure_usage(&bodyEnd);
+    lkp_add_usage(&lukip.tests.data[index].usage, &lukip.bodyStart, &bodyEnd);
+    lukip.bodyStart = outerStart;
+    lkp_disarm_watchdog(&watchdog);
+    lkp_stop_failing_allocations();
+    lkp_stop_virtual_clock();
+    lkp_reset_io();
+    lkp_finish_mocks(jumpValue == 0);
+    lkp_coverage_end(&test);
+    lukip.testJump = outerJump;
+    inTimedBody = outerTimed;
+    if (jumpValue == JUMP_TIMEOUT) {
+        fail_timed_out(timeout, "skipped the rest");
+    }
+
+    teardown_suite_test(test.suite);
+    if (test.teardown != NULL) {
+        test.teardown();
+    }
+    if (lukip.options.leaks != LKP_LEAKS_IGNORE) {
+        char *leaks = lkp_find_leaks(&resources);
+        if (leaks != NULL) {
+            report_leaks(leaks);
+        }
+        lkp_free_resources(&resources);
+    }
+}
+
+/**
+ * How a forked child runs its test. The parent is the one enforcing the timeout,
+ * besides a fuzz test's, which is for each of its inputs.
+ */
+static void run_test_in_child() {
+    const LkpTestFunc *test = &lukip.tests.data[lukip.tests.length - 1];
+    run_test_here(test->fuzzFunc != NULL ? test->timeout : 0);
+}
+
+/** Runs the test in a forked child, and fails it if the child didn't finish properly. */
+static void run_test_isolated(const int timeout) {
+    const bool perInput = lukip.tests.data[lukip.tests.length - 1].fuzzFunc != NULL;
+    const LkpChildResult result = lkp_run_in_child(
+        &lukip, run_test_in_child, perInput ? 0 : timeout
+    );
+    if (result.outcome == LKP_CHILD_UNSUPPORTED) {
+        run_test_here(timeout);
+    } else if (result.outcome == LKP_CHILD_TIMED_OUT) {
+        fail_timed_out(timeout, "killed");
+    } else if (result.outcome == LKP_CHILD_CRASHED) {
+        fail_current_test("Crashed with signal %d.", result.code);
+    } else if (result.outcome == LKP_CHILD_EXITED) {
+        fail_current_test("Exited with status %d before finishing.", result.code);
+    }
+}
+
+/** Runs the last appended test either in this process or a forked one. */
+static void run_test_once(const int timeout, const bool isolated) {
+    if (isolated) {
+        run_test_isolated(timeout);
+    } else {
+        run_test_here(timeout);
+    }
+}
+
+/** Prefixes the failures of the last test from the passed one on with the failing site. */
+static void mark_failures_of_site(const int first, const uintptr_t site) {
+    char location[64];
+    lkp_describe_allocation_site(site, location, sizeof(location));
+    LkpFailureArray *failures = &lukip.tests.data[lukip.tests.length - 1].failures;
+    for (int i = first; i < failures->length; i++) {
+        char *message = lkp_strf_alloc(
+            "With the allocation at %s failing: %s", location, failures->data[i].message
+        );
+        free(failures->data[i].message);
+        failures->data[i].message = message;
+    }
+}
+
+/**
+ * @brief Runs the last test to record its allocation sites, then once more for each of them.
+ * 
+ * Each run fails the first allocation from its site, and its failures say which site it was
+ * (as an offset in the executable, for addr2line). The recording run is always done
+ * in this process since a forked one couldn't send the sites back, but it has no failures
+ * injected, and the runs after it are forked as usual with isolation.
+ */
+static void run_exhaustive_alloc(const int timeout, const bool isolated) {
+    if (!lkp_allocation_failures_supported()) {
+        fail_current_test("Allocation failures need the program linked with " LKP_WRAP_FLAGS ".");
+        return;
+    }
+    lukip.recordAllocationSites = true;
+    run_test_here(timeout);
+    lukip.recordAllocationSites = false;
+
+    uintptr_t sites[LKP_MAX_ALLOCATION_SITES];
+    const int siteCount = lkp_allocation_sites(sites);
+    for (int i = 0; i < siteCount; i++) {
+        const int failuresBefore = lukip.tests.data[lukip.tests.length - 1].failures.length;
+        lukip.failingSite = sites[i];
+        run_test_once(timeout, isolated);
+        lukip.failingSite = 0;
+        mark_failures_of_site(failuresBefore, sites[i]);
+    }
+}
+
+/** Returns the current time in milliseconds, only meant for measuring durations. */
+static double now_ms() {
+    struct timespec now;
+#ifdef LKP_POSIX
+    clock_gettime(CLOCK_MONOTONIC, &now);
+#else
+    timespec_get(&now, TIME_UTC);
+#endif
+    return now.tv_sec * 1000.0 + now.tv_nsec / 1000000.0;
+}
+
+/** Adds a run to a test's pass rate, and to its mean and variance with Welford's method. */
+static void record_run(const int index, const double milliseconds, const bool passed) {
+    LkpTestFunc *test = &lukip.tests.data[index];
+    test->runs++;
+    if (passed) {
+        test->passedRuns++;
+    }
+    const double delta = milliseconds - test->meanMs;
+    test->meanMs += delta / test->runs;
+    test->squaredDeviations += delta * (milliseconds - test->meanMs);
+}
+
+/** Frees the failures of a test from the passed one on, so repeated failures are shown once. */
+static void drop_failures_from(const int index, const int first) {
+    LkpFailureArray *failures = &lukip.tests.data[index].failures;
+    for (int i = first; i < failures->length; i++) {
+        free(failures->data[i].message);
+    }
+    failures->length = first;
+}
+
+/**
+ * @brief Runs the last appended test as many times as --repeat says.
+ * 
+ * Each run after the first gets its own seed, so generated inputs differ between runs,
+ * and only the failures of the first failing run are kept (though every failed assert counts).
+ * With --until-fail, it stops repeating once a run fails.
+ * 
+ * @param index Where the test is in the unit's tests.
+ */
+static void repeat_test(const int index) {
+    const LkpTestFunc testFunc = lukip.tests.data[index];
+    const uint64_t seed = lukip.options.seed;
+    uint64_t seedState = seed;
+    bool failedBefore = false;
+    for (int run = 0; run < lukip.options.repeat; run++) {
+        const int failuresBefore = lukip.tests.data[index].failures.length;
+        const double start = now_ms();
+        if (testFunc.exhaustiveAlloc) {
+            run_exhaustive_alloc(testFunc.timeout, testFunc.isolated);
+        } else {
+            run_test_once(testFunc.timeout, testFunc.isolated);
+        }
+        const bool passed = lukip.tests.data[index].failures.length == failuresBefore;
+        record_run(index, now_ms() - start, passed);
+        if (!passed && failedBefore) {
+            drop_failures_from(index, failuresBefore);
+        }
+        failedBefore = failedBefore || !passed;
+        if (!passed && lukip.options.untilFail) {
+            break;
+        }
+        lukip.options.seed = lkp_next_random(&seedState);
+    }
+    lukip.options.seed = seed;
+}
+
+/** Attaches what a test printed to it if it failed, otherwise throws it away. */
+static void keep_output(const int index, char *output) {
+    LkpTestFunc *test = &lukip.tests.data[index];
+    if (test->info.status == LKP_TEST_FAILURE) {
+        test->output = output;
+    } else {
+        free(output);
+    }
+}
+
+/**
+ * Appends a new test, then runs it (as many times as --repeat says) in this process or forked ones.
+ * With --capture, its output is captured here so a forked child's gets captured even if it crashes,
+ * and tests which a test runs itself get captured as part of it.
+ */
+static void execute_test(const LkpTestFunc testFunc) {
+    if (lukip.options.stopEarly && lukip.hasFailed) {
+        lukip.skippedTests++;
+        return;
+    }
+    LKP_APPEND_DA(&lukip.tests, testFunc);
+    const int index = lukip.tests.length - 1;
+    const bool captured = lukip.options.capture && lkp_begin_capture();
+    repeat_test(index);
+    if (captured) {
+        keep_output(index, lkp_end_capture());
+    }
+}
+
+/** Returns whether the test failed the last time it ran. */
+static bool failed_last_run(const LkpTestFunc *test) {
+    const LkpCacheEntry *entry = lkp_find_cache_entry(&cache, test);
+    return entry != NULL && entry->status == LKP_TEST_FAILURE;
+}
+
+/** Returns the test's cache entry if it passed last time and none of its inputs changed since. */
+static const LkpCacheEntry *unchanged_since_pass(const LkpTestFunc *test) {
+    const LkpCacheEntry *entry = lkp_find_cache_entry(&cache, test);
+    if (entry == NULL || entry->status != LKP_TEST_SUCCESS || entry->hash == 0) {
+        return NULL;
+    }
+    const uint64_t hash = lkp_hash_test_inputs(entry->definedIn, &lukip.dependencies);
+    return hash == entry->hash ? entry : NULL;
+}
+
+/** Runs the test right away, or defers it if the tests are being reordered. */
+static void run_test(LkpTestFunc testFunc) {
+    if (lukip.options.onlyFailed && !failed_last_run(&testFunc)) {
+        lukip.skippedTests++;
+        return;
+    }
+    const LkpCacheEntry *entry;
+    if (lukip.options.skipUnchanged && (entry = unchanged_since_pass(&testFunc)) != NULL) {
+        testFunc.info.status = LKP_TEST_CACHED;
+        testFunc.info.fileName = entry->definedIn;
+        testFunc.info.funcName = testFunc.name;
+        LKP_APPEND_DA(&lukip.tests, testFunc);
+        return;
+    }
+    if (lukip.deferTests) {
+        LKP_APPEND_DA(&lukip.pending, testFunc);
+    } else {
+        execute_test(testFunc);
+    }
+}
+
+/** Shuffles the tests with Fisher-Yates, continuing the order's generator between calls. */
+static void shuffle_tests(LkpTestFuncArray *tests) {
+    for (int i = tests->length - 1; i > 0; i--) {
+        const int j = (int)(lkp_next_random(&shuffleState) % (uint64_t)(i + 1));
+        const LkpTestFunc swapped = tests->data[i];
+        tests->data[i] = tests->data[j];
+        tests->data[j] = swapped;
+    }
+}
+
+/** The tests a forked bisect trial runs in order, and the test that runs after them. */
+typedef struct {
+    const LkpTestFuncArray *tests;
+    int first;
+    int end; /** Exclusive. */
+    int target;
+} BisectTrial;
+
+/**
+ * Runs a trial's tests in the child, and returns whether the target failed after them.
+ * The trial leaves no files behind: its tests aren't added to the coverage map,
+ * and fuzz tests only run their saved inputs instead of fuzzing (and saving) new ones.
+ */
+static bool run_bisect_trial(void *context) {
+    const BisectTrial *trial = context;
+    lukip.options.stopEarly = false;
+    lukip.options.capture = false;
+    lukip.options.fuzzSeconds = 0;
+    lkp_stop_coverage_map();
+    for (int i = trial->first; i < trial->end; i++) {
+        execute_test(trial->tests->data[i]);
+    }
+    execute_test(trial->tests->data[trial->target]);
+    return lukip.tests.data[lukip.tests.length - 1].info.status == LKP_TEST_FAILURE;
+}
+
+/** Returns whether the target fails after the tests from first to end (exclusive). */
+static bool fails_after(BisectTrial *trial, const int first, const int end) {
+    trial->first = first;
+    trial->end = end;
+    return lkp_run_trial(run_bisect_trial, trial).outcome != LKP_CHILD_FINISHED;
+}
+
+/**
+ * @brief Finds the earlier test that makes the one passed to --bisect fail in this order.
+ * 
+ * Every trial runs in a fresh fork, so the tests always start from the state they would
+ * in the real run. The tests before the target are halved for as long as one half alone
+ * still makes it fail, which leaves the one test it interferes with (or the smallest range
+ * of them that only interferes together). The result is shown as a warning.
+ * 
+ * @param tests The tests in the order they're about to run.
+ */
+static void bisect_tests(const LkpTestFuncArray *tests) {
+    int target = -1;
+    for (int i = 0; i < tests->length && target == -1; i++) {
+        if (tests->data[i].name != NULL && strcmp(tests->data[i].name, lukip.options.bisect) == 0) {
+            target = i;
+        }
+    }
+    if (target == -1) {
+        return; // Might be in a later batch of deferred tests.
+    }
+    const char *name = lukip.options.bisect;
+    const LkpLineInfo location = tests->data[target].caller;
+    lukip.options.bisect = NULL;
+
+    BisectTrial trial = {.tests = tests, .first = 0, .end = 0, .target = target};
+    const LkpChildOutcome alone = lkp_run_trial(run_bisect_trial, &trial).outcome;
+    if (alone == LKP_CHILD_UNSUPPORTED) {
+        lkp_raise_assert(LKP_RAISE_WARN, location, "Bisecting %s needs fork().", name);
+        return;
+    }
+    if (alone != LKP_CHILD_FINISHED) {
+        lkp_raise_assert(
+            LKP_RAISE_WARN, location, "%s fails on its own, so there's nothing to bisect.", name
+        );
+        return;
+    }
+    if (!fails_after(&trial, 0, target)) {
+        lkp_raise_assert(
+            LKP_RAISE_WARN, location, "%s passes after the %d tests before it in this order.",
+            name, target
+        );
+        return;
+    }
+    int first = 0, end = target;
+    while (end - first > 1) {
+        const int middle = first + (end - first) / 2;
+        if (fails_after(&trial, first, middle)) {
+            end = middle;
+        } else if (fails_after(&trial, middle, end)) {
+            first = middle;
+        } else {
+            break; // Only fails after tests of both halves.
+        }
+    }
+    const LkpTestFunc *culprit = &tests->data[first];
+    if (end - first == 1) {
+        lkp_raise_assert(
+            LKP_RAISE_WARN, location, "%s fails when run after %s (line %d of %s).",
+            name, culprit->name, culprit->caller.line, culprit->caller.testInfo.fileName
+        );
+    } else {
+        lkp_raise_assert(
+            LKP_RAISE_WARN, location, "%s fails after the %d tests from %s (line %d of %s) on, "
+            "but not after either half of them.",
+            name, end - first, culprit->name, culprit->caller.line,
+            culprit->caller.testInfo.fileName
+        );
+    }
+}
+
+/**
+ * Runs every deferred test. With --shuffle they're shuffled first, then with --failed-first
+ * the ones that failed last time run first, and the rest keep their order.
+ */
+void lkp_run_tests() {
+    // Taken out of the unit in case a test declares tests itself.
+    LkpTestFuncArray pending = lukip.pending;
+    LKP_INIT_DA(&lukip.pending);
+    if (lukip.options.shuffle) {
+        shuffle_tests(&pending);
+    }
+
+    LkpTestFuncArray ordered;
+    LKP_INIT_DA(&ordered);
+    if (lukip.options.failedFirst) {
+        for (int i = 0; i < pending.length; i++) {
+            if (failed_last_run(&pending.data[i])) {
+                LKP_APPEND_DA(&ordered, pending.data[i]);
+            }
+        }
+    }
+    for (int i = 0; i < pending.length; i++) {
+        if (!lukip.options.failedFirst || !failed_last_run(&pending.data[i])) {
+            LKP_APPEND_DA(&ordered, pending.data[i]);
+        }
+    }
+    LKP_FREE_DA(&pending);
+
+    if (lukip.options.bisect != NULL) {
+        bisect_tests(&ordered);
+    }
+    for (int i = 0; i < ordered.length; i++) {
+        execute_test(ordered.data[i]);
+    }
+    LKP_FREE_DA(&ordered);
+}
+
+/** Adds a file every test's cached result depends on. */
+void lkp_add_dependency(const char *path) {
+    LKP_APPEND_DA(&lukip.dependencies, path);
+}
+
+/** Creates a test with the fixture, timeout and isolation that are currently set. */
+static LkpTestFunc new_test(const char *name, const LkpLineInfo caller, const int timeout) {
+    LkpTestFunc testFunc;
+    init_test(&testFunc);
+    testFunc.caller = caller;
+    testFunc.name = name;
+    testFunc.setup = lukip.setup;
+    testFunc.teardown = lukip.teardown;
+    testFunc.suite = lukip.suite;
+    testFunc.timeout = timeout;
+    testFunc.isolated = lukip.isolated;
+    return testFunc;
+}
+
+/** Runs a test with the default timeout. */
+void lkp_test_func(const LkpEmptyFunc funcToTest, const char *name, const LkpLineInfo caller) {
+    LkpTestFunc testFunc = new_test(name, caller, lukip.defaultTimeout);
+    testFunc.testFunc = funcToTest;
+    run_test(testFunc);
+}
+
+/** Runs a test with its own timeout instead of the default one. */
+void lkp_test_func_timeout(
+    const LkpEmptyFunc funcToTest, const char *name, const int milliseconds,
+    const LkpLineInfo caller
+) {
+    LkpTestFunc testFunc = new_test(name, caller, milliseconds);
+    testFunc.testFunc = funcToTest;
+    run_test(testFunc);
+}
+
+/** Runs a property test with the default timeout. */
+void lkp_test_property(
+    const LkpPropertyFunc funcToTest, const char *name, const int cases, const LkpLineInfo caller
+) {
+    LkpTestFunc testFunc = new_test(name, caller, lukip.defaultTimeout);
+    testFunc.propertyFunc = funcToTest;
+    testFunc.cases = cases;
+    run_test(testFunc);
+}
+
+/** Runs a fuzz test with the default timeout, which applies to each of its inputs. */
+void lkp_test_fuzz(const LkpFuzzFunc funcToTest, const char *name, const LkpLineInfo caller) {
+    LkpTestFunc testFunc = new_test(name, caller, lukip.defaultTimeout);
+    testFunc.fuzzFunc = funcToTest;
+    run_test(testFunc);
+}
+
+/** Runs a test with the default timeout, then again for every allocation site it hits. */
+void lkp_test_exhaustive_alloc(
+    const LkpEmptyFunc funcToTest, const char *name, const LkpLineInfo caller
+) {
+    LkpTestFunc testFunc = new_test(name, caller, lukip.defaultTimeout);
+    testFunc.testFunc = funcToTest;
+    testFunc.exhaustiveAlloc = true;
+    run_test(testFunc);
+}
+
+/** Runs a differential test with the default timeout. */
+void lkp_test_differential(
+    const LkpDifferential *differential, const char *name, const int cases,
+    const LkpLineInfo caller
+) {
+    LkpTestFunc testFunc = new_test(name, caller, lukip.defaultTimeout);
+    testFunc.differential = differential;
+    testFunc.cases = cases;
+    run_test(testFunc);
+}
+
+/** Runs a parameterized test with the default timeout, which it checks between chunks of rows. */
+void lkp_test_params(
+    const LkpParamFunc funcToTest, const char *name, const char *path, const size_t recordSize,
+    const LkpLineInfo caller
+) {
+    LkpTestFunc testFunc = new_test(name, caller, lukip.defaultTimeout);
+    testFunc.paramFunc = funcToTest;
+    testFunc.paramPath = path;
+    testFunc.recordSize = recordSize;
+    run_test(testFunc);
+}
+
+/** Runs a benchmark over its range with the default timeout. */
+void lkp_test_benchmark(
+    const LkpBenchFunc funcToTest, const char *name, const LkpBenchRange range,
+    const LkpLineInfo caller
+) {
+    LkpTestFunc testFunc = new_test(name, caller, lukip.defaultTimeout);
+    testFunc.benchFunc = funcToTest;
+    testFunc.benchRange = range;
+    run_test(testFunc);
+}
+
+/** Runs a test that takes the current suite's fixture, or fails it if there's no suite. */
+void lkp_test_fixture_func(
+    const LkpFixtureFunc funcToTest, const char *name, const LkpLineInfo caller
+) {
+    LkpTestFunc testFunc = new_test(name, caller, lukip.defaultTimeout);
+    testFunc.fixtureFunc = funcToTest;
+    if (lukip.suite == NULL) {
+        LKP_APPEND_DA(&lukip.tests, testFunc);
+        fail_current_test("Fixture test ran outside of a suite.");
+        return;
+    }
+    run_test(testFunc);
+}
+
+/** Allocates a zeroed fixture for a new innermost suite, then calls its one-time setup. */
+void lkp_begin_suite(
+    const size_t fixtureSize, const LkpFixtureFunc suiteSetup, const LkpFixtureFunc suiteTeardown
+) {
+    LkpSuite *suite = lkp_allocate(1, sizeof(LkpSuite));
+    suite->fixture = lkp_allocate(1, fixtureSize > 0 ? fixtureSize : 1);
+    memset(suite->fixture, 0, fixtureSize);
+    suite->setup = NULL;
+    suite->teardown = NULL;
+    suite->suiteTeardown = suiteTeardown;
+    suite->outer = lukip.suite;
+    lukip.suite = suite;
+    if (suiteSetup != NULL) {
+        suiteSetup(suite->fixture);
+    }
+}
+
+/** Sets the per-test fixture of the innermost suite. */
+void lkp_make_suite_fixture(const LkpFixtureFunc newSetup, const LkpFixtureFunc newTeardown) {
+    if (lukip.suite == NULL) {
+        return;
+    }
+    lukip.suite->setup = newSetup;
+    lukip.suite->teardown = newTeardown;
+}
+
+/** Tears down the innermost suite and goes back to the one it was nested in (if any). */
+void lkp_end_suite() {
+    lkp_run_tests(); // Deferred tests might still need the suite.
+    LkpSuite *suite = lukip.suite;
+    if (suite == NULL) {
+        return;
+    }
+    if (suite->suiteTeardown != NULL) {
+        suite->suiteTeardown(suite->fixture);
+    }
+    lukip.suite = suite->outer;
+    free(suite->fixture);
+    free(suite);
+}
+
+/** Turns running every test in its own forked process on or off. */
+void lkp_set_isolation(const bool isolated) {
+    lukip.isolated = isolated;
+}
+
+/**
+ * Runs the suite setup once in this process, which every forked test then inherits.
+ * A previous zygote's teardown is called first since its state is being replaced.
+ */
+void lkp_make_zygote(const LkpEmptyFunc suiteSetup, const LkpEmptyFunc suiteTeardown) {
+    lkp_run_tests(); // Deferred tests were declared before the zygote, so they shouldn't see it.
+    if (lukip.suiteTeardown != NULL) {
+        lukip.suiteTeardown();
+    }
+    lukip.isolated = true;
+    lukip.suiteTeardown = suiteTeardown;
+    if (suiteSetup != NULL) {
+        suiteSetup();
+    }
+}
+
+/** Sets the timeout of tests without their own one. */
+void lkp_set_default_timeout(const int milliseconds) {
+    lukip.defaultTimeout = milliseconds > 0 ? milliseconds : 0;
+}
+
+/** Fails the test where it's called from if the allocations can't be made to fail. */
+static bool check_allocation_failures(const LkpLineInfo info) {
+    if (lkp_allocation_failures_supported()) {
+        return true;
+    }
+    assert_failure(
+        info, lkp_strf_alloc("Allocation failures need the program linked with " LKP_WRAP_FLAGS ".")
+    );
+    return false;
+}
+
+/** Fails the nth allocation from now, until the end of the test's body. */
+void lkp_inject_allocation_failure(const long long nth, const LkpLineInfo info) {
+    if (check_allocation_failures(info)) {
+        lkp_fail_nth_allocation(nth);
+    }
+}
+
+/** Fails a fraction of the allocations from now, until the end of the test's body. */
+void lkp_inject_random_allocation_failures(const double fraction, const LkpLineInfo info) {
+    if (check_allocation_failures(info)) {
+        lkp_fail_random_allocations(fraction, lukip.options.seed);
+    }
+}
+
+/** Fails the test where it's called from if the clock can't be made virtual. */
+static bool check_virtual_clock(const LkpLineInfo info) {
+    if (lkp_virtual_clock_supported()) {
+        return true;
+    }
+    assert_failure(
+        info,
+        lkp_strf_alloc("A virtual clock needs the program linked with " LKP_CLOCK_WRAP_FLAGS ".")
+    );
+    return false;
+}
+
+/** Makes the clocks virtual until the end of the test's body. */
+void lkp_use_virtual_clock(const LkpLineInfo info) {
+    if (check_virtual_clock(info)) {
+        lkp_start_virtual_clock();
+    }
+}
+
+/** Advances the virtual clock, or fails the test if it isn't running. */
+void lkp_advance_virtual_clock(const long long milliseconds, const LkpLineInfo info) {
+    if (!check_virtual_clock(info)) {
+        return;
+    }
+    if (!lkp_virtual_clock_running()) {
+        assert_failure(info, lkp_strf_alloc("ADVANCE_TIME() needs START_VIRTUAL_CLOCK() first."));
+        return;
+    }
+    lkp_advance_time(milliseconds);
+}
+
+/** Fails the test where it's called from if the I/O can't be faked. */
+static bool check_fake_io(const LkpLineInfo info) {
+    if (lkp_io_faults_supported()) {
+        return true;
+    }
+    assert_failure(
+        info, lkp_strf_alloc("Faking I/O needs the program linked with " LKP_IO_WRAP_FLAGS ".")
+    );
+    return false;
+}
+
+/** Keeps the files under a prefix in memory until the end of the test's body. */
+void lkp_use_fake_files(const char *prefix, const LkpLineInfo info) {
+    if (check_fake_io(info)) {
+        lkp_fake_files(prefix);
+    }
+}
+
+/** Fails calls on the files under a prefix until the end of the test's body. */
+void lkp_inject_io_fault(
+    const LkpIoOperation operation, const char *prefix, const long long nth, const int error,
+    const LkpLineInfo info
+) {
+    if (check_fake_io(info)) {
+        lkp_fail_io(operation, prefix, nth, error);
+    }
+}
+
+/** Cuts reads or writes on the files under a prefix short until the end of the test's body. */
+void lkp_inject_short_io(
+    const LkpIoOperation operation, const char *prefix, const long long nth,
+    const long long bytes, const LkpLineInfo info
+) {
+    if (!check_fake_io(info)) {
+        return;
+    }
+    if (operation != LKP_IO_READ && operation != LKP_IO_WRITE) {
+        assert_failure(info, lkp_strf_alloc("Only reads and writes can be cut short."));
+        return;
+    }
+    lkp_shorten_io(operation, prefix, nth, bytes);
+}
+
+/** Makes a scripted peer, failing the test if it couldn't. */
+LkpPeer *lkp_new_peer(const LkpPeerKind kind, const LkpLineInfo info) {
+    LkpPeer *peer = lkp_create_peer(kind);
+    if (peer == NULL) {
+        assert_failure(info, lkp_strf_alloc("Couldn't make a peer (they need POSIX sockets)."));
+    }
+    return peer;
+}
+
+/** Starts running a peer's script, failing the test if its thread couldn't start. */
+void lkp_run_peer(LkpPeer *peer, const LkpLineInfo info) {
+    if (peer != NULL && !lkp_start_peer(peer)) {
+        assert_failure(info, lkp_strf_alloc("Couldn't start the peer's thread."));
+    }
+}
+
+/** Stops and frees a peer, which counts as an assert of whether its whole script ran fine. */
+void lkp_finish_peer(LkpPeer *peer, const LkpLineInfo info) {
+    if (peer == NULL) {
+        return;
+    }
+    char *error = lkp_stop_peer(peer);
+    if (error != NULL) {
+        assert_failure(info, lkp_strf_alloc("Peer: %s", error));
+        free(error);
+    } else {
+        assert_success(info.testInfo);
+    }
+}
+
+/** Forks for a death test, making sure the child never carries on with the rest of the test. */
+bool lkp_fork_death(LkpDeathChild *child) {
+    if (!lkp_fork_death_child(child)) {
+        return false;
+    }
+    lukip.testJump = NULL;
+    inTimedBody = 0;
+    return true;
+}
+
+/** Describes how a death test ended (or should have), like "exited with status 2". */
+static char *describe_death(const LkpDeathOutcome outcome, const int code) {
+    switch (outcome) {
+    case LKP_DEATH_SURVIVED: return lkp_strf_alloc("finished without dying");
+    case LKP_DEATH_EXITED: return lkp_strf_alloc("exited with status %d", code);
+    case LKP_DEATH_SIGNALED:
+        return lkp_strf_alloc("was killed by signal %d (%s)", code, strsignal(code));
+    case LKP_DEATH_TIMED_OUT:
+        return lkp_strf_alloc("didn't die within %d ms (killed)", LKP_DEATH_TIMEOUT);
+    case LKP_DEATH_FORK_FAILED:
+        return lkp_strf_alloc("couldn't be forked: %s (Errno %d)", strerror(code), code);
+    default: return lkp_strf_alloc("couldn't be forked");
+    }
+}
+
+/** Describes the death a death test expects, like "exit with status 2". */
+static char *describe_expected_death(const int death) {
+    if (death == LKP_ANY_DEATH) {
+        return lkp_strf_alloc("die");
+    } else if (death < 0) {
+        return lkp_strf_alloc("be killed by signal %d (%s)", -death, strsignal(-death));
+    }
+    return lkp_strf_alloc("exit with status %d", death);
+}
+
+/** Returns whether the output matches the pattern, or allocates the error into error. */
+static bool matches_output(const char *output, const char *pattern, char **error) {
+    *error = NULL;
+    if (pattern == NULL) {
+        return true;
+    }
+#ifdef LKP_POSIX
+    regex_t regex;
+    if (regcomp(&regex, pattern, REG_EXTENDED | REG_NOSUB) != 0) {
+        *error = lkp_strf_alloc("Couldn't compile the stderr pattern /%s/.", pattern);
+        return false;
+    }
+    const bool matched = regexec(&regex, output, 0, NULL, 0) == 0;
+    regfree(&regex);
+    return matched;
+#else
+    (void)output;
+    return true;
+#endif
+}
+
+/** Verifies a death test's ending against the expected one, as one assert. */
+void lkp_verify_death(
+    LkpDeathChild *child, const int death, const char *pattern, const char *statement,
+    const LkpLineInfo info
+) {
+    LkpDeathResult result = lkp_wait_for_death(child);
+    if (result.outcome == LKP_DEATH_UNSUPPORTED) {
+        lkp_raise_assert(
+            LKP_RAISE_WARN, info, "Skipped the death test of `%s`, since it can't fork.", statement
+        );
+        free(result.output);
+        return;
+    }
+    bool died = result.outcome == LKP_DEATH_EXITED || result.outcome == LKP_DEATH_SIGNALED;
+    if (died && death != LKP_ANY_DEATH) {
+        died = death < 0
+            ? result.outcome == LKP_DEATH_SIGNALED && result.code == -death
+            : result.outcome == LKP_DEATH_EXITED && result.code == death;
+    }
+    char *error = NULL;
+    const bool matched = died && matches_output(result.output, pattern, &error);
+
+    char *ending = describe_death(result.outcome, result.code);
+    char *output = lkp_escape_bytes(result.output, strlen(result.output), 200);
+    if (!died) {
+        char *expected = describe_expected_death(death);
+        lkp_verify_condition(
+            false, info, "Expected `%s` to %s, but it %s. Its stderr: \"%s\"",
+            statement, expected, ending, output
+        );
+        free(expected);
+    } else if (error != NULL) {
+        lkp_verify_condition(false, info, "%s", error);
+    } else {
+        lkp_verify_condition(
+            matched, info, "`%s` %s, but its stderr didn't match /%s/: \"%s\"",
+            statement, ending, pattern, output
+        );
+    }
+    free(error);
+    free(ending);
+    free(output);
+    free(result.output);
+}
+
+/**
+ * Counts page faults since the body started, on the thread calling the assert.
+ * A generated case runs on a worker thread, so it only counts since that case started.
+ */
+void lkp_verify_page_faults(const long long max, const LkpLineInfo info) {
+    LkpUsage now, used = {0};
+    lkp_measure_counters(&now);
+    lkp_add_usage(&used, caseSink != NULL ? &caseSink->start : &lukip.bodyStart, &now);
+    const long long faults = used.minorFaults + used.majorFaults;
+    lkp_verify_condition(
+        faults <= max, info, "%lld page faults (%lld major) is more than the maximum of %lld.",
+        faults, used.majorFaults, max
+    );
+}
+
+/** Keeps a latency assert's durations in the test, merged with its earlier runs (--repeat). */
+static void record_latency(const LkpHistogram *histogram, const char *statement, const int line) {
+    if (caseSink != NULL) {
+        return;
+    }
+    LkpLatencyArray *latencies = &lukip.tests.data[lukip.tests.length - 1].latencies;
+    for (int i = 0; i < latencies->length; i++) {
+        if (latencies->data[i].line == line && latencies->data[i].statement == statement) {
+            lkp_merge_histogram(latencies->data[i].histogram, histogram);
+            return;
+        }
+    }
+    LkpLatencyRecord record = {
+        .statement = statement, .line = line, .histogram = lkp_allocate(1, sizeof(LkpHistogram))
+    };
+    *record.histogram = *histogram;
+    LKP_APPEND_DA(latencies, record);
+}
+
+/** Compares the percentile to the budget, showing the whole distribution if it's over. */
+void lkp_verify_latency(
+    const LkpHistogram *histogram, const double percentile, const long long budget,
+    const char *statement, const LkpLineInfo info
+) {
+    record_latency(histogram, statement, info.line);
+    const long long observed = lkp_histogram_percentile(histogram, percentile);
+    char *distribution = lkp_describe_histogram(histogram);
+    lkp_verify_condition(
+        observed < budget, info, "`%s` took %lld ns at p%g, not below the budget of %lld ns (%s).",
+        statement, observed, percentile, budget, distribution
+    );
+    free(distribution);
+}
+
+/**
+ * Times the operation on every thread, then checks the merged durations like a statement's.
+ * 
+ * The watchdog is held until the workers are joined and freed, since jumping out of
+ * lkp_run_parallel() would leave them running. They stop by themselves at its deadline
+ * instead, and the timeout fires once it's released (without checking the cut off runs).
+ */
+void lkp_verify_stress(
+    const LkpStressFunc operation, void *context, const int threads, const int iterations,
+    const double percentile, const long long budget, const char *name, const LkpLineInfo info
+) {
+    const long long deadline = lkp_hold_watchdog();
+    LkpHistogram *merged = lkp_allocate(1, sizeof(LkpHistogram));
+    lkp_stress_latency(operation, context, threads, iterations, deadline, merged);
+    if (deadline == 0 || lkp_monotonic_ns() < deadline) {
+        lkp_verify_latency(merged, percentile, budget, name, info);
+    }
+    free(merged);
+    lkp_release_watchdog();
+}
+
+/**
+ * Counts context switches since the body started, on the thread calling the assert.
+ * A generated case runs on a worker thread, so it only counts since that case started.
+ */
+void lkp_verify_context_switches(const long long max, const LkpLineInfo info) {
+    LkpUsage now, used = {0};
+    lkp_measure_counters(&now);
+    lkp_add_usage(&used, caseSink != NULL ? &caseSink->start : &lukip.bodyStart, &now);
+    const long long switches = used.voluntarySwitches + used.involuntarySwitches;
+    lkp_verify_condition(
+        switches <= max, info,
+        "%lld context switches (%lld preempted) is more than the maximum of %lld.",
+        switches, used.involuntarySwitches, max
+    );
+}
+
+/** Sends the asserts of the calling thread to the sink (or back to the current test). */
+void lkp_set_case_sink(LkpCaseSink *sink) {
+    if (sink != NULL) {
+        lkp_measure_counters(&sink->start);
+    }
+    caseSink = sink;
+}
+
+/** Remembers the current test's failure count so lkp_end_require() can tell if it grew. */
+void lkp_begin_require() {
+    if (caseSink != NULL) {
+        return; // A case only keeps its first failure, so there's nothing to count.
+    }
+    lukip.requireMark = lukip.tests.data[lukip.tests.length - 1].failures.length;
+}
+
+/** Aborts the current test by jumping back to lkp_test_func() if the required assert failed. */
+void lkp_end_require() {
+    if (caseSink != NULL) {
+        if (caseSink->message != NULL && caseSink->jump != NULL) {
+            LKP_LONGJMP(*caseSink->jump, JUMP_REQUIRE);
+        }
+        return;
+    }
+    const int failures = lukip.tests.data[lukip.tests.length - 1].failures.length;
+    if (failures > lukip.requireMark && lukip.testJump != NULL) {
+        LKP_LONGJMP(*lukip.testJump, JUMP_REQUIRE);
+    }
+}
+
 /** Sets both the new setup and teardown to be called between each test. */
 void lkp_make_fixture(const LkpEmptyFunc newSetup, const LkpEmptyFunc newTeardown) {
     lukip.setup = newSetup;
@@ -502,6 +1876,8 @@ void lkp_raise_assert(const LkpRaiseType type, const LkpLineInfo info, const cha
 
     if (type == LKP_RAISE_FAIL) {
         assert_failure(info, message);
+    } else if (type == LKP_RAISE_WARN && caseSink != NULL) {
+        free(message); // Would be repeated by every case, and the cases can't share the array.
     } else if (type == LKP_RAISE_WARN) {
         LkpWarning warning = {.location=info, .message=message};
         LKP_APPEND_DA(&lukip.warnings, warning);
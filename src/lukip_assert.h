@@ -9,7 +9,9 @@
 #define LUKIP_ASSERT_H
 
 #include <inttypes.h>
+#include <limits.h>
 #include <stdarg.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -18,7 +20,18 @@
 #include <time.h>
 
 #include "lukip.h"
+#include "lukip_alloc_failure.h"
+#include "lukip_clock.h"
 #include "lukip_dynamic_array.h"
+#include "lukip_fake_io.h"
+#include "lukip_hash.h"
+#include "lukip_histogram.h"
+#include "lukip_latency.h"
+#include "lukip_mock.h"
+#include "lukip_options.h"
+#include "lukip_peer.h"
+#include "lukip_platform.h"
+#include "lukip_usage.h"
 
 /** Pastes all information before function call (file name, function name, and line.). */
 #define LKP_LINE_INFO \
@@ -43,6 +56,86 @@ typedef double LkpFloat;
 /** Pointer to function with no parameters or return value. */
 typedef void (*LkpEmptyFunc)();
 
+/** Pointer to a function which gets passed its suite's fixture (a pointer to the user's type). */
+typedef void (*LkpFixtureFunc)(void *fixture);
+
+/** Draws the generated inputs of a property's cases (defined in lukip_property.h). */
+typedef struct LkpGen LkpGen;
+
+/** Pointer to a property, which is a test that gets called with many generated inputs. */
+typedef void (*LkpPropertyFunc)(LkpGen *gen);
+
+/** Pointer to a fuzz test, which gets called with an input's bytes. */
+typedef void (*LkpFuzzFunc)(const uint8_t *data, const size_t size);
+
+/** Pointer to one implementation of a differential test, which writes an input's output. */
+typedef void (*LkpDiffFunc)(const void *input, void *output);
+
+/** Pointer to the generator of a differential test's inputs. */
+typedef void (*LkpDiffGenerator)(LkpGen *gen, void *input);
+
+/** Two implementations which should always give the same outputs, and their inputs. */
+typedef struct {
+    LkpDiffFunc reference;
+    LkpDiffFunc fast;
+    LkpDiffGenerator generator;
+    const char *referenceName;
+    const char *fastName;
+    size_t inputSize;
+    size_t outputSize;
+    int places; /** Places the outputs have to be equal within as LkpFloats, or -1 for bytes. */
+} LkpDifferential;
+
+/** A row of a parameterized test's file (defined in lukip_params.h). */
+typedef struct LkpRow LkpRow;
+
+/** Pointer to a parameterized test, which gets called with every row of a file. */
+typedef void (*LkpParamFunc)(const LkpRow *row);
+
+/** What a benchmark's MEASURE() times its runs into (defined in lukip_benchmark.h). */
+typedef struct LkpBench LkpBench;
+
+/** Pointer to a benchmark, which gets called with every input size of its range. */
+typedef void (*LkpBenchFunc)(LkpBench *bench, const long long n);
+
+/** Classes of how a benchmark's time grows with its input size, from the slowest growing. */
+typedef enum {
+    LKP_O_1,
+    LKP_O_LOG_N,
+    LKP_O_N,
+    LKP_O_N_LOG_N,
+    LKP_O_N_SQUARED,
+    LKP_O_N_CUBED,
+    LKP_O_ANY /** Declares no limit, so any class passes. */
+} LkpComplexity;
+
+/** The input sizes a benchmark runs over, and the class it has to stay within. */
+typedef struct {
+    long long from;
+    long long to; /** The largest size (inclusive). */
+    long long multiplier; /** What each size is multiplied by to get the next one (at least 2). */
+    LkpComplexity atMost;
+} LkpBenchRange;
+
+/** How long a benchmark's runs took at one input size, in its fastest round. */
+typedef struct {
+    long long n;
+    long long medianNs;
+    long long p99Ns;
+    long long runs; /** Runs timed in each round. */
+} LkpBenchPoint;
+
+/** Array of the sizes a benchmark ran at. */
+LKP_DECLARE_DA_STRUCT(LkpBenchPointArray, LkpBenchPoint);
+
+/** How a benchmark's time grew over its sizes, and the class that fits it best. */
+typedef struct {
+    LkpBenchPointArray points;
+    LkpComplexity complexity;
+    double coefficient; /** Nanoseconds per unit of the class, like per n log n. */
+    double error; /** Root mean square of the fit's error at each size, relative to its median. */
+} LkpScaling;
+
 /** An enum to differentiate between equal and unequal without an ambiguous bool. */
 typedef enum {
     LKP_ASSERT_EQUAL,
@@ -58,7 +151,8 @@ typedef enum {
 typedef enum {
     LKP_TEST_UNKNOWN,
     LKP_TEST_SUCCESS,
-    LKP_TEST_FAILURE
+    LKP_TEST_FAILURE,
+    LKP_TEST_CACHED /** Skipped because it passed last time and its inputs didn't change. */
 } LkpTestStatus;
 
 /**
@@ -81,6 +175,35 @@ typedef struct {
     int line;
 } LkpLineInfo;
 
+/** How an armed mock answers the calls it records. */
+typedef enum {
+    LKP_MOCK_SPY, /** Passes them on to the real function. */
+    LKP_MOCK_RETURN, /** Returns a fixed value (or nothing) without calling the real function. */
+    LKP_MOCK_FAKE /** Calls a replacement function instead. */
+} LkpMockBehavior;
+
+/** State shared by every mock generated with MOCK_FUNC(), whichever function it's for. */
+typedef struct LkpMock {
+    const char *name;
+    atomic_bool armed; /** Unarmed mocks go straight to the real function. */
+    LkpMockBehavior behavior;
+    atomic_llong calls; /** Calls since it was armed. */
+    long long expected; /** Calls expected by the end of the test, or -1 for any amount. */
+    LkpLineInfo expectedAt; /** Where the expectation was set. */
+    struct LkpMock *next; /** The next armed mock. */
+} LkpMock;
+
+/** Expects a death test to die in any way, whether it exits or gets killed. */
+#define LKP_ANY_DEATH INT_MIN
+
+/** The forked process of a death test, as seen from either side. */
+typedef struct {
+    int pid; /** The child's pid in the parent, or -1 if the fork failed. */
+    int output; /** The read end of the child's stderr in the parent. */
+    int survived; /** The pipe the child writes to if its statement finished. */
+    int error; /** The errno of a failed pipe() or fork(), or 0 if there was none. */
+} LkpDeathChild;
+
 /** Stores a failed assert's message and line where it was called. */
 typedef struct {
     char *message;
@@ -90,6 +213,16 @@ typedef struct {
 /** Array of failure asserts in test functions. */
 LKP_DECLARE_DA_STRUCT(LkpFailureArray, LkpFailure);
 
+/** The durations a latency assert measured, across every run of its test. */
+typedef struct {
+    const char *statement;
+    int line;
+    LkpHistogram *histogram; /** Allocated. */
+} LkpLatencyRecord;
+
+/** Array of the latency asserts a test measured. */
+LKP_DECLARE_DA_STRUCT(LkpLatencyArray, LkpLatencyRecord);
+
 typedef struct {
     char *message;
     LkpLineInfo location;
@@ -98,12 +231,67 @@ typedef struct {
 /** Array of warnings during testing. */
 LKP_DECLARE_DA_STRUCT(WarningArray, LkpWarning);
 
+/**
+ * @brief A group of tests which share a fixture that's only built once.
+ * 
+ * Suites can be nested, in which case the per-test setups of the outer suites
+ * run before the inner ones (and their teardowns after).
+ */
+typedef struct LkpSuite {
+    void *fixture;
+    LkpFixtureFunc setup;
+    LkpFixtureFunc teardown;
+    LkpFixtureFunc suiteTeardown;
+    struct LkpSuite *outer;
+} LkpSuite;
+
+/**
+ * @brief Collects the asserts of one generated case instead of the current test.
+ * 
+ * Cases run on many threads at once, so each one has its own sink,
+ * and only the first failure is kept since it's enough to tell the case failed.
+ */
+typedef struct {
+    LkpFuncInfo info; /** Where the first assert was called from. */
+    int asserts;
+    char *message; /** The first failure's message, or NULL if the case didn't fail. */
+    int line; /** The first failure's line. */
+    LkpJumpBuf *jump; /** Where a failed REQUIRE() skips the rest of the case to. */
+    LkpUsage start; /** The counters of the case's thread when it started. */
+} LkpCaseSink;
+
 /** Information of a function used for testing as a whole. */
 typedef struct {
     LkpFailureArray failures;
     LkpLineInfo caller;
     LkpFuncInfo info;
+    const char *name;
     LkpEmptyFunc testFunc;
+    LkpFixtureFunc fixtureFunc;
+    LkpPropertyFunc propertyFunc;
+    int cases;
+    LkpFuzzFunc fuzzFunc;
+    const LkpDifferential *differential;
+    LkpParamFunc paramFunc;
+    const char *paramPath;
+    size_t recordSize; /** Size of the records in paramPath, or 0 if it's a CSV file. */
+    LkpBenchFunc benchFunc;
+    LkpBenchRange benchRange;
+    LkpSuite *suite;
+    LkpEmptyFunc setup;
+    LkpEmptyFunc teardown;
+    int timeout;
+    bool isolated;
+    bool exhaustiveAlloc; /** Whether to run it again for every allocation site, failing it. */
+    bool timedOut;
+    char *output; /** What it printed while captured, only kept if it failed. */
+    int runs; /** How many times it ran (more than once with --repeat). */
+    int passedRuns;
+    double meanMs; /** Average time of a run. */
+    double squaredDeviations; /** Sum of each run's squared distance from the mean (Welford's). */
+    LkpUsage usage; /** What every run of its body changed, summed. */
+    LkpLatencyArray latencies;
+    LkpScaling scaling; /** What the last run of a benchmark fitted, without points otherwise. */
 } LkpTestFunc;
 
 /** An array of tested functions. */
@@ -112,11 +300,25 @@ LKP_DECLARE_DA_STRUCT(LkpTestFuncArray, LkpTestFunc);
 /** The main struct which stores the fields used for unit-testing. */
 typedef struct {
     LkpTestFuncArray tests;
+    LkpTestFuncArray pending;
     WarningArray warnings;
+    LkpOptions options;
+    LkpDependencies dependencies;
 
     LkpEmptyFunc setup;
     LkpEmptyFunc teardown;
+    LkpSuite *suite;
+    LkpJumpBuf *testJump;
+    int requireMark;
+    bool recordAllocationSites; /** Whether the next test body records its allocation sites. */
+    uintptr_t failingSite; /** Site whose next allocation fails in the next test body, or 0. */
+    int defaultTimeout;
+    bool isolated;
+    bool deferTests;
+    int skippedTests;
+    LkpEmptyFunc suiteTeardown;
     clock_t startTime;
+    LkpUsage bodyStart; /** The counters of when the current test's body started. */
     int asserts;
     int failedAsserts;
     bool hasFailed;
@@ -125,6 +327,24 @@ typedef struct {
 /** Initializes the Lukip unit. */
 void init_lukip();
 
+/**
+ * @brief Initializes the Lukip unit with the options passed to the program.
+ * 
+ * @param argc The amount of arguments.
+ * @param argv The arguments, where the first one is the program's name.
+ */
+void init_lukip_args(const int argc, char **argv);
+
+/** Runs the tests which were deferred to be reordered. */
+void lkp_run_tests();
+
+/**
+ * @brief Adds a file (like an object file) whose changes should make every test run again.
+ * 
+ * @param path The file's path, which has to outlive the program's tests (a literal usually).
+ */
+void lkp_add_dependency(const char *path);
+
 /** Ends the Lukip unit*/
 void end_lukip();
 
@@ -135,6 +355,24 @@ void end_lukip();
  */
 int lkp_status();
 
+/**
+ * @brief Returns whether a repeated test passed some of its runs but not all of them.
+ * 
+ * @param test The test.
+ * 
+ * @return True if it's flaky, which can only be known after running it more than once.
+ */
+bool lkp_is_flaky(const LkpTestFunc *test);
+
+/**
+ * @brief Returns the standard deviation of how long a test's runs took.
+ * 
+ * @param test The test.
+ * 
+ * @return The deviation in milliseconds, or 0 if it ran less than twice.
+ */
+double lkp_time_deviation(const LkpTestFunc *test);
+
 /** 
  * @brief Allocates a formatted string.
  * 
@@ -145,6 +383,17 @@ int lkp_status();
  */
 char *lkp_strf_alloc(const char *format, ...);
 
+/**
+ * @brief Allocates bytes as printable text, escaping newlines, quotes and anything unprintable.
+ * 
+ * @param data The bytes.
+ * @param size How many there are.
+ * @param limit How many get shown at most, where the text ends with "..." if there are more.
+ * 
+ * @return The text, which has to be freed.
+ */
+char *lkp_escape_bytes(const char *data, const size_t size, const size_t limit);
+
 /** Makes both a new setup and a new teardown. */
 void lkp_make_fixture(const LkpEmptyFunc newSetup, const LkpEmptyFunc newTeardown);
 
@@ -154,13 +403,465 @@ void lkp_make_setup(const LkpEmptyFunc newSetup);
 /** Calls passed teardown function after every test. */
 void lkp_make_teardown(const LkpEmptyFunc newTeardown);
 
+/**
+ * @brief Starts a suite, and runs its one-time setup on a freshly zeroed fixture.
+ * 
+ * @param fixtureSize The size of the user's fixture type.
+ * @param suiteSetup Called once now with the fixture (can be NULL).
+ * @param suiteTeardown Called once at lkp_end_suite() with the fixture (can be NULL).
+ */
+void lkp_begin_suite(
+    const size_t fixtureSize, const LkpFixtureFunc suiteSetup, const LkpFixtureFunc suiteTeardown
+);
+
+/** Sets the setup and teardown called around every test of the current suite. */
+void lkp_make_suite_fixture(const LkpFixtureFunc newSetup, const LkpFixtureFunc newTeardown);
+
+/** Ends the current suite by calling its one-time teardown and freeing its fixture. */
+void lkp_end_suite();
+
+/**
+ * @brief Performs a unit test on a function which takes the current suite's fixture.
+ * 
+ * @param funcToTest The function to be tested.
+ * @param name The name of the function to be tested.
+ * @param caller Information about the place where the TEST_FIXTURE() call was made.
+ */
+void lkp_test_fixture_func(
+    const LkpFixtureFunc funcToTest, const char *name, const LkpLineInfo caller
+);
+
+/** Turns running each test in its own forked process on or off. */
+void lkp_set_isolation(const bool isolated);
+
+/**
+ * @brief Runs a one-time suite setup, then forks every following test from this warmed process.
+ * 
+ * @param suiteSetup Called once right away (can be NULL).
+ * @param suiteTeardown Called once at the end of the program (can be NULL).
+ */
+void lkp_make_zygote(const LkpEmptyFunc suiteSetup, const LkpEmptyFunc suiteTeardown);
+
+/** Sets the timeout in milliseconds of tests which don't have their own (0 for none). */
+void lkp_set_default_timeout(const int milliseconds);
+
 /**
  * @brief Performs a unit test on a function.
  * 
  * @param funcToTest The function to be tested.
+ * @param name The name of the function to be tested.
  * @param caller Information about the place where the TEST() call was made.
  */
-void lkp_test_func(const LkpEmptyFunc funcToTest, const LkpLineInfo caller);
+void lkp_test_func(const LkpEmptyFunc funcToTest, const char *name, const LkpLineInfo caller);
+
+/**
+ * @brief Performs a unit test on a function, which fails if it takes too long.
+ * 
+ * @param funcToTest The function to be tested.
+ * @param name The name of the function to be tested.
+ * @param milliseconds How long the test can run before it's skipped as timed out.
+ * @param caller Information about the place where the TEST_TIMEOUT() call was made.
+ */
+void lkp_test_func_timeout(
+    const LkpEmptyFunc funcToTest, const char *name, const int milliseconds,
+    const LkpLineInfo caller
+);
+
+/**
+ * @brief Runs a property against many generated cases, and shrinks the first failing one.
+ * 
+ * @param funcToTest The property.
+ * @param name The property's name.
+ * @param cases How many cases to generate.
+ * @param caller Information about the place where the TEST_PROPERTY() call was made.
+ */
+void lkp_test_property(
+    const LkpPropertyFunc funcToTest, const char *name, const int cases, const LkpLineInfo caller
+);
+
+/**
+ * @brief Runs a benchmark over a range of input sizes, and fits its times to a complexity class.
+ * 
+ * @param funcToTest The benchmark.
+ * @param name The benchmark's name.
+ * @param range The sizes to run it at, and the class it fails past (or LKP_O_ANY).
+ * @param caller Information about the place where the BENCHMARK_RANGE() call was made.
+ */
+void lkp_test_benchmark(
+    const LkpBenchFunc funcToTest, const char *name, const LkpBenchRange range,
+    const LkpLineInfo caller
+);
+
+/** Returns how many runs MEASURE() should time at the benchmark's current size. */
+int lkp_bench_iterations(const LkpBench *bench);
+
+/** Adds the durations of a MEASURE() to the benchmark's current size. */
+void lkp_bench_record(LkpBench *bench, const LkpHistogram *histogram);
+
+/**
+ * @brief Generates an integer, which shrinks towards 0 (or the bound closest to it).
+ * 
+ * @param gen The case's generator.
+ * @param min The smallest value allowed.
+ * @param max The largest value allowed.
+ * 
+ * @return The generated integer.
+ */
+LkpInt lkp_gen_int(LkpGen *gen, const LkpInt min, const LkpInt max);
+
+/**
+ * @brief Generates a float, which shrinks towards 0 (or the bound closest to it).
+ * 
+ * @param gen The case's generator.
+ * @param min The smallest value allowed.
+ * @param max The largest value allowed.
+ * 
+ * @return The generated float.
+ */
+LkpFloat lkp_gen_float(LkpGen *gen, const LkpFloat min, const LkpFloat max);
+
+/**
+ * @brief Fills a buffer with a generated amount of random bytes, which shrink to fewer zeroes.
+ * 
+ * @param gen The case's generator.
+ * @param[out] buffer Where the bytes are written.
+ * @param maxLength The most bytes that can be generated.
+ * 
+ * @return How many bytes were generated.
+ */
+int lkp_gen_bytes(LkpGen *gen, void *buffer, const int maxLength);
+
+/**
+ * @brief Fills a buffer with a generated, NUL terminated string of printable characters.
+ * 
+ * @param gen The case's generator.
+ * @param[out] buffer Where the string is written, which has to hold maxLength + 1 characters.
+ * @param maxLength The longest the string can be.
+ * 
+ * @return The string's length.
+ */
+int lkp_gen_string(LkpGen *gen, char *buffer, const int maxLength);
+
+/**
+ * @brief Runs a fuzz test on its saved inputs, after fuzzing it for new ones in fuzzing builds.
+ * 
+ * @param funcToTest The fuzz test.
+ * @param name The fuzz test's name, which is also the directory of its inputs.
+ * @param caller Information about the place where the TEST_FUZZ() call was made.
+ */
+void lkp_test_fuzz(const LkpFuzzFunc funcToTest, const char *name, const LkpLineInfo caller);
+
+/**
+ * @brief Runs a test, then runs it again for every allocation site it hit with that site failing.
+ * 
+ * @param funcToTest The test.
+ * @param name The test's name.
+ * @param caller Information about the place where the EXHAUSTIVE_ALLOC_FAILURE() call was made.
+ */
+void lkp_test_exhaustive_alloc(
+    const LkpEmptyFunc funcToTest, const char *name, const LkpLineInfo caller
+);
+
+/**
+ * @brief Makes an allocation of the current test fail, or fails the test if that's unsupported.
+ * 
+ * @param nth Which allocation from now fails (starting from 1), or 0 to stop failing them.
+ * @param info Where it was called from.
+ */
+void lkp_inject_allocation_failure(const long long nth, const LkpLineInfo info);
+
+/**
+ * @brief Makes a fraction of the current test's allocations fail, seeded by --seed.
+ * 
+ * @param fraction The chance of every allocation failing, between 0 and 1.
+ * @param info Where it was called from.
+ */
+void lkp_inject_random_allocation_failures(const double fraction, const LkpLineInfo info);
+
+/**
+ * @brief Makes the clocks virtual until the end of the test's body, or fails the test if it can't.
+ * 
+ * @param info Where it was called from.
+ */
+void lkp_use_virtual_clock(const LkpLineInfo info);
+
+/**
+ * @brief Moves the virtual clock forward, or fails the test if it isn't running.
+ * 
+ * @param milliseconds How far to move it.
+ * @param info Where it was called from.
+ */
+void lkp_advance_virtual_clock(const long long milliseconds, const LkpLineInfo info);
+
+/**
+ * @brief Keeps the files under a prefix in memory until the end of the test's body.
+ * 
+ * @param prefix The start of the faked paths.
+ * @param info Where it was called from.
+ */
+void lkp_use_fake_files(const char *prefix, const LkpLineInfo info);
+
+/**
+ * @brief Makes calls on the files under a prefix fail, or fails the test if that's unsupported.
+ * 
+ * @param operation Which call fails.
+ * @param prefix The start of the paths it fails for.
+ * @param nth Which matching call from now fails (starting from 1), or 0 for all of them.
+ * @param error The errno it fails with.
+ * @param info Where it was called from.
+ */
+void lkp_inject_io_fault(
+    const LkpIoOperation operation, const char *prefix, const long long nth, const int error,
+    const LkpLineInfo info
+);
+
+/**
+ * @brief Makes reads or writes on the files under a prefix only go partway through.
+ * 
+ * @param operation LKP_IO_READ or LKP_IO_WRITE, where anything else fails the test.
+ * @param prefix The start of the paths it's for.
+ * @param nth Which matching call from now is cut short (starting from 1), or 0 for all of them.
+ * @param bytes The most bytes the call transfers.
+ * @param info Where it was called from.
+ */
+void lkp_inject_short_io(
+    const LkpIoOperation operation, const char *prefix, const long long nth,
+    const long long bytes, const LkpLineInfo info
+);
+
+/**
+ * @brief Makes a scripted peer, or fails the test if it couldn't.
+ * 
+ * @param kind How the code under test reaches it.
+ * @param info Where it was called from.
+ * 
+ * @return The peer, or NULL if it failed (which the other peer functions ignore).
+ */
+LkpPeer *lkp_new_peer(const LkpPeerKind kind, const LkpLineInfo info);
+
+/**
+ * @brief Starts running a peer's script, or fails the test if it couldn't.
+ * 
+ * @param peer The peer.
+ * @param info Where it was called from.
+ */
+void lkp_run_peer(LkpPeer *peer, const LkpLineInfo info);
+
+/**
+ * @brief Stops and frees a peer, failing the test if its script didn't run as expected.
+ * 
+ * @param peer The peer.
+ * @param info Where it was called from.
+ */
+void lkp_finish_peer(LkpPeer *peer, const LkpLineInfo info);
+
+/**
+ * @brief Arms a mock until the end of the test, or fails the test if its function isn't wrapped.
+ * 
+ * Its calls are counted from the first time it's armed in the test.
+ * 
+ * @param mock The mock.
+ * @param behavior How it answers calls from now on.
+ * @param wrapped Whether the program was linked with --wrap for the mocked function.
+ * @param info Where it was called from.
+ */
+void lkp_arm_mock(
+    LkpMock *mock, const LkpMockBehavior behavior, const bool wrapped, const LkpLineInfo info
+);
+
+/**
+ * @brief Expects a mock to be called an exact amount of times by the end of the test's body.
+ * 
+ * Arms it to pass calls on to the real function if it wasn't armed already.
+ * The count gets verified with lkp_verify_condition() once the body ends.
+ * 
+ * @param mock The mock.
+ * @param times How many calls it expects.
+ * @param wrapped Whether the program was linked with --wrap for the mocked function.
+ * @param info Where it was called from.
+ */
+void lkp_expect_mock_calls(
+    LkpMock *mock, const long long times, const bool wrapped, const LkpLineInfo info
+);
+
+/**
+ * @brief Finds where a call's arguments are in a mock's ring, failing the test if they aren't.
+ * 
+ * A failed lookup skips the rest of the test like a REQUIRE(), so nothing reads the arguments.
+ * 
+ * @param mock The mock.
+ * @param call The call's index since the mock was armed, starting from 0.
+ * @param info Where it was called from.
+ * 
+ * @return The index of the call in the ring, or -1 if it was never made or got overwritten
+ *     (only returned where there's no test to skip the rest of).
+ */
+int lkp_mock_slot(LkpMock *mock, const long long call, const LkpLineInfo info);
+
+/** Sends a mock's calls back to the real function, dropping its expectation unverified. */
+void lkp_disarm_mock(LkpMock *mock);
+
+/**
+ * @brief Forks for a death test, where the child runs the statement and the parent verifies it.
+ * 
+ * The child can't jump out of its statement (so failed REQUIRE()s just carry on),
+ * and has no watchdog. Only the thread that forked exists in the child.
+ * 
+ * @param[out] child The forked child.
+ * 
+ * @return True in the child, and false in the parent (or if it couldn't fork).
+ */
+bool lkp_fork_death(LkpDeathChild *child);
+
+/** Exits the child of a death test after its statement finished without dying. */
+void lkp_survive_death(LkpDeathChild *child);
+
+/**
+ * @brief Verifies how a death test's statement died, and what it wrote to stderr.
+ * 
+ * Gets recorded as an assert of the current test, or as a warning where there's no fork().
+ * 
+ * @param child The forked child.
+ * @param death The exit status it should have exited with, the negated signal that should've
+ *     killed it, or LKP_ANY_DEATH.
+ * @param pattern An extended regex its stderr should match, or NULL for any stderr.
+ * @param statement The statement's text.
+ * @param info Where it was called from.
+ */
+void lkp_verify_death(
+    LkpDeathChild *child, const int death, const char *pattern, const char *statement,
+    const LkpLineInfo info
+);
+
+/**
+ * @brief Verifies that the current test's body hasn't faulted in more pages than the maximum.
+ * 
+ * @param max The most minor and major page faults since the body started.
+ * @param info Where it was called from.
+ */
+void lkp_verify_page_faults(const long long max, const LkpLineInfo info);
+
+/**
+ * @brief Verifies that the current test's body hasn't been switched out more than the maximum.
+ * 
+ * @param max The most voluntary and involuntary context switches since the body started.
+ * @param info Where it was called from.
+ */
+void lkp_verify_context_switches(const long long max, const LkpLineInfo info);
+
+/**
+ * @brief Verifies that a timed statement's runs stayed below a budget at a percentile.
+ * 
+ * Fails with the distribution of the runs, which are also kept in the test for its reports.
+ * 
+ * @param histogram The durations of the statement's runs.
+ * @param percentile The percentile to compare, like 99 for p99.
+ * @param budget The nanoseconds it has to stay below.
+ * @param statement The statement's text.
+ * @param info Where it was called from.
+ */
+void lkp_verify_latency(
+    const LkpHistogram *histogram, const double percentile, const long long budget,
+    const char *statement, const LkpLineInfo info
+);
+
+/**
+ * @brief Verifies that an operation stayed below a budget at a percentile, run on many threads.
+ * 
+ * @param operation The operation, which is timed by lkp_stress_latency().
+ * @param context Passed to every run of the operation.
+ * @param threads How many threads to run it on.
+ * @param iterations How many runs to time on each thread.
+ * @param percentile The percentile to compare, like 99 for p99.
+ * @param budget The nanoseconds it has to stay below.
+ * @param name The operation's name.
+ * @param info Where it was called from.
+ */
+void lkp_verify_stress(
+    const LkpStressFunc operation, void *context, const int threads, const int iterations,
+    const double percentile, const long long budget, const char *name, const LkpLineInfo info
+);
+
+/**
+ * @brief Compares two implementations on many generated inputs, and times both of them.
+ * 
+ * @param differential The implementations and their inputs.
+ * @param name The differential test's name.
+ * @param cases How many inputs to generate.
+ * @param caller Information about the place where the TEST_DIFFERENTIAL() call was made.
+ */
+void lkp_test_differential(
+    const LkpDifferential *differential, const char *name, const int cases,
+    const LkpLineInfo caller
+);
+
+/**
+ * @brief Runs a parameterized test on every row of a file, reporting each failing row by index.
+ * 
+ * @param funcToTest The parameterized test.
+ * @param name The parameterized test's name.
+ * @param path The file of the rows.
+ * @param recordSize The size of a binary file's records, or 0 if the file is a CSV.
+ * @param caller Information about the place where the TEST_PARAMS_*() call was made.
+ */
+void lkp_test_params(
+    const LkpParamFunc funcToTest, const char *name, const char *path, const size_t recordSize,
+    const LkpLineInfo caller
+);
+
+/** Returns how many fields a CSV row has. */
+int lkp_row_fields(const LkpRow *row);
+
+/**
+ * @brief Copies a field of a CSV row into a NUL terminated buffer.
+ * 
+ * Fails the row if the field doesn't exist or doesn't fit in the buffer.
+ * 
+ * @param row The row.
+ * @param field The field's index, starting from 0.
+ * @param[out] buffer Where the field is copied.
+ * @param size The size of the buffer, including the NUL terminator.
+ * @param info Where the field was read from, for the failure.
+ * 
+ * @return The field's length, or -1 if it failed.
+ */
+int lkp_row_string(
+    const LkpRow *row, const int field, char *buffer, const int size, const LkpLineInfo info
+);
+
+/** Parses a field of a CSV row as an integer, failing the row (and returning 0) if it isn't one. */
+LkpInt lkp_row_int(const LkpRow *row, const int field, const LkpLineInfo info);
+
+/** Parses a field of a CSV row as a float, failing the row (and returning 0) if it isn't one. */
+LkpFloat lkp_row_float(const LkpRow *row, const int field, const LkpLineInfo info);
+
+/**
+ * @brief Returns the record of a binary file's row.
+ * 
+ * Fails the row (and returns NULL) if the record isn't the passed size.
+ * 
+ * @param row The row.
+ * @param size The size of the record's type.
+ * @param info Where the record was read from, for the failure.
+ * 
+ * @return A pointer to the record inside of the file.
+ */
+const void *lkp_row_record(const LkpRow *row, const size_t size, const LkpLineInfo info);
+
+/**
+ * @brief Sends the asserts of the calling thread to a case's sink instead of the current test.
+ * 
+ * Setting a sink also takes the thread's counters, which its usage asserts count from.
+ * 
+ * @param sink The sink, or NULL to go back to recording into the current test.
+ */
+void lkp_set_case_sink(LkpCaseSink *sink);
+
+/** Remembers how many failures the current test had before a fatal assert. */
+void lkp_begin_require();
+
+/** Jumps out of the current test if it failed since the last lkp_begin_require(). */
+void lkp_end_require();
 
 /**
  * @brief Verifies that a condition is true.
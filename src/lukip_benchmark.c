@@ -0,0 +1,216 @@
+/**
+ * @file lukip_benchmark.c
+ * @brief Runs benchmarks over their input sizes and fits complexity classes to their times.
+ * 
+ * @author Larmix
+ */
+
+#include <stdlib.h>
+
+#include "lukip_allocator.h"
+#include "lukip_benchmark.h"
+#include "lukip_dynamic_array.h"
+
+/** The natural logarithm of 2, to turn logarithms into base 2 ones. */
+#define LN_2 0.6931471805599453
+
+/** Every class a benchmark can be fit to, in the order ties are won. */
+static const LkpComplexity fittedClasses[] = {
+    LKP_O_1, LKP_O_LOG_N, LKP_O_N, LKP_O_N_LOG_N, LKP_O_N_SQUARED, LKP_O_N_CUBED
+};
+
+/** Takes the natural logarithm of a positive number with an atanh series, so we don't need -lm. */
+static double natural_log(double value) {
+    int powers = 0;
+    while (value >= 2) {
+        value /= 2;
+        powers++;
+    }
+    while (value < 1) {
+        value *= 2;
+        powers--;
+    }
+    // ln(x) = 2 * atanh((x - 1) / (x + 1)), where x in [1, 2) converges quickly.
+    const double ratio = (value - 1) / (value + 1), squared = ratio * ratio;
+    double term = ratio, sum = 0;
+    for (int i = 0; i < 24; i++) {
+        sum += term / (2 * i + 1);
+        term *= squared;
+    }
+    return 2 * sum + powers * LN_2;
+}
+
+/** Takes a square root with Newton's method, so we don't need -lm. */
+static double square_root(const double value) {
+    if (value <= 0) {
+        return 0;
+    }
+    double root = value > 1 ? value : 1;
+    for (int i = 0; i < 64; i++) {
+        root = (root + value / root) / 2;
+    }
+    return root;
+}
+
+/** Returns the curve of a complexity class at a size, without its coefficient. */
+static double class_curve(const LkpComplexity complexity, const double n) {
+    const double log2n = natural_log(n) / LN_2;
+    switch (complexity) {
+    case LKP_O_1: return 1;
+    case LKP_O_LOG_N: return log2n;
+    case LKP_O_N: return n;
+    case LKP_O_N_LOG_N: return n * log2n;
+    case LKP_O_N_SQUARED: return n * n;
+    case LKP_O_N_CUBED: return n * n * n;
+    default: return 0;
+    }
+}
+
+/** Returns a size's median time, where anything too fast to measure counts as 1 ns. */
+static double point_time(const LkpBenchPoint *point) {
+    return point->medianNs > 0 ? point->medianNs : 1;
+}
+
+/** Returns the unit of a class's coefficient, like "n log n" (empty for constant ones). */
+static const char *class_unit(const LkpComplexity complexity) {
+    switch (complexity) {
+    case LKP_O_LOG_N: return " * log n";
+    case LKP_O_N: return " * n";
+    case LKP_O_N_LOG_N: return " * n log n";
+    case LKP_O_N_SQUARED: return " * n^2";
+    case LKP_O_N_CUBED: return " * n^3";
+    default: return "";
+    }
+}
+
+/**
+ * @brief Runs the benchmark once at a size, with some amount of timed runs.
+ * 
+ * @param func The benchmark.
+ * @param bench Its state, whose histogram is emptied first.
+ * @param n The size.
+ * @param iterations How many runs each MEASURE() times.
+ * 
+ * @return Whether the benchmark measured anything.
+ */
+static bool run_size(
+    const LkpBenchFunc func, LkpBench *bench, const long long n, const int iterations
+) {
+    bench->iterations = iterations;
+    lkp_init_histogram(&bench->histogram);
+    func(bench, n);
+    return bench->histogram.total > 0;
+}
+
+/** Gives MEASURE() the amount of runs picked for the current size. */
+int lkp_bench_iterations(const LkpBench *bench) {
+    return bench->iterations;
+}
+
+/** Merges every MEASURE() of a size, so a benchmark that measures twice counts both. */
+void lkp_bench_record(LkpBench *bench, const LkpHistogram *histogram) {
+    lkp_merge_histogram(&bench->histogram, histogram);
+}
+
+/** Picks how many runs of a size add up to the target, from how long a single run took. */
+static int runs_for(const long long probe) {
+    const long long iterations = LKP_BENCH_TARGET_NS / (probe > 0 ? probe : 1);
+    if (iterations < LKP_BENCH_MIN_RUNS) {
+        return LKP_BENCH_MIN_RUNS;
+    }
+    return iterations > LKP_BENCH_MAX_RUNS ? LKP_BENCH_MAX_RUNS : (int)iterations;
+}
+
+/** The probes also warm up the code, and the rounds go over every size before repeating one. */
+void lkp_run_benchmark(const LkpBenchFunc func, const LkpBenchRange *range, LkpScaling *scaling) {
+    LKP_INIT_DA(&scaling->points);
+    const long long multiplier = range->multiplier >= 2 ? range->multiplier : 2;
+    LkpBench *bench = lkp_allocate(1, sizeof(LkpBench));
+    for (long long n = range->from >= 1 ? range->from : 1; n <= range->to; n *= multiplier) {
+        if (run_size(func, bench, n, 1)) {
+            const LkpBenchPoint point = {
+                .n = n, .medianNs = -1, .p99Ns = -1, .runs = runs_for(bench->histogram.max)
+            };
+            LKP_APPEND_DA(&scaling->points, point);
+        }
+        if (n > range->to / multiplier) {
+            break;
+        }
+    }
+    for (int round = 0; round < LKP_BENCH_ROUNDS; round++) {
+        for (int i = 0; i < scaling->points.length; i++) {
+            LkpBenchPoint *point = &scaling->points.data[i];
+            run_size(func, bench, point->n, (int)point->runs);
+            const long long median = lkp_histogram_percentile(&bench->histogram, 50);
+            if (point->medianNs == -1 || median < point->medianNs) {
+                point->medianNs = median;
+                point->p99Ns = lkp_histogram_percentile(&bench->histogram, 99);
+            }
+        }
+    }
+    free(bench);
+    lkp_fit_complexity(scaling);
+}
+
+/**
+ * The errors are relative to each size's time, so every size counts the same instead of
+ * the largest (and noisiest) one deciding the fit. Minimizing the sum of ((t - c * f) / t)^2
+ * gives c = sum(f / t) / sum((f / t)^2).
+ */
+void lkp_fit_complexity(LkpScaling *scaling) {
+    scaling->complexity = LKP_O_1;
+    scaling->coefficient = 0;
+    scaling->error = 0;
+    if (scaling->points.length == 0) {
+        return;
+    }
+    double bestError = -1;
+    for (size_t i = 0; i < sizeof(fittedClasses) / sizeof(fittedClasses[0]); i++) {
+        double curveOverTime = 0, squared = 0;
+        for (int j = 0; j < scaling->points.length; j++) {
+            const LkpBenchPoint *point = &scaling->points.data[j];
+            const double relative = class_curve(fittedClasses[i], point->n) / point_time(point);
+            curveOverTime += relative;
+            squared += relative * relative;
+        }
+        if (squared <= 0) {
+            continue;
+        }
+        const double coefficient = curveOverTime / squared;
+        double squaredErrors = 0;
+        for (int j = 0; j < scaling->points.length; j++) {
+            const LkpBenchPoint *point = &scaling->points.data[j];
+            const double fitted = coefficient * class_curve(fittedClasses[i], point->n);
+            const double error = (point_time(point) - fitted) / point_time(point);
+            squaredErrors += error * error;
+        }
+        const double error = square_root(squaredErrors / scaling->points.length);
+        if (bestError < 0 || error < bestError) {
+            bestError = error;
+            scaling->complexity = fittedClasses[i];
+            scaling->coefficient = coefficient;
+            scaling->error = error;
+        }
+    }
+}
+
+/** Names the classes the way they're usually written. */
+const char *lkp_complexity_name(const LkpComplexity complexity) {
+    switch (complexity) {
+    case LKP_O_1: return "O(1)";
+    case LKP_O_LOG_N: return "O(log n)";
+    case LKP_O_N: return "O(n)";
+    case LKP_O_N_LOG_N: return "O(n log n)";
+    case LKP_O_N_SQUARED: return "O(n^2)";
+    case LKP_O_N_CUBED: return "O(n^3)";
+    default: return "any complexity";
+    }
+}
+
+/** Shows the class, its coefficient with its unit, and how far off the fit was in percent. */
+char *lkp_describe_scaling(const LkpScaling *scaling) {
+    return lkp_strf_alloc(
+        "%s, about %.3g ns%s with %.1lf%% error", lkp_complexity_name(scaling->complexity),
+        scaling->coefficient, class_unit(scaling->complexity), scaling->error * 100
+    );
+}
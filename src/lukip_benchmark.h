@@ -0,0 +1,73 @@
+/**
+ * @file lukip_benchmark.h
+ * @brief Header for benchmarks over ranges of input sizes, and fitting them to complexity classes.
+ * 
+ * @author Larmix
+ */
+
+#ifndef LUKIP_BENCHMARK_H
+#define LUKIP_BENCHMARK_H
+
+#include "lukip_assert.h"
+#include "lukip_histogram.h"
+
+/** How many nanoseconds the timed runs of each size should add up to, roughly. */
+#define LKP_BENCH_TARGET_NS 10000000LL
+
+/** The fewest runs timed at a size, no matter how slow they are. */
+#define LKP_BENCH_MIN_RUNS 5
+
+/** The most runs timed at a size, no matter how fast they are. */
+#define LKP_BENCH_MAX_RUNS 100000
+
+/** How many times every size is timed, where only its fastest time counts. */
+#define LKP_BENCH_ROUNDS 3
+
+/** The fewest sizes which can tell the complexity classes apart. */
+#define LKP_BENCH_MIN_SIZES 3
+
+/** The state of a benchmark at its current input size. */
+struct LkpBench {
+    int iterations; /** How many runs MEASURE() times. */
+    LkpHistogram histogram; /** Durations of every MEASURE() at the current size. */
+};
+
+/**
+ * @brief Runs a benchmark at every size of its range, then fits a complexity class to it.
+ * 
+ * Each size first runs the benchmark once with a single timed run, to pick how many runs
+ * add up to about LKP_BENCH_TARGET_NS. Then every size runs with that many in each of
+ * LKP_BENCH_ROUNDS rounds, and the lowest median of its rounds counts, so a slowdown
+ * of the whole machine during one round doesn't bend the curve.
+ * Sizes where the benchmark never called MEASURE() are left out.
+ * 
+ * @param func The benchmark.
+ * @param range The sizes to run it at.
+ * @param[out] scaling The points and their fit, whose points have to be freed with LKP_FREE_DA().
+ */
+void lkp_run_benchmark(const LkpBenchFunc func, const LkpBenchRange *range, LkpScaling *scaling);
+
+/**
+ * @brief Finds the complexity class whose curve is closest to the points' medians.
+ * 
+ * Every class is fit with least squares as coefficient * f(n) on the errors relative to
+ * each size's time, and the one with the lowest root mean square of them wins,
+ * where a tie goes to the slower growing class.
+ * 
+ * @param scaling The points, whose complexity, coefficient and error get set.
+ */
+void lkp_fit_complexity(LkpScaling *scaling);
+
+/** Returns a complexity class as text, like "O(n log n)". */
+const char *lkp_complexity_name(const LkpComplexity complexity);
+
+/**
+ * @brief Describes a fit, like "O(n), about 1.2 ns * n with 3.4% error".
+ * 
+ * @param scaling The fitted points.
+ * 
+ * @return The description, allocated.
+ */
+char *lkp_describe_scaling(const LkpScaling *scaling);
+
+#endif
@@ -0,0 +1,160 @@
+/**
+ * @file lukip_cache.c
+ * @brief Keeps test results between runs in a small tab-separated file.
+ * 
+ * Every line is a test's status character (the same ones shown in the results),
+ * the file it was called from, its name, the file it's defined in and the hash of its inputs.
+ * 
+ * @author Larmix
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lukip_cache.h"
+
+/** Longest line read from a cache file. */
+#define LINE_LENGTH 1024
+
+/** Allocates a copy of a string. */
+static char *copy_string(const char *string) {
+    const size_t length = strlen(string) + 1;
+    char *copy = lkp_allocate((int)length, sizeof(char));
+    memcpy(copy, string, length);
+    return copy;
+}
+
+/** Converts a status to the character that's saved for it. */
+static char status_to_char(const LkpTestStatus status) {
+    if (status == LKP_TEST_FAILURE) {
+        return 'F';
+    }
+    return status == LKP_TEST_SUCCESS ? '.' : '?';
+}
+
+/** Converts a saved character back to its status. */
+static LkpTestStatus char_to_status(const char statusChar) {
+    if (statusChar == 'F') {
+        return LKP_TEST_FAILURE;
+    }
+    return statusChar == '.' ? LKP_TEST_SUCCESS : LKP_TEST_UNKNOWN;
+}
+
+/** Appends a new entry with copies of the passed names. */
+static LkpCacheEntry *append_entry(
+    LkpCache *cache, const char *fileName, const char *testName, const char *definedIn,
+    const uint64_t hash, const LkpTestStatus status
+) {
+    LkpCacheEntry entry = {
+        .fileName = copy_string(fileName), .testName = copy_string(testName),
+        .definedIn = copy_string(definedIn), .hash = hash, .status = status, .updated = false
+    };
+    LKP_APPEND_DA(cache, entry);
+    return &cache->data[cache->length - 1];
+}
+
+/** Cuts the line at the next tab, returning what's after it or NULL if there's no tab. */
+static char *next_field(char *field) {
+    char *tab = field == NULL ? NULL : strchr(field, '\t');
+    if (tab == NULL) {
+        return NULL;
+    }
+    *tab = '\0';
+    return tab + 1;
+}
+
+/** Reads every "status\tfile\tname\tdefinedIn\thash" line, and skips malformed ones. */
+void lkp_load_cache(LkpCache *cache, const char *path) {
+    LKP_INIT_DA(cache);
+    if (path == NULL) {
+        return;
+    }
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        return;
+    }
+    char line[LINE_LENGTH];
+    while (fgets(line, LINE_LENGTH, file) != NULL) {
+        line[strcspn(line, "\n")] = '\0';
+        char *fileName = next_field(line);
+        char *testName = next_field(fileName);
+        if (testName == NULL) {
+            continue;
+        }
+        // Files from before hashes were kept just don't have the last 2 fields.
+        char *definedIn = next_field(testName);
+        char *hash = next_field(definedIn);
+        append_entry(
+            cache, fileName, testName, definedIn == NULL ? fileName : definedIn,
+            hash == NULL ? 0 : strtoull(hash, NULL, 16), char_to_status(line[0])
+        );
+    }
+    fclose(file);
+}
+
+/** Writes every entry as a "status\tfile\tname\tdefinedIn\thash" line. */
+bool lkp_save_cache(const LkpCache *cache, const char *path) {
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+        return false;
+    }
+    for (int i = 0; i < cache->length; i++) {
+        const LkpCacheEntry *entry = &cache->data[i];
+        fprintf(
+            file, "%c\t%s\t%s\t%s\t%" PRIx64 "\n",
+            status_to_char(entry->status), entry->fileName, entry->testName,
+            entry->definedIn, entry->hash
+        );
+    }
+    return fclose(file) == 0;
+}
+
+/** Linearly searches for the test's caller file and name. */
+LkpCacheEntry *lkp_find_cache_entry(const LkpCache *cache, const LkpTestFunc *test) {
+    if (test->name == NULL) {
+        return NULL;
+    }
+    for (int i = 0; i < cache->length; i++) {
+        LkpCacheEntry *entry = &cache->data[i];
+        if (strcmp(entry->testName, test->name) == 0
+                && strcmp(entry->fileName, test->caller.testInfo.fileName) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/** Overwrites the last run's status the first time a test runs, then only lets failures in. */
+void lkp_update_cache(
+    LkpCache *cache, const LkpTestFunc *test, const char *definedIn, const uint64_t hash
+) {
+    if (test->name == NULL) {
+        return;
+    }
+    LkpCacheEntry *entry = lkp_find_cache_entry(cache, test);
+    if (entry == NULL) {
+        entry = append_entry(
+            cache, test->caller.testInfo.fileName, test->name, definedIn, hash, test->info.status
+        );
+    } else if (test->info.status == LKP_TEST_CACHED) {
+        return; // Didn't run, so its last result still stands.
+    } else if (!entry->updated || test->info.status == LKP_TEST_FAILURE) {
+        entry->status = test->info.status;
+        entry->hash = hash;
+        free(entry->definedIn);
+        entry->definedIn = copy_string(definedIn);
+    }
+    entry->updated = true;
+}
+
+/** Frees the copied names of every entry, then the entries. */
+void lkp_free_cache(LkpCache *cache) {
+    for (int i = 0; i < cache->length; i++) {
+        free(cache->data[i].fileName);
+        free(cache->data[i].testName);
+        free(cache->data[i].definedIn);
+    }
+    LKP_FREE_DA(cache);
+}
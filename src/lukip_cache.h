@@ -0,0 +1,77 @@
+/**
+ * @file lukip_cache.h
+ * @brief Header for keeping test results between runs.
+ * 
+ * @author Larmix
+ */
+
+#ifndef LUKIP_CACHE_H
+#define LUKIP_CACHE_H
+
+#include "lukip_assert.h"
+
+/**
+ * @brief The last known result of a test.
+ * 
+ * A test is identified by the file it was called from and its function's name,
+ * since both are known before the test runs.
+ */
+typedef struct {
+    char *fileName;
+    char *testName;
+    char *definedIn; /** The translation unit which defines the test. */
+    uint64_t hash; /** Hash of the test's inputs when it last ran, or 0 if unknown. */
+    LkpTestStatus status;
+    bool updated; /** Whether the test ran during this run. */
+} LkpCacheEntry;
+
+/** Every test result kept between runs. */
+LKP_DECLARE_DA_STRUCT(LkpCache, LkpCacheEntry);
+
+/**
+ * @brief Loads the results of the last run.
+ * 
+ * @param[out] cache The cache to initialize and load into (left empty on errors).
+ * @param path The file to load from, or NULL for an empty cache.
+ */
+void lkp_load_cache(LkpCache *cache, const char *path);
+
+/**
+ * @brief Saves the cache's results for the next run.
+ * 
+ * @param cache The cache to save.
+ * @param path The file to save into.
+ * 
+ * @return Whether the file could be written.
+ */
+bool lkp_save_cache(const LkpCache *cache, const char *path);
+
+/**
+ * @brief Finds the last result of a test.
+ * 
+ * @param cache The cache to search in.
+ * @param test The test to look for, using its caller's file and its name.
+ * 
+ * @return The test's entry, or NULL if it never ran before.
+ */
+LkpCacheEntry *lkp_find_cache_entry(const LkpCache *cache, const LkpTestFunc *test);
+
+/**
+ * @brief Records the result of a test that just ran.
+ * 
+ * If the same test runs multiple times in one run, a single failure is enough to keep it failed.
+ * Tests which were skipped as cached keep their last result.
+ * 
+ * @param cache The cache to update.
+ * @param test The test which ran.
+ * @param definedIn The translation unit which defines the test.
+ * @param hash The hash of the test's inputs.
+ */
+void lkp_update_cache(
+    LkpCache *cache, const LkpTestFunc *test, const char *definedIn, const uint64_t hash
+);
+
+/** Frees the cache's entries. */
+void lkp_free_cache(LkpCache *cache);
+
+#endif
@@ -0,0 +1,139 @@
+/**
+ * @file lukip_capture.c
+ * @brief Captures stdout and stderr into a memory file while tests run.
+ * 
+ * @author Larmix
+ */
+
+#if defined(__GNUC__) && defined(__linux__)
+    #define _GNU_SOURCE /** For memfd_create(). */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "lukip_allocator.h"
+#include "lukip_capture.h"
+#include "lukip_platform.h"
+
+#ifdef LKP_POSIX
+#include <errno.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__GNUC__) && defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+#ifdef LKP_POSIX
+
+static bool capturing = false;
+static int captureFd = -1; /** Where the output goes while capturing. */
+static int savedStdout = -1; /** A copy of the real stdout to put back afterwards. */
+static int savedStderr = -1;
+
+/** Opens an unnamed file to capture into, in memory where it's possible. */
+static int open_capture_file() {
+#if defined(__GNUC__) && defined(__linux__)
+    const int memfd = memfd_create("lukip_capture", MFD_CLOEXEC);
+    if (memfd != -1) {
+        return memfd;
+    }
+#endif
+    FILE *file = tmpfile();
+    if (file == NULL) {
+        return -1;
+    }
+    const int fd = dup(fileno(file));
+    fclose(file);
+    return fd;
+}
+
+/** Closes the descriptor if it's open, and marks it as closed. */
+static void close_fd(int *fd) {
+    if (*fd != -1) {
+        close(*fd);
+        *fd = -1;
+    }
+}
+
+/** Reads the whole capture file from its start, or returns NULL if it's empty. */
+static char *read_capture() {
+    struct stat info;
+    if (fstat(captureFd, &info) != 0 || info.st_size <= 0) {
+        return NULL;
+    }
+    char *output = lkp_allocate((int)info.st_size + 1, sizeof(char));
+    off_t done = 0;
+    while (done < info.st_size) {
+        const ssize_t amount = pread(captureFd, output + done, info.st_size - done, done);
+        if (amount < 0 && errno == EINTR) {
+            continue;
+        }
+        if (amount <= 0) {
+            break;
+        }
+        done += amount;
+    }
+    output[done] = '\0';
+    return output;
+}
+
+/** Flushes what stdio buffered so far, then points stdout and stderr at the capture file. */
+bool lkp_begin_capture() {
+    if (capturing) {
+        return false;
+    }
+    captureFd = open_capture_file();
+    if (captureFd == -1) {
+        return false;
+    }
+    fflush(stdout);
+    fflush(stderr);
+    savedStdout = dup(STDOUT_FILENO);
+    savedStderr = dup(STDERR_FILENO);
+    if (savedStdout == -1 || savedStderr == -1
+            || dup2(captureFd, STDOUT_FILENO) == -1 || dup2(captureFd, STDERR_FILENO) == -1) {
+        if (savedStdout != -1) {
+            dup2(savedStdout, STDOUT_FILENO);
+        }
+        close_fd(&savedStdout);
+        close_fd(&savedStderr);
+        close_fd(&captureFd);
+        return false;
+    }
+    capturing = true;
+    return true;
+}
+
+/** Flushes what the test left in stdio's buffers into the capture before restoring. */
+char *lkp_end_capture() {
+    if (!capturing) {
+        return NULL;
+    }
+    fflush(stdout);
+    fflush(stderr);
+    dup2(savedStdout, STDOUT_FILENO);
+    dup2(savedStderr, STDERR_FILENO);
+    close_fd(&savedStdout);
+    close_fd(&savedStderr);
+    char *output = read_capture();
+    close_fd(&captureFd);
+    capturing = false;
+    return output;
+}
+
+#else
+
+/** Output can't be redirected without POSIX file descriptors, so it's always shown. */
+bool lkp_begin_capture() {
+    return false;
+}
+
+/** Nothing's ever captured. */
+char *lkp_end_capture() {
+    return NULL;
+}
+
+#endif
@@ -0,0 +1,31 @@
+/**
+ * @file lukip_capture.h
+ * @brief Header for capturing what tests print, so it's only shown for failed ones.
+ * 
+ * @author Larmix
+ */
+
+#ifndef LUKIP_CAPTURE_H
+#define LUKIP_CAPTURE_H
+
+#include <stdbool.h>
+
+/**
+ * @brief Starts sending everything written to stdout and stderr into memory.
+ * 
+ * This redirects the file descriptors themselves, so forked children, other threads
+ * and programs the test executes get captured too.
+ * 
+ * @return Whether it started, which is false if it's already capturing or can't capture at all.
+ */
+bool lkp_begin_capture();
+
+/**
+ * @brief Stops capturing, and puts stdout and stderr back where they were.
+ * 
+ * @return Everything written while capturing, NUL terminated and allocated,
+ * or NULL if nothing was (or it wasn't capturing).
+ */
+char *lkp_end_capture();
+
+#endif
@@ -0,0 +1,273 @@
+/**
+ * @file lukip_clock.c
+ * @brief Wraps the clock and sleep functions with a virtual clock that only moves when told to.
+ * 
+ * Works like the allocation failures: the linker's --wrap sends the program's calls to
+ * clock_gettime(), gettimeofday(), time(), nanosleep(), usleep() and sleep() to the wrappers here,
+ * which call the real (weak) functions while the virtual clock isn't running.
+ * CPU time clocks always stay real, since skipping time doesn't use any CPU.
+ * 
+ * @author Larmix
+ */
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+#include "lukip_clock.h"
+
+#if defined(__GNUC__) && defined(__linux__)
+
+#include <pthread.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#define NS_PER_SECOND 1000000000LL
+
+extern int __real_clock_gettime(clockid_t clock, struct timespec *now) __attribute__((weak));
+extern int __real_gettimeofday(struct timeval *now, void *zone) __attribute__((weak));
+extern time_t __real_time(time_t *now) __attribute__((weak));
+extern int __real_nanosleep(
+    const struct timespec *duration, struct timespec *remaining
+) __attribute__((weak));
+extern int __real_usleep(useconds_t microseconds) __attribute__((weak));
+extern unsigned int __real_sleep(unsigned int seconds) __attribute__((weak));
+
+/** A thread waiting in a virtual sleep, which lives on its own stack. */
+typedef struct Sleeper {
+    long long wake; /** The advanced time it wakes at. */
+    struct Sleeper *next;
+} Sleeper;
+
+static atomic_bool running = false;
+static atomic_llong advanced = 0; /** Nanoseconds the clock moved since it started. */
+static long long monotonicStart = 0; /** Monotonic time when the clock started. */
+static long long realtimeStart = 0; /** Wall clock time when the clock started. */
+static pthread_t owner; /** The thread that started the clock, whose sleeps advance it. */
+static Sleeper *sleepers = NULL;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ticked = PTHREAD_COND_INITIALIZER; /** Signaled when the clock moves. */
+static pthread_cond_t woke = PTHREAD_COND_INITIALIZER; /** Signaled when a sleeper leaves. */
+
+/** Reads a real clock in nanoseconds. */
+static long long real_ns(const clockid_t clock) {
+    struct timespec now;
+    __real_clock_gettime(clock, &now);
+    return now.tv_sec * NS_PER_SECOND + now.tv_nsec;
+}
+
+/** Returns whether a clock is one that gets frozen, instead of a CPU time one. */
+static bool is_virtual(const clockid_t clock) {
+    return atomic_load(&running) && clock != CLOCK_PROCESS_CPUTIME_ID
+        && clock != CLOCK_THREAD_CPUTIME_ID && clock >= 0;
+}
+
+/** Returns the virtual time of a clock in nanoseconds. */
+static long long virtual_ns(const clockid_t clock) {
+    const bool wallClock = clock == CLOCK_REALTIME || clock == CLOCK_REALTIME_COARSE;
+    return (wallClock ? realtimeStart : monotonicStart) + atomic_load(&advanced);
+}
+
+/** Returns whether a sleeper is still waiting for a time that already passed. */
+static bool has_due_sleeper() {
+    for (const Sleeper *sleeper = sleepers; sleeper != NULL; sleeper = sleeper->next) {
+        if (sleeper->wake <= atomic_load(&advanced)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/** Moves the clock while holding the lock, then waits for the sleepers it woke to leave. */
+static void advance_locked(const long long nanoseconds) {
+    atomic_fetch_add(&advanced, nanoseconds > 0 ? nanoseconds : 0);
+    pthread_cond_broadcast(&ticked);
+    while (has_due_sleeper()) {
+        pthread_cond_wait(&woke, &lock);
+    }
+}
+
+/** Sleeps for a virtual duration, which only waits on threads that don't own the clock. */
+static void sleep_virtually(const long long nanoseconds) {
+    pthread_mutex_lock(&lock);
+    if (pthread_equal(pthread_self(), owner)) {
+        advance_locked(nanoseconds);
+        pthread_mutex_unlock(&lock);
+        return;
+    }
+    Sleeper sleeper = {.wake = atomic_load(&advanced) + nanoseconds, .next = sleepers};
+    sleepers = &sleeper;
+    while (atomic_load(&running) && atomic_load(&advanced) < sleeper.wake) {
+        pthread_cond_wait(&ticked, &lock);
+    }
+    Sleeper **link = &sleepers;
+    while (*link != &sleeper) {
+        link = &(*link)->next;
+    }
+    *link = sleeper.next;
+    pthread_cond_broadcast(&woke);
+    pthread_mutex_unlock(&lock);
+}
+
+/** Called instead of clock_gettime() by programs linked with --wrap=clock_gettime. */
+int __wrap_clock_gettime(clockid_t clock, struct timespec *now) {
+    if (!is_virtual(clock)) {
+        return __real_clock_gettime(clock, now);
+    }
+    const long long nanoseconds = virtual_ns(clock);
+    now->tv_sec = nanoseconds / NS_PER_SECOND;
+    now->tv_nsec = nanoseconds % NS_PER_SECOND;
+    return 0;
+}
+
+/** Called instead of gettimeofday() by programs linked with --wrap=gettimeofday. */
+int __wrap_gettimeofday(struct timeval *now, void *zone) {
+    if (!is_virtual(CLOCK_REALTIME)) {
+        return __real_gettimeofday(now, zone);
+    }
+    const long long nanoseconds = virtual_ns(CLOCK_REALTIME);
+    now->tv_sec = nanoseconds / NS_PER_SECOND;
+    now->tv_usec = nanoseconds % NS_PER_SECOND / 1000;
+    return 0;
+}
+
+/** Called instead of time() by programs linked with --wrap=time. */
+time_t __wrap_time(time_t *now) {
+    if (!is_virtual(CLOCK_REALTIME)) {
+        return __real_time(now);
+    }
+    const time_t seconds = (time_t)(virtual_ns(CLOCK_REALTIME) / NS_PER_SECOND);
+    if (now != NULL) {
+        *now = seconds;
+    }
+    return seconds;
+}
+
+/** Called instead of nanosleep() by programs linked with --wrap=nanosleep. */
+int __wrap_nanosleep(const struct timespec *duration, struct timespec *remaining) {
+    if (!is_virtual(CLOCK_MONOTONIC)) {
+        return __real_nanosleep(duration, remaining);
+    }
+    sleep_virtually(duration->tv_sec * NS_PER_SECOND + duration->tv_nsec);
+    if (remaining != NULL) {
+        remaining->tv_sec = 0;
+        remaining->tv_nsec = 0;
+    }
+    return 0;
+}
+
+/** Called instead of usleep() by programs linked with --wrap=usleep. */
+int __wrap_usleep(useconds_t microseconds) {
+    if (!is_virtual(CLOCK_MONOTONIC)) {
+        return __real_usleep(microseconds);
+    }
+    sleep_virtually(microseconds * 1000LL);
+    return 0;
+}
+
+/** Called instead of sleep() by programs linked with --wrap=sleep. */
+unsigned int __wrap_sleep(unsigned int seconds) {
+    if (!is_virtual(CLOCK_MONOTONIC)) {
+        return __real_sleep(seconds);
+    }
+    sleep_virtually(seconds * NS_PER_SECOND);
+    return 0;
+}
+
+/** Only true when the program was linked with --wrap, which resolves the real functions. */
+bool lkp_virtual_clock_supported() {
+    return __real_clock_gettime != NULL && __real_nanosleep != NULL;
+}
+
+/** Returns whether the clocks are currently virtual. */
+bool lkp_virtual_clock_running() {
+    return atomic_load(&running);
+}
+
+/** Starts the virtual clocks from the current real times, so they don't jump back. */
+void lkp_start_virtual_clock() {
+    if (!lkp_virtual_clock_supported() || atomic_load(&running)) {
+        return;
+    }
+    pthread_mutex_lock(&lock);
+    monotonicStart = real_ns(CLOCK_MONOTONIC);
+    realtimeStart = real_ns(CLOCK_REALTIME);
+    atomic_store(&advanced, 0);
+    owner = pthread_self();
+    atomic_store(&running, true);
+    pthread_mutex_unlock(&lock);
+}
+
+/** Stops the virtual clock, and waits for every sleeper to leave before going back to real time. */
+void lkp_stop_virtual_clock() {
+    if (!atomic_load(&running)) {
+        return;
+    }
+    pthread_mutex_lock(&lock);
+    atomic_store(&running, false);
+    pthread_cond_broadcast(&ticked);
+    while (sleepers != NULL) {
+        pthread_cond_wait(&woke, &lock);
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+/** Goes around the wrapper if there's one, so timing code doesn't see the virtual time. */
+long long lkp_monotonic_ns() {
+    if (__real_clock_gettime != NULL) {
+        return real_ns(CLOCK_MONOTONIC);
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * NS_PER_SECOND + now.tv_nsec;
+}
+
+/** Moves the virtual clock forward, firing the sleepers whose time came. */
+void lkp_advance_time(const long long milliseconds) {
+    if (!atomic_load(&running)) {
+        return;
+    }
+    pthread_mutex_lock(&lock);
+    advance_locked(milliseconds * 1000000LL);
+    pthread_mutex_unlock(&lock);
+}
+
+#else
+
+#include <time.h>
+
+/** There's nothing to wrap the clock with. */
+bool lkp_virtual_clock_supported() {
+    return false;
+}
+
+/** The clock never runs without wrapping. */
+bool lkp_virtual_clock_running() {
+    return false;
+}
+
+/** Does nothing, since the clock can't be wrapped. */
+void lkp_start_virtual_clock() {
+}
+
+/** Does nothing, since the clock can't be wrapped. */
+void lkp_stop_virtual_clock() {
+}
+
+/** The clock isn't wrapped, so the standard one is the real one. */
+long long lkp_monotonic_ns() {
+    struct timespec now;
+#ifdef CLOCK_MONOTONIC
+    clock_gettime(CLOCK_MONOTONIC, &now);
+#else
+    timespec_get(&now, TIME_UTC);
+#endif
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+/** Does nothing, since the clock can't be wrapped. */
+void lkp_advance_time(const long long milliseconds) {
+    (void)milliseconds;
+}
+
+#endif
@@ -0,0 +1,52 @@
+/**
+ * @file lukip_clock.h
+ * @brief Header for the virtual clock, which lets tests skip time instead of sleeping through it.
+ * 
+ * Only works when the test program is linked with LKP_CLOCK_WRAP_FLAGS (which "make tests" does
+ * on Linux), so calls to the clock and sleep functions from the program go through Lukip first.
+ * 
+ * @author Larmix
+ */
+
+#ifndef LUKIP_CLOCK_H
+#define LUKIP_CLOCK_H
+
+#include <stdbool.h>
+
+/** Linker flags a program needs for the virtual clock. */
+#define LKP_CLOCK_WRAP_FLAGS \
+    "-Wl,--wrap=clock_gettime,--wrap=gettimeofday,--wrap=time," \
+    "--wrap=nanosleep,--wrap=usleep,--wrap=sleep"
+
+/** Returns whether the program was linked with the wrapped clock functions. */
+bool lkp_virtual_clock_supported();
+
+/** Returns whether the virtual clock is currently running. */
+bool lkp_virtual_clock_running();
+
+/**
+ * @brief Freezes the clocks at the current time, which then only moves when it's advanced.
+ * 
+ * Sleeping on the thread that started the clock advances it by the sleep's duration right away.
+ * Sleeping on any other thread waits until the clock gets advanced past the sleep's end.
+ */
+void lkp_start_virtual_clock();
+
+/** Goes back to the real clocks, waking every thread still in a virtual sleep. */
+void lkp_stop_virtual_clock();
+
+/**
+ * @brief Reads the real monotonic clock, even while the virtual clock is running.
+ * 
+ * @return The monotonic time in nanoseconds (wall clock time where there's no monotonic one).
+ */
+long long lkp_monotonic_ns();
+
+/**
+ * @brief Moves the virtual clock forward, and waits for every sleep that ended to return.
+ * 
+ * @param milliseconds How far to move it.
+ */
+void lkp_advance_time(const long long milliseconds);
+
+#endif
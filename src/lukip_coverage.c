@@ -0,0 +1,242 @@
+/**
+ * @file lukip_coverage.c
+ * @brief Records the basic blocks every test reaches, through -fsanitize-coverage=trace-pc.
+ * 
+ * The compiler calls __sanitizer_cov_trace_pc() at the start of every basic block
+ * of instrumented code (on whatever thread runs it), and we keep the addresses
+ * it was called from in a lock-free hash set.
+ * They're written relative to the start of the executable, so the lookup tool
+ * can resolve them to lines with addr2line without rerunning anything.
+ * 
+ * The map looks like:
+ * exe <path of the executable>
+ * base <runtime address the offsets are relative to>
+ * test <file called from>\t<test name>
+ * <offset> <offset> ...
+ * 
+ * @author Larmix
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lukip_coverage.h"
+
+#ifdef LKP_COVERAGE
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <unistd.h>
+
+/** Start of the executable, provided by the GNU linker. */
+extern char __executable_start;
+
+#define EMPTY_SLOT 0 /** No address is ever 0, so it marks empty slots of a set. */
+#define INITIAL_CAPACITY 4096 /** Starting amount of slots in a test's set. */
+
+/**
+ * @brief Open addressing hash set of covered addresses, filled by any thread without locks.
+ * 
+ * A full set is never moved or freed while the test runs. A twice as large one takes
+ * its place instead, so an address can end up in both, which the map doesn't mind.
+ */
+typedef struct CoverageSet {
+    _Atomic uintptr_t *slots;
+    size_t capacity; /** Amount of slots (always a power of 2). */
+    atomic_size_t count; /** Amount of addresses in the set. */
+    struct CoverageSet *older; /** The set this one took the place of, or NULL. */
+} CoverageSet;
+
+/** What a test covered so far, where a test calling TEST() starts a new one for its own. */
+typedef struct Recording {
+    _Atomic(CoverageSet *) newest; /** The set addresses get inserted into. */
+    struct Recording *outer; /** The recording of the test this one runs in, or NULL. */
+} Recording;
+
+/** The recording of the innermost running test's body, or NULL outside of one. */
+static _Atomic(Recording *) current = NULL;
+static const char *mapPath = LKP_DEFAULT_COVERAGE_PATH; /** Where the map gets written. */
+static bool writingMap = true; /** Whether finished tests get appended to the map. */
+
+/** Allocates an empty set. */
+static CoverageSet *new_set(const size_t capacity, CoverageSet *older) {
+    CoverageSet *set = lkp_allocate(1, sizeof(CoverageSet));
+    set->slots = lkp_allocate((int)capacity, sizeof(uintptr_t));
+    for (size_t i = 0; i < capacity; i++) {
+        atomic_init(&set->slots[i], EMPTY_SLOT);
+    }
+    set->capacity = capacity;
+    atomic_init(&set->count, 0);
+    set->older = older;
+    return set;
+}
+
+/** Puts a twice as large set in the place of a full one, unless another thread already did. */
+static void grow_recording(Recording *recording, CoverageSet *full) {
+    CoverageSet *larger = new_set(full->capacity * 2, full);
+    if (!atomic_compare_exchange_strong(&recording->newest, &full, larger)) {
+        free(larger->slots);
+        free(larger);
+    }
+}
+
+/** Mixes an address's bits so nearby addresses spread over a set. */
+static size_t slot_of(const uintptr_t address, const size_t capacity) {
+    uint64_t mixed = (uint64_t)address * 0x9E3779B97F4A7C15ULL;
+    return (size_t)(mixed >> 20) & (capacity - 1);
+}
+
+/** Inserts an address into the recording's newest set, growing it at 50% load. */
+static void record_address(Recording *recording, const uintptr_t address) {
+    while (true) {
+        CoverageSet *set = atomic_load_explicit(&recording->newest, memory_order_acquire);
+        size_t slot = slot_of(address, set->capacity);
+        for (size_t probes = 0; probes < set->capacity; probes++) {
+            uintptr_t seen = atomic_load_explicit(&set->slots[slot], memory_order_relaxed);
+            if (seen == EMPTY_SLOT
+                    && atomic_compare_exchange_strong(&set->slots[slot], &seen, address)) {
+                if ((atomic_fetch_add(&set->count, 1) + 1) * 2 == set->capacity) {
+                    grow_recording(recording, set);
+                }
+                return;
+            }
+            if (seen == address) {
+                return; // Either it was there, or another thread inserted it first.
+            }
+            slot = (slot + 1) & (set->capacity - 1);
+        }
+        // Only a set that already has a larger one waiting can fill up completely.
+        grow_recording(recording, set);
+    }
+}
+
+/** Called by instrumented code at the start of every basic block, on any thread. */
+void __sanitizer_cov_trace_pc() {
+    Recording *recording = atomic_load_explicit(&current, memory_order_acquire);
+    if (recording != NULL) {
+        record_address(recording, (uintptr_t)__builtin_return_address(0));
+    }
+}
+
+/** Orders addresses for qsort, so the map is stable between runs. */
+static int compare_addresses(const void *left, const void *right) {
+    const uintptr_t leftAddress = *(const uintptr_t *)left;
+    const uintptr_t rightAddress = *(const uintptr_t *)right;
+    return leftAddress < rightAddress ? -1 : leftAddress > rightAddress;
+}
+
+/** Writes the header of the map, which every test's covered offsets get appended to. */
+void lkp_init_coverage() {
+    const char *path = getenv(LKP_COVERAGE_ENV);
+    if (path != NULL && path[0] != '\0') {
+        mapPath = path;
+    }
+    FILE *map = fopen(mapPath, "w");
+    if (map == NULL) {
+        return;
+    }
+    char exePath[1024];
+    const ssize_t length = readlink("/proc/self/exe", exePath, sizeof(exePath) - 1);
+    exePath[length > 0 ? length : 0] = '\0';
+    fprintf(map, "exe %s\nbase %" PRIxPTR "\n", exePath, (uintptr_t)&__executable_start);
+    fclose(map);
+}
+
+/** Starts an empty recording, which a nested test's one goes on top of. */
+void lkp_coverage_begin() {
+    Recording *recording = lkp_allocate(1, sizeof(Recording));
+    atomic_init(&recording->newest, new_set(INITIAL_CAPACITY, NULL));
+    recording->outer = atomic_load(&current);
+    atomic_store_explicit(&current, recording, memory_order_release);
+}
+
+/** Returns the sorted and unique addresses of every set of a recording, and frees the sets. */
+static uintptr_t *collect_addresses(Recording *recording, size_t *length) {
+    size_t total = 0;
+    CoverageSet *newest = atomic_load(&recording->newest);
+    for (const CoverageSet *set = newest; set != NULL; set = set->older) {
+        total += atomic_load(&set->count);
+    }
+    uintptr_t *addresses = lkp_allocate(total > 0 ? (int)total : 1, sizeof(uintptr_t));
+    *length = 0;
+    for (CoverageSet *set = newest, *older; set != NULL; set = older) {
+        for (size_t i = 0; i < set->capacity && *length < total; i++) {
+            const uintptr_t address = atomic_load_explicit(&set->slots[i], memory_order_relaxed);
+            if (address != EMPTY_SLOT) {
+                addresses[(*length)++] = address;
+            }
+        }
+        older = set->older;
+        free(set->slots);
+        free(set);
+    }
+    qsort(addresses, *length, sizeof(uintptr_t), compare_addresses);
+    size_t unique = 0;
+    for (size_t i = 0; i < *length; i++) {
+        if (unique == 0 || addresses[i] != addresses[unique - 1]) {
+            addresses[unique++] = addresses[i];
+        }
+    }
+    *length = unique;
+    return addresses;
+}
+
+/**
+ * Appends the sorted offsets of everything the test covered to the map. A nested test's
+ * addresses are also added to the test it ran in, which covered them just as much.
+ */
+void lkp_coverage_end(const LkpTestFunc *test) {
+    Recording *recording = atomic_load(&current);
+    if (recording == NULL) {
+        return;
+    }
+    atomic_store_explicit(&current, NULL, memory_order_release);
+    size_t length;
+    uintptr_t *addresses = collect_addresses(recording, &length);
+
+    FILE *map = writingMap && test->name != NULL ? fopen(mapPath, "a") : NULL;
+    if (map != NULL) {
+        fprintf(map, "test %s\t%s\n", test->caller.testInfo.fileName, test->name);
+        const uintptr_t base = (uintptr_t)&__executable_start;
+        for (size_t i = 0; i < length; i++) {
+            fprintf(map, i == 0 ? "%" PRIxPTR : " %" PRIxPTR, addresses[i] - base);
+        }
+        fputc('\n', map);
+        fclose(map);
+    }
+    if (recording->outer != NULL) {
+        for (size_t i = 0; i < length; i++) {
+            record_address(recording->outer, addresses[i]);
+        }
+    }
+    atomic_store_explicit(&current, recording->outer, memory_order_release);
+    free(addresses);
+    free(recording);
+}
+
+/** Only the map is left alone, so nested tests still add to the tests they ran in. */
+void lkp_stop_coverage_map() {
+    writingMap = false;
+}
+
+#else
+
+/** Coverage wasn't compiled in. */
+void lkp_init_coverage() {
+}
+
+/** Coverage wasn't compiled in. */
+void lkp_coverage_begin() {
+}
+
+/** Coverage wasn't compiled in. */
+void lkp_coverage_end(const LkpTestFunc *test) {
+    (void)test;
+}
+
+/** Coverage wasn't compiled in. */
+void lkp_stop_coverage_map() {
+}
+
+#endif
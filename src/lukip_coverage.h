@@ -0,0 +1,44 @@
+/**
+ * @file lukip_coverage.h
+ * @brief Header for recording which code every test covered.
+ * 
+ * Only does something when Lukip's sources are compiled with LKP_COVERAGE defined,
+ * and the code under test with -fsanitize-coverage=trace-pc (see "make coverage").
+ * 
+ * @author Larmix
+ */
+
+#ifndef LUKIP_COVERAGE_H
+#define LUKIP_COVERAGE_H
+
+#include "lukip_assert.h"
+
+/** Environment variable which overrides where the per-test coverage map is written. */
+#define LKP_COVERAGE_ENV "LUKIP_COVERAGE_FILE"
+
+/** Default file the per-test coverage map is written to. */
+#define LKP_DEFAULT_COVERAGE_PATH "lukip.coverage"
+
+/** Starts a new coverage map file (overwriting the last run's one). */
+void lkp_init_coverage();
+
+/** Starts recording what a test covers, apart from the test it's nested in (if any). */
+void lkp_coverage_begin();
+
+/**
+ * @brief Stops recording and appends what the test covered to the coverage map.
+ * 
+ * Has to be called once per lkp_coverage_begin(), after any threads of the test finished.
+ * 
+ * @param test The test which just ran.
+ */
+void lkp_coverage_end(const LkpTestFunc *test);
+
+/**
+ * @brief Stops appending tests to the coverage map for the rest of the process.
+ * 
+ * Meant for forked processes whose tests aren't part of the real run, like bisecting trials.
+ */
+void lkp_stop_coverage_map();
+
+#endif
@@ -0,0 +1,279 @@
+/**
+ * @file lukip_differential.c
+ * @brief Runs generated inputs through two implementations in batches, comparing and timing both.
+ * 
+ * @author Larmix
+ */
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "lukip_allocator.h"
+#include "lukip_differential.h"
+#include "lukip_parallel.h"
+
+/** How many cases a thread generates before running them all through each implementation. */
+#define BATCH_SIZE 64
+
+/** The batches of cases which every thread takes the next one out of. */
+typedef struct {
+    const LkpDifferential *differential;
+    LkpLineInfo location;
+    int cases;
+    uint64_t seed;
+    long long deadline; /** When to stop generating cases in nanoseconds, or 0 for never. */
+    atomic_int nextBatch;
+    atomic_int failedCase; /** Lowest mismatching case so far, or the amount of cases if none. */
+    atomic_bool timedOut;
+} BatchQueue;
+
+/** What a single thread went through while running batches. */
+typedef struct {
+    BatchQueue *queue;
+    LkpFuncInfo info;
+    int asserts;
+    int casesRun;
+    long long casesTimed; /** Cases run through both implementations, even past a mismatch. */
+    long long referenceTime; /** In nanoseconds. */
+    long long fastTime; /** In nanoseconds. */
+} Worker;
+
+/** The implementations being shrunk, which only happens on the calling thread. */
+static const BatchQueue *shrinking = NULL;
+
+/** Returns the current time in nanoseconds. */
+static long long now_ns() {
+    struct timespec now;
+    timespec_get(&now, TIME_UTC);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+/** Compares the outputs as bytes, or as arrays of LkpFloat if the differential has places. */
+static void compare_outputs(
+    const LkpDifferential *differential, const void *reference, const void *fast,
+    const LkpLineInfo location
+) {
+    if (differential->places < 0) {
+        lkp_verify_bytes_array(
+            reference, fast, (int)differential->outputSize, location, LKP_ASSERT_EQUAL
+        );
+        return;
+    }
+    const LkpFloat *referenceFloats = reference;
+    const LkpFloat *fastFloats = fast;
+    for (size_t i = 0; i < differential->outputSize / sizeof(LkpFloat); i++) {
+        lkp_verify_precision(
+            referenceFloats[i], fastFloats[i], differential->places, location, LKP_ASSERT_EQUAL
+        );
+    }
+}
+
+/** Compares one case's outputs into the sink, and returns whether they mismatched. */
+static bool outputs_differ(
+    const BatchQueue *queue, const void *reference, const void *fast, LkpCaseSink *sink
+) {
+    sink->info.status = LKP_TEST_UNKNOWN;
+    sink->info.fileName = NULL;
+    sink->info.funcName = NULL;
+    sink->asserts = 0;
+    sink->message = NULL;
+    sink->line = 0;
+    sink->jump = NULL;
+    lkp_set_case_sink(sink);
+    compare_outputs(queue->differential, reference, fast, queue->location);
+    lkp_set_case_sink(NULL);
+    return sink->message != NULL;
+}
+
+/** Calls an implementation on every input of a batch, and returns how long it took. */
+static long long run_batch(
+    const LkpDiffFunc implementation, const uint8_t *inputs, uint8_t *outputs, const int count,
+    const LkpDifferential *differential
+) {
+    const long long start = now_ns();
+    for (int i = 0; i < count; i++) {
+        implementation(
+            inputs + i * differential->inputSize, outputs + i * differential->outputSize
+        );
+    }
+    return now_ns() - start;
+}
+
+/** Lowers the queue's failed case to the passed one, unless a lower case already failed. */
+static void record_failed_case(BatchQueue *queue, const int index) {
+    int current = atomic_load(&queue->failedCase);
+    while (index < current && !atomic_compare_exchange_weak(&queue->failedCase, &current, index)) {
+    }
+}
+
+/**
+ * @brief Keeps taking the next batch out of the queue until they run out, mismatch, or time out.
+ * 
+ * Which implementation runs first alternates between batches,
+ * so neither one always gets the inputs while they're still in the cache.
+ */
+static void *run_batches(void *workerArg) {
+    Worker *worker = workerArg;
+    BatchQueue *queue = worker->queue;
+    const LkpDifferential *differential = queue->differential;
+    uint8_t *inputs = lkp_allocate(BATCH_SIZE, differential->inputSize);
+    uint8_t *referenceOutputs = lkp_allocate(BATCH_SIZE, differential->outputSize);
+    uint8_t *fastOutputs = lkp_allocate(BATCH_SIZE, differential->outputSize);
+    LkpGen gen;
+    lkp_init_gen(&gen);
+    LkpCaseSink sink;
+
+    while (true) {
+        const int first = atomic_fetch_add(&queue->nextBatch, 1) * BATCH_SIZE;
+        if (first >= queue->cases || first > atomic_load(&queue->failedCase)) {
+            break;
+        }
+        if (queue->deadline != 0 && now_ns() >= queue->deadline) {
+            atomic_store(&queue->timedOut, true);
+            break;
+        }
+        const int count = queue->cases - first < BATCH_SIZE ? queue->cases - first : BATCH_SIZE;
+        memset(inputs, 0, count * differential->inputSize);
+        memset(referenceOutputs, 0, count * differential->outputSize);
+        memset(fastOutputs, 0, count * differential->outputSize);
+        for (int i = 0; i < count; i++) {
+            lkp_seed_gen(&gen, queue->seed, first + i);
+            differential->generator(&gen, inputs + i * differential->inputSize);
+        }
+
+        worker->casesTimed += count;
+        if (first / BATCH_SIZE % 2 == 0) {
+            worker->referenceTime += run_batch(
+                differential->reference, inputs, referenceOutputs, count, differential
+            );
+            worker->fastTime += run_batch(
+                differential->fast, inputs, fastOutputs, count, differential
+            );
+        } else {
+            worker->fastTime += run_batch(
+                differential->fast, inputs, fastOutputs, count, differential
+            );
+            worker->referenceTime += run_batch(
+                differential->reference, inputs, referenceOutputs, count, differential
+            );
+        }
+
+        for (int i = 0; i < count; i++) {
+            const bool differ = outputs_differ(
+                queue, referenceOutputs + i * differential->outputSize,
+                fastOutputs + i * differential->outputSize, &sink
+            );
+            worker->asserts += sink.asserts;
+            worker->casesRun++;
+            if (worker->info.fileName == NULL) {
+                worker->info = sink.info;
+            }
+            if (differ) {
+                free(sink.message);
+                record_failed_case(queue, first + i);
+                break;
+            }
+        }
+    }
+    lkp_free_gen(&gen);
+    free(inputs);
+    free(referenceOutputs);
+    free(fastOutputs);
+    return NULL;
+}
+
+/** A single case of the implementations being shrunk, as a property. */
+static void compare_case(LkpGen *gen) {
+    const LkpDifferential *differential = shrinking->differential;
+    uint8_t *input = lkp_allocate(1, differential->inputSize);
+    uint8_t *referenceOutput = lkp_allocate(1, differential->outputSize);
+    uint8_t *fastOutput = lkp_allocate(1, differential->outputSize);
+    memset(input, 0, differential->inputSize);
+    memset(referenceOutput, 0, differential->outputSize);
+    memset(fastOutput, 0, differential->outputSize);
+
+    differential->generator(gen, input);
+    differential->reference(input, referenceOutput);
+    differential->fast(input, fastOutput);
+    compare_outputs(differential, referenceOutput, fastOutput, shrinking->location);
+    free(input);
+    free(referenceOutput);
+    free(fastOutput);
+}
+
+/** Runs the batches on every thread, merges what each one went through, then shrinks a mismatch. */
+void lkp_compare_implementations(
+    const LkpDifferential *differential, const LkpLineInfo location, const int cases,
+    const uint64_t seed, const int jobs, const int timeout, LkpDiffResult *result
+) {
+    BatchQueue queue = {
+        .differential = differential, .location = location, .cases = cases, .seed = seed,
+        .deadline = timeout > 0 ? now_ns() + timeout * 1000000LL : 0
+    };
+    atomic_init(&queue.nextBatch, 0);
+    atomic_init(&queue.failedCase, cases);
+    atomic_init(&queue.timedOut, false);
+
+    const int batches = (cases + BATCH_SIZE - 1) / BATCH_SIZE;
+    int threads = jobs > 0 ? jobs : lkp_default_jobs();
+    threads = threads < batches ? threads : (batches > 0 ? batches : 1);
+    Worker *workers = lkp_allocate(threads, sizeof(Worker));
+    for (int i = 0; i < threads; i++) {
+        workers[i] = (Worker){
+            .queue = &queue, .asserts = 0, .casesRun = 0, .casesTimed = 0,
+            .referenceTime = 0, .fastTime = 0
+        };
+        workers[i].info.status = LKP_TEST_UNKNOWN;
+        workers[i].info.fileName = NULL;
+        workers[i].info.funcName = NULL;
+    }
+    lkp_run_parallel(run_batches, workers, threads, sizeof(Worker));
+
+    LkpPropertyResult *caseResult = &result->cases;
+    const int failedCase = atomic_load(&queue.failedCase);
+    caseResult->failure.info = workers[0].info;
+    caseResult->failure.message = NULL;
+    caseResult->failure.line = 0;
+    caseResult->counterexample = NULL;
+    caseResult->shrinks = 0;
+    if (failedCase < cases) {
+        const long long left = queue.deadline != 0 ? (queue.deadline - now_ns()) / 1000000 : 0;
+        shrinking = &queue;
+        lkp_shrink_case(
+            compare_case, seed, failedCase, queue.deadline != 0 && left < 1 ? 1 : (int)left,
+            caseResult
+        );
+        shrinking = NULL;
+    }
+
+    caseResult->failedCase = failedCase < cases ? failedCase : -1;
+    caseResult->timedOut = atomic_load(&queue.timedOut);
+    caseResult->asserts = 0;
+    caseResult->casesRun = 0;
+    long long casesTimed = 0, referenceTime = 0, fastTime = 0;
+    for (int i = 0; i < threads; i++) {
+        caseResult->asserts += workers[i].asserts;
+        caseResult->casesRun += workers[i].casesRun;
+        casesTimed += workers[i].casesTimed;
+        referenceTime += workers[i].referenceTime;
+        fastTime += workers[i].fastTime;
+        if (caseResult->failedCase < 0 && caseResult->failure.info.fileName == NULL) {
+            caseResult->failure.info = workers[i].info;
+        }
+    }
+    result->referenceSeconds = referenceTime / 1e9;
+    result->fastSeconds = fastTime / 1e9;
+    free(workers);
+
+    const double referenceRate = result->referenceSeconds > 0
+        ? casesTimed / result->referenceSeconds : 0;
+    const double fastRate = result->fastSeconds > 0 ? casesTimed / result->fastSeconds : 0;
+    printf(
+        "Compared %s with %s over %lld cases: %.0lf/s and %.0lf/s per thread (%.2lfx as fast).\n",
+        differential->referenceName, differential->fastName, casesTimed, referenceRate, fastRate,
+        referenceRate > 0 ? fastRate / referenceRate : 0
+    );
+}
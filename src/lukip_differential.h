@@ -0,0 +1,44 @@
+/**
+ * @file lukip_differential.h
+ * @brief Header for differential tests, which compare a reference and a fast implementation.
+ * 
+ * @author Larmix
+ */
+
+#ifndef LUKIP_DIFFERENTIAL_H
+#define LUKIP_DIFFERENTIAL_H
+
+#include "lukip_assert.h"
+#include "lukip_property.h"
+
+/** What came out of comparing two implementations. */
+typedef struct {
+    /** Asserts, cases and the shrunk mismatch, where failedCase is -1 if they always agreed. */
+    LkpPropertyResult cases;
+    double referenceSeconds; /** Time spent inside of the reference over every case. */
+    double fastSeconds; /** Time spent inside of the fast implementation over every case. */
+} LkpDiffResult;
+
+/**
+ * @brief Feeds the same generated inputs to both implementations on several threads.
+ * 
+ * Each thread claims a batch of cases, generates all of their inputs, then runs
+ * the whole batch through one implementation and then the other, so the time of each
+ * is measured without timing every single call. Their outputs are then compared
+ * with the byte (or float) asserts, and the first mismatching case is shrunk.
+ * Case i always gets the same input as case i of a property with the same seed.
+ * 
+ * @param differential The implementations and their inputs.
+ * @param location Where the outputs' asserts are reported from.
+ * @param cases How many inputs to generate.
+ * @param seed The seed every case's own seed is derived from.
+ * @param jobs How many threads to use, where 0 is one per core.
+ * @param timeout Milliseconds to stop generating (and shrinking) cases after, or 0 for no limit.
+ * @param[out] result The results, whose strings have to be freed with lkp_free_property_result().
+ */
+void lkp_compare_implementations(
+    const LkpDifferential *differential, const LkpLineInfo location, const int cases,
+    const uint64_t seed, const int jobs, const int timeout, LkpDiffResult *result
+);
+
+#endif
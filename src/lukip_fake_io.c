@@ -0,0 +1,411 @@
+/**
+ * @file lukip_fake_io.c
+ * @brief Wraps open(), read(), write(), fsync() and close() for fake files and injected faults.
+ * 
+ * Works like the allocation failures, where the linker's --wrap sends the program's calls here
+ * and the real functions are weak references. Nothing happens (besides an atomic load per call)
+ * until a test fakes files or injects a fault.
+ * 
+ * A fake file is a memfd. Opening it goes through "/proc/self/fd/<memfd>" with the call's flags,
+ * so every open() gets its own offset and O_TRUNC/O_APPEND work like on a real file,
+ * while the reads and writes themselves are plain system calls that never touch the disk.
+ * 
+ * @author Larmix
+ */
+
+#if defined(__GNUC__) && defined(__linux__)
+    #define _GNU_SOURCE /** For memfd_create(). */
+#endif
+
+#include <errno.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "lukip_fake_io.h"
+
+#if defined(__GNUC__) && defined(__linux__)
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "lukip_allocator.h"
+#include "lukip_dynamic_array.h"
+
+extern int __real_open(const char *path, int flags, ...) __attribute__((weak));
+extern int __real_open64(const char *path, int flags, ...) __attribute__((weak));
+extern ssize_t __real_read(int fd, void *buffer, size_t count) __attribute__((weak));
+extern ssize_t __real_write(int fd, const void *buffer, size_t count) __attribute__((weak));
+extern int __real_fsync(int fd) __attribute__((weak));
+extern int __real_close(int fd) __attribute__((weak));
+
+/** A file kept in memory, under the path it was created with. */
+typedef struct {
+    char *path;
+    int memfd;
+} FakeFile;
+
+/** A file descriptor opened through the wrapper, and the path it was opened with. */
+typedef struct {
+    int fd;
+    char *path;
+} OpenedFile;
+
+/** A fault injected into the calls on some paths. */
+typedef struct {
+    LkpIoOperation operation;
+    char *prefix;
+    long long nth; /** 0 for every matching call. */
+    long long matched; /** Matching calls so far. */
+    int error; /** The errno to fail with, or 0 to shorten the call instead. */
+    long long bytes; /** Most bytes a shortened call transfers. */
+} Fault;
+
+LKP_DECLARE_DA_STRUCT(FakeFileArray, FakeFile);
+LKP_DECLARE_DA_STRUCT(OpenedFileArray, OpenedFile);
+LKP_DECLARE_DA_STRUCT(FaultArray, Fault);
+
+static atomic_bool active = false; /** Whether there are fake files or faults to check. */
+static atomic_llong injected = 0;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static char *fakePrefix = NULL;
+static FakeFileArray fakeFiles = {0, 0, NULL};
+static OpenedFileArray openedFiles = {0, 0, NULL};
+static FaultArray faults = {0, 0, NULL};
+
+/** Allocates a copy of a string. */
+static char *copy_string(const char *string) {
+    const size_t length = strlen(string);
+    char *copy = lkp_allocate(length + 1, sizeof(char));
+    memcpy(copy, string, length + 1);
+    return copy;
+}
+
+/** Returns whether the path starts with the prefix. */
+static bool has_prefix(const char *path, const char *prefix) {
+    return strncmp(path, prefix, strlen(prefix)) == 0;
+}
+
+/** Returns the path a descriptor was opened with while holding the lock, or NULL if unknown. */
+static const char *opened_path(const int fd) {
+    for (int i = 0; i < openedFiles.length; i++) {
+        if (openedFiles.data[i].fd == fd) {
+            return openedFiles.data[i].path;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Finds the fault a call hits, counting the call for every matching fault.
+ * 
+ * When several faults hit the same call, the one injected last wins.
+ * 
+ * @param operation The call.
+ * @param path The path it's on, or NULL if it isn't on a known file.
+ * @param[out] fault The fault it hits, copied out so it can be used after unlocking.
+ * 
+ * @return Whether it hits one.
+ */
+static bool find_fault(const LkpIoOperation operation, const char *path, Fault *fault) {
+    bool hit = false;
+    for (int i = faults.length - 1; path != NULL && i >= 0; i--) {
+        Fault *current = &faults.data[i];
+        if (current->operation != operation || !has_prefix(path, current->prefix)) {
+            continue;
+        }
+        current->matched++;
+        if (!hit && (current->nth == 0 || current->matched == current->nth)) {
+            *fault = *current;
+            hit = true;
+        }
+    }
+    return hit;
+}
+
+/** Fails the call with the fault's error (EIO if it had none), counting it as injected. */
+static int fail_call(const Fault *fault) {
+    atomic_fetch_add(&injected, 1);
+    errno = fault->error != 0 ? fault->error : EIO;
+    return -1;
+}
+
+/** Returns how many bytes a read or write transfers after its fault, counting it if it's cut. */
+static size_t shorten_call(const Fault *fault, const size_t count) {
+    if (count <= (size_t)fault->bytes) {
+        return count;
+    }
+    atomic_fetch_add(&injected, 1);
+    return (size_t)fault->bytes;
+}
+
+/** Finds the fault a call on a descriptor hits, like find_fault(). */
+static bool find_fd_fault(const LkpIoOperation operation, const int fd, Fault *fault) {
+    pthread_mutex_lock(&lock);
+    const bool hit = find_fault(operation, opened_path(fd), fault);
+    pthread_mutex_unlock(&lock);
+    return hit;
+}
+
+/** Returns the fake file of a path while holding the lock, or NULL if there isn't one yet. */
+static FakeFile *find_fake_file(const char *path) {
+    for (int i = 0; i < fakeFiles.length; i++) {
+        if (strcmp(fakeFiles.data[i].path, path) == 0) {
+            return &fakeFiles.data[i];
+        }
+    }
+    return NULL;
+}
+
+/** Opens a fake file with the flags of the call while holding the lock, creating it if needed. */
+static int open_fake_file(const char *path, const int flags) {
+    FakeFile *file = find_fake_file(path);
+    if (file == NULL && !(flags & O_CREAT)) {
+        errno = ENOENT;
+        return -1;
+    }
+    if (file != NULL && (flags & O_CREAT) && (flags & O_EXCL)) {
+        errno = EEXIST;
+        return -1;
+    }
+    if (file == NULL) {
+        const int memfd = memfd_create("lukip_fake_file", MFD_CLOEXEC);
+        if (memfd == -1) {
+            return -1;
+        }
+        FakeFile created = {.path = copy_string(path), .memfd = memfd};
+        LKP_APPEND_DA(&fakeFiles, created);
+        file = &fakeFiles.data[fakeFiles.length - 1];
+    }
+    char procPath[64];
+    snprintf(procPath, sizeof(procPath), "/proc/self/fd/%d", file->memfd);
+    return __real_open(procPath, flags & ~(O_CREAT | O_EXCL | O_NOFOLLOW));
+}
+
+/** Opens a path, faking it or failing it as needed. Used by both open() and open64(). */
+static int open_path(
+    int (*realOpen)(const char *, int, ...), const char *path, const int flags, const mode_t mode
+) {
+    if (!atomic_load(&active)) {
+        return realOpen(path, flags, mode);
+    }
+    pthread_mutex_lock(&lock);
+    Fault fault;
+    if (find_fault(LKP_IO_OPEN, path, &fault)) {
+        pthread_mutex_unlock(&lock);
+        return fail_call(&fault);
+    }
+    const bool fake = fakePrefix != NULL && has_prefix(path, fakePrefix);
+    const int fd = fake ? open_fake_file(path, flags) : realOpen(path, flags, mode);
+    if (fd != -1) {
+        OpenedFile opened = {.fd = fd, .path = copy_string(path)};
+        LKP_APPEND_DA(&openedFiles, opened);
+    }
+    pthread_mutex_unlock(&lock);
+    return fd;
+}
+
+/** Reads the mode argument of open(), which is only passed when creating a file. */
+#define OPEN_MODE(flags, mode) \
+    do { \
+        if ((flags) & (O_CREAT | O_TMPFILE)) { \
+            va_list args; \
+            va_start(args, flags); \
+            mode = va_arg(args, mode_t); \
+            va_end(args); \
+        } \
+    } while (false)
+
+/** Called instead of open() by programs linked with --wrap=open. */
+int __wrap_open(const char *path, int flags, ...) {
+    mode_t mode = 0;
+    OPEN_MODE(flags, mode);
+    return open_path(__real_open, path, flags, mode);
+}
+
+/** Called instead of open64() by programs linked with --wrap=open64. */
+int __wrap_open64(const char *path, int flags, ...) {
+    mode_t mode = 0;
+    OPEN_MODE(flags, mode);
+    return open_path(__real_open64, path, flags, mode);
+}
+
+/** Called instead of read() by programs linked with --wrap=read. */
+ssize_t __wrap_read(int fd, void *buffer, size_t count) {
+    Fault fault;
+    if (atomic_load(&active) && find_fd_fault(LKP_IO_READ, fd, &fault)) {
+        if (fault.error != 0) {
+            return fail_call(&fault);
+        }
+        count = shorten_call(&fault, count);
+    }
+    return __real_read(fd, buffer, count);
+}
+
+/** Called instead of write() by programs linked with --wrap=write. */
+ssize_t __wrap_write(int fd, const void *buffer, size_t count) {
+    Fault fault;
+    if (atomic_load(&active) && find_fd_fault(LKP_IO_WRITE, fd, &fault)) {
+        if (fault.error != 0) {
+            return fail_call(&fault);
+        }
+        count = shorten_call(&fault, count);
+    }
+    return __real_write(fd, buffer, count);
+}
+
+/** Called instead of fsync() by programs linked with --wrap=fsync. */
+int __wrap_fsync(int fd) {
+    Fault fault;
+    if (atomic_load(&active) && find_fd_fault(LKP_IO_FSYNC, fd, &fault)) {
+        return fail_call(&fault);
+    }
+    return __real_fsync(fd);
+}
+
+/** Called instead of close() by programs linked with --wrap=close, which always closes the fd. */
+int __wrap_close(int fd) {
+    if (!atomic_load(&active)) {
+        return __real_close(fd);
+    }
+    pthread_mutex_lock(&lock);
+    Fault fault;
+    const bool hit = find_fault(LKP_IO_CLOSE, opened_path(fd), &fault);
+    for (int i = 0; i < openedFiles.length; i++) {
+        if (openedFiles.data[i].fd == fd) {
+            free(openedFiles.data[i].path);
+            openedFiles.data[i] = openedFiles.data[--openedFiles.length];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&lock);
+
+    const int result = __real_close(fd);
+    return hit ? fail_call(&fault) : result;
+}
+
+/** Only true when the program was linked with --wrap, which resolves the real functions. */
+bool lkp_io_faults_supported() {
+    return __real_open != NULL && __real_read != NULL && __real_close != NULL;
+}
+
+/** Fakes the files under a prefix from now on, replacing the previous prefix. */
+void lkp_fake_files(const char *prefix) {
+    pthread_mutex_lock(&lock);
+    free(fakePrefix);
+    fakePrefix = copy_string(prefix);
+    atomic_store(&active, true);
+    pthread_mutex_unlock(&lock);
+}
+
+/** Adds a fault to the ones calls are checked against. */
+static void add_fault(const Fault fault) {
+    pthread_mutex_lock(&lock);
+    LKP_APPEND_DA(&faults, fault);
+    atomic_store(&active, true);
+    pthread_mutex_unlock(&lock);
+}
+
+/** Makes calls under a prefix fail with an error. */
+void lkp_fail_io(
+    const LkpIoOperation operation, const char *prefix, const long long nth, const int error
+) {
+    const Fault fault = {
+        .operation = operation, .prefix = copy_string(prefix), .nth = nth, .matched = 0,
+        .error = error != 0 ? error : EIO, .bytes = 0
+    };
+    add_fault(fault);
+}
+
+/** Makes reads or writes under a prefix transfer fewer bytes. */
+void lkp_shorten_io(
+    const LkpIoOperation operation, const char *prefix, const long long nth, const long long bytes
+) {
+    const Fault fault = {
+        .operation = operation, .prefix = copy_string(prefix), .nth = nth, .matched = 0,
+        .error = 0, .bytes = bytes > 0 ? bytes : 0
+    };
+    add_fault(fault);
+}
+
+/** Returns how many calls were failed or shortened since the last reset. */
+long long lkp_injected_io_faults() {
+    return atomic_load(&injected);
+}
+
+/** Drops the fake files and faults. Descriptors the test left open stay open. */
+void lkp_reset_io() {
+    if (!atomic_load(&active)) {
+        return;
+    }
+    pthread_mutex_lock(&lock);
+    atomic_store(&active, false);
+    for (int i = 0; i < fakeFiles.length; i++) {
+        __real_close(fakeFiles.data[i].memfd);
+        free(fakeFiles.data[i].path);
+    }
+    for (int i = 0; i < openedFiles.length; i++) {
+        free(openedFiles.data[i].path);
+    }
+    for (int i = 0; i < faults.length; i++) {
+        free(faults.data[i].prefix);
+    }
+    LKP_FREE_DA(&fakeFiles);
+    LKP_FREE_DA(&openedFiles);
+    LKP_FREE_DA(&faults);
+    LKP_INIT_DA(&fakeFiles);
+    LKP_INIT_DA(&openedFiles);
+    LKP_INIT_DA(&faults);
+    free(fakePrefix);
+    fakePrefix = NULL;
+    atomic_store(&injected, 0);
+    pthread_mutex_unlock(&lock);
+}
+
+#else
+
+/** There's nothing to wrap the I/O with. */
+bool lkp_io_faults_supported() {
+    return false;
+}
+
+/** Does nothing, since the I/O can't be wrapped. */
+void lkp_fake_files(const char *prefix) {
+    (void)prefix;
+}
+
+/** Does nothing, since the I/O can't be wrapped. */
+void lkp_fail_io(
+    const LkpIoOperation operation, const char *prefix, const long long nth, const int error
+) {
+    (void)operation;
+    (void)prefix;
+    (void)nth;
+    (void)error;
+}
+
+/** Does nothing, since the I/O can't be wrapped. */
+void lkp_shorten_io(
+    const LkpIoOperation operation, const char *prefix, const long long nth, const long long bytes
+) {
+    (void)operation;
+    (void)prefix;
+    (void)nth;
+    (void)bytes;
+}
+
+/** Nothing ever gets injected without wrapping. */
+long long lkp_injected_io_faults() {
+    return 0;
+}
+
+/** Does nothing, since the I/O can't be wrapped. */
+void lkp_reset_io() {
+}
+
+#endif
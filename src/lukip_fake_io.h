@@ -0,0 +1,78 @@
+/**
+ * @file lukip_fake_io.h
+ * @brief Header for faking files in memory, and making the program's file I/O fail on purpose.
+ * 
+ * Only works when the test program is linked with LKP_IO_WRAP_FLAGS (which "make tests" does
+ * on Linux), so calls to open(), read(), write(), fsync() and close() go through Lukip first.
+ * I/O done inside of libc itself (like by fopen() and fwrite()) isn't affected.
+ * 
+ * @author Larmix
+ */
+
+#ifndef LUKIP_FAKE_IO_H
+#define LUKIP_FAKE_IO_H
+
+#include <stdbool.h>
+
+/** Linker flags a program needs for faking files and failing their I/O. */
+#define LKP_IO_WRAP_FLAGS \
+    "-Wl,--wrap=open,--wrap=open64,--wrap=read,--wrap=write,--wrap=fsync,--wrap=close"
+
+/** The calls a fault can be injected into. */
+typedef enum {
+    LKP_IO_OPEN,
+    LKP_IO_READ,
+    LKP_IO_WRITE,
+    LKP_IO_FSYNC,
+    LKP_IO_CLOSE
+} LkpIoOperation;
+
+/** Returns whether the program was linked with the wrapped I/O functions. */
+bool lkp_io_faults_supported();
+
+/**
+ * @brief Keeps every file whose path starts with the prefix in memory instead of on disk.
+ * 
+ * The files start out missing, and are backed by memfds so everything that takes a file descriptor
+ * (lseek(), fstat(), mmap()...) works on them. Only open() knows about their paths though,
+ * so stat(), unlink() and the like still see the real disk.
+ * 
+ * @param prefix The start of the faked paths, like "/var/lib/app/".
+ */
+void lkp_fake_files(const char *prefix);
+
+/**
+ * @brief Makes calls on files whose path starts with the prefix fail with an error.
+ * 
+ * Files only get matched by their path if they were opened after the fault was injected
+ * (or after lkp_fake_files() was called), so pipes, sockets and the standard streams never fail.
+ * When several faults hit the same call, the one injected last wins.
+ * 
+ * @param operation Which call fails.
+ * @param prefix The start of the paths it fails for, where "" matches every opened file.
+ * @param nth Which matching call from now fails (starting from 1), or 0 for every one of them.
+ * @param error The errno it fails with, like ENOSPC, EIO or EINTR.
+ */
+void lkp_fail_io(
+    const LkpIoOperation operation, const char *prefix, const long long nth, const int error
+);
+
+/**
+ * @brief Makes reads or writes on files whose path starts with the prefix only go partway through.
+ * 
+ * @param operation LKP_IO_READ or LKP_IO_WRITE.
+ * @param prefix The start of the paths it's for, where "" matches every opened file.
+ * @param nth Which matching call from now is cut short (starting from 1), or 0 for every one.
+ * @param bytes The most bytes the call transfers.
+ */
+void lkp_shorten_io(
+    const LkpIoOperation operation, const char *prefix, const long long nth, const long long bytes
+);
+
+/** Returns how many calls were made to fail (or cut short) since the I/O was last reset. */
+long long lkp_injected_io_faults();
+
+/** Drops every fake file and injected fault, going back to the real disk. */
+void lkp_reset_io();
+
+#endif
@@ -0,0 +1,646 @@
+/**
+ * @file lukip_fuzz.c
+ * @brief Runs fuzz tests on their saved inputs, and fuzzes them for new ones in fuzzing builds.
+ * 
+ * Fuzzing builds compile Lukip with LKP_FUZZ and the code under test with
+ * -fsanitize-coverage=trace-pc. The compiler then calls __sanitizer_cov_trace_pc() at the start
+ * of every basic block, and pairs of consecutive blocks are hashed into a map of edges (like AFL).
+ * An input that reaches an edge (or an edge's hit count) we haven't seen yet joins the corpus,
+ * and inputs which found more new edges get picked more often for mutating.
+ * 
+ * @author Larmix
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "lukip_dynamic_array.h"
+#include "lukip_fuzz.h"
+#include "lukip_hash.h"
+#include "lukip_platform.h"
+#include "lukip_property.h"
+#include "lukip_timeout.h"
+
+#ifdef LKP_POSIX
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(LKP_FUZZ) && defined(LKP_COVERAGE)
+#error "A build can either record coverage or fuzz, since both define __sanitizer_cov_trace_pc()."
+#endif
+
+#if defined(LKP_FUZZ) && defined(LKP_POSIX)
+    #define FUZZING /** Whether this build mutates inputs, rather than only running saved ones. */
+#endif
+
+/** Longest path of an input's file. */
+#define PATH_LENGTH 1024
+
+/** Biggest input the fuzzer mutates into. */
+#define MAX_INPUT_SIZE 4096
+
+/** What an input's jump buffer is jumped to with when it runs out of time. */
+#define INPUT_TIMED_OUT 2
+
+/** An input of a fuzz test, and how much new coverage it found when it was added. */
+typedef struct {
+    uint8_t *data;
+    size_t size;
+    int score;
+} FuzzInput;
+
+/** The inputs which get mutated into new ones. */
+LKP_DECLARE_DA_STRUCT(FuzzInputArray, FuzzInput);
+
+/** Names of the files in a directory. */
+LKP_DECLARE_DA_STRUCT(FileNameArray, char *);
+
+/** A fuzz test, where its inputs are kept, and what it went through so far. */
+typedef struct {
+    LkpFuzzFunc target;
+    char corpusDir[PATH_LENGTH];
+    char crashesDir[PATH_LENGTH];
+    FuzzInputArray corpus;
+    int totalScore;
+    int timeout; /** How long each input can run for in milliseconds, or 0 for no limit. */
+    LkpFuzzResult *result;
+} FuzzTarget;
+
+static LkpJumpBuf *volatile timedJump = NULL; /** Where the running input's watchdog jumps to. */
+
+#ifdef FUZZING
+
+/** Amount of edges in the map (a power of 2). */
+#define EDGE_MAP_SIZE (1 << 16)
+
+static uint8_t edgeHits[EDGE_MAP_SIZE]; /** How many times the current input hit each edge. */
+static uint8_t seenBuckets[EDGE_MAP_SIZE]; /** Every bucket of hit counts seen for each edge. */
+static uint16_t touchedEdges[EDGE_MAP_SIZE]; /** Edges the current input hit, to not scan the map. */
+static size_t touchedAmount = 0;
+static uintptr_t previousBlock = 0; /** The last block, which is the start of the next edge. */
+static volatile bool tracing = false; /** Whether an input is running right now. */
+
+/** The input that's running, for saving it if it crashes the program. */
+static const uint8_t *volatile crashingData = NULL;
+static volatile size_t crashingSize = 0;
+static const char *crashingDir = NULL;
+
+/** Signals which mean the input crashed the program. */
+static const int crashSignals[] = {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT};
+#define CRASH_SIGNAL_AMOUNT ((int)(sizeof(crashSignals) / sizeof(crashSignals[0])))
+
+/** Called by instrumented code at the start of every basic block. */
+void __sanitizer_cov_trace_pc() {
+    if (!tracing) {
+        return;
+    }
+    const uintptr_t block = (uintptr_t)__builtin_return_address(0);
+    const size_t edge = (block ^ previousBlock) & (EDGE_MAP_SIZE - 1);
+    if (edgeHits[edge] == 0) {
+        touchedEdges[touchedAmount++] = (uint16_t)edge;
+    }
+    if (edgeHits[edge] != UINT8_MAX) {
+        edgeHits[edge]++;
+    }
+    previousBlock = block >> 1; // Shifted so A -> B and B -> A are different edges.
+}
+
+/** Starts tracing the edges of an input. */
+static void begin_tracing() {
+    previousBlock = 0;
+    tracing = true;
+}
+
+/** Returns the bucket of a hit count (1, 2, 3, 4-7, 8-15, 16-31, 32-127, 128+) as a bit. */
+static uint8_t hit_bucket(const uint8_t hits) {
+    if (hits <= 3) {
+        return hits == 3 ? 4 : hits;
+    }
+    if (hits < 8) {
+        return 8;
+    } else if (hits < 16) {
+        return 16;
+    } else if (hits < 32) {
+        return 32;
+    }
+    return hits < 128 ? 64 : 128;
+}
+
+/** Stops tracing, and returns how many edges (or buckets of them) the input was first to reach. */
+static int end_tracing() {
+    tracing = false;
+    int newEdges = 0;
+    for (size_t i = 0; i < touchedAmount; i++) {
+        const uint16_t edge = touchedEdges[i];
+        const uint8_t bucket = hit_bucket(edgeHits[edge]);
+        if ((seenBuckets[edge] & bucket) == 0) {
+            seenBuckets[edge] |= bucket;
+            newEdges++;
+        }
+        edgeHits[edge] = 0;
+    }
+    touchedAmount = 0;
+    return newEdges;
+}
+
+/** Returns how many edges were reached by any input so far. */
+static int covered_edges() {
+    int covered = 0;
+    for (size_t i = 0; i < EDGE_MAP_SIZE; i++) {
+        covered += seenBuckets[i] != 0;
+    }
+    return covered;
+}
+
+#else
+
+/** Only fuzzing builds trace edges. */
+static void begin_tracing() {
+}
+
+/** Only fuzzing builds trace edges, so nothing's ever new. */
+static int end_tracing() {
+    return 0;
+}
+
+#endif
+
+/** Skips the rest of an input which ran out of time, from the watchdog's signal handler. */
+static void on_input_timeout() {
+    LkpJumpBuf *jump = timedJump;
+    if (jump != NULL) {
+        timedJump = NULL;
+        LKP_LONGJMP(*jump, INPUT_TIMED_OUT);
+    }
+}
+
+/**
+ * @brief Runs the fuzz test on one input, with its asserts going into the passed sink.
+ * 
+ * @param[out] newEdges How many edges it was the first to reach.
+ * 
+ * @return Whether the input failed, in which case the sink's message has to be freed.
+ */
+static bool run_input(
+    FuzzTarget *fuzzTarget, const uint8_t *data, const size_t size,
+    LkpCaseSink *sink, int *newEdges
+) {
+    LkpJumpBuf jump;
+    sink->info.status = LKP_TEST_UNKNOWN;
+    sink->info.fileName = NULL;
+    sink->info.funcName = NULL;
+    sink->asserts = 0;
+    sink->message = NULL;
+    sink->line = 0;
+    sink->jump = &jump;
+
+    lkp_set_case_sink(sink);
+    begin_tracing();
+    LkpWatchdog watchdog = {.armed = false};
+    const int jumpValue = LKP_SETJMP(jump);
+    if (jumpValue == 0) {
+        const int timeout = fuzzTarget->timeout;
+        if (timeout > 0 && lkp_arm_watchdog(timeout, on_input_timeout, &watchdog)) {
+            timedJump = &jump;
+        }
+        fuzzTarget->target(data, size);
+    }
+    timedJump = NULL;
+    lkp_disarm_watchdog(&watchdog);
+    *newEdges = end_tracing();
+    lkp_set_case_sink(NULL);
+    if (jumpValue == INPUT_TIMED_OUT && sink->message == NULL) {
+        sink->message = lkp_strf_alloc("Timed out after %d ms.", fuzzTarget->timeout);
+    }
+
+    LkpFuzzResult *result = fuzzTarget->result;
+    result->asserts += sink->asserts;
+    if (result->info.fileName == NULL) {
+        result->info = sink->info;
+    }
+    return sink->message != NULL;
+}
+
+/** Records the failure in the sink along with the file its input is in. */
+static void record_failure(FuzzTarget *fuzzTarget, const LkpCaseSink *sink, const char *path) {
+    LkpFuzzFailure failure = {.failure = *sink, .path = lkp_strf_alloc("%s", path)};
+    failure.failure.jump = NULL;
+    LKP_APPEND_DA(&fuzzTarget->result->failures, failure);
+}
+
+/** Adds a copy of the input to the ones that get mutated. */
+static void add_input(
+    FuzzTarget *fuzzTarget, const uint8_t *data, const size_t size, const int score
+) {
+    FuzzInput input = {.data = lkp_allocate(size > 0 ? (int)size : 1, 1), .size = size};
+    input.score = score;
+    if (size > 0) {
+        memcpy(input.data, data, size);
+    }
+    LKP_APPEND_DA(&fuzzTarget->corpus, input);
+    fuzzTarget->totalScore += score;
+}
+
+#ifdef LKP_POSIX
+
+/** Compares 2 file names for qsort(). */
+static int compare_names(const void *name1, const void *name2) {
+    return strcmp(*(char *const *)name1, *(char *const *)name2);
+}
+
+/** Lists the (non hidden) files of a directory sorted by name, so they run in the same order. */
+static void list_directory(const char *directory, FileNameArray *names) {
+    LKP_INIT_DA(names);
+    DIR *dir = opendir(directory);
+    if (dir == NULL) {
+        return;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] != '.') {
+            LKP_APPEND_DA(names, lkp_strf_alloc("%s", entry->d_name));
+        }
+    }
+    closedir(dir);
+    if (names->length > 1) {
+        qsort(names->data, names->length, sizeof(char *), compare_names);
+    }
+}
+
+#else
+
+/** Reading directories needs POSIX, so there are no saved inputs to run elsewhere. */
+static void list_directory(const char *directory, FileNameArray *names) {
+    (void)directory;
+    LKP_INIT_DA(names);
+}
+
+#endif
+
+/** Reads a whole file into a newly allocated input, returning false if it couldn't. */
+static bool read_input(const char *path, FuzzInput *input) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return false;
+    }
+    LkpGenText bytes;
+    LKP_INIT_DA(&bytes);
+    int byte;
+    while ((byte = fgetc(file)) != EOF) {
+        LKP_APPEND_DA(&bytes, (char)byte);
+    }
+    fclose(file);
+    input->data = (uint8_t *)bytes.data;
+    input->size = bytes.length;
+    return true;
+}
+
+/**
+ * Runs every input saved in a directory, and records the ones that fail.
+ * Passing inputs of the corpus are kept for mutating into new ones.
+ */
+static void run_saved_inputs(FuzzTarget *fuzzTarget, const char *directory, const bool keep) {
+    FileNameArray names;
+    list_directory(directory, &names);
+    LkpCaseSink sink;
+    for (int i = 0; i < names.length; i++) {
+        char path[PATH_LENGTH];
+        snprintf(path, PATH_LENGTH, "%s/%s", directory, names.data[i]);
+        free(names.data[i]);
+
+        FuzzInput input;
+        if (!read_input(path, &input)) {
+            continue;
+        }
+        int newEdges;
+        if (run_input(fuzzTarget, input.data, input.size, &sink, &newEdges)) {
+            record_failure(fuzzTarget, &sink, path);
+        } else if (keep) {
+            add_input(fuzzTarget, input.data, input.size, newEdges > 0 ? newEdges : 1);
+        }
+        free(input.data);
+    }
+    LKP_FREE_DA(&names);
+}
+
+#ifdef FUZZING
+
+extern int __real_open(const char *path, int flags, ...) __attribute__((weak));
+extern ssize_t __real_write(int fd, const void *buffer, size_t count) __attribute__((weak));
+extern int __real_close(int fd) __attribute__((weak));
+
+/** Returns the current time in milliseconds. */
+static long long now_ms() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000LL + now.tv_nsec / 1000000;
+}
+
+/** Makes a directory and every one above it, ignoring the ones that already exist. */
+static void make_directories(const char *path) {
+    char partial[PATH_LENGTH];
+    snprintf(partial, PATH_LENGTH, "%s", path);
+    for (char *current = partial + 1; *current != '\0'; current++) {
+        if (*current == '/') {
+            *current = '\0';
+            mkdir(partial, 0755);
+            *current = '/';
+        }
+    }
+    mkdir(partial, 0755);
+}
+
+/** Writes an input to "<directory>/<prefix><hash of the input>", and puts that path in path. */
+static void save_input(
+    const char *directory, const char *prefix, const uint8_t *data, const size_t size,
+    char path[PATH_LENGTH]
+) {
+    snprintf(
+        path, PATH_LENGTH, "%s/%s%016" PRIx64, directory, prefix, lkp_hash_bytes(data, size)
+    );
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        fprintf(
+            stderr, "Lukip failed to save \"%s\": %s (Errno %d)\n", path, strerror(errno), errno
+        );
+        return;
+    }
+    fwrite(data, 1, size, file);
+    fclose(file);
+}
+
+/**
+ * Writes past the wrapped write() when there's one, since looking its faults up takes a lock
+ * (which isn't safe in a signal handler, like open() and close()).
+ */
+static void write_safely(const int fd, const void *data, const size_t size) {
+    const ssize_t written = __real_write != NULL
+        ? __real_write(fd, data, size) : write(fd, data, size);
+    (void)written;
+}
+
+/** Appends a string to a path without anything that's unsafe in a signal handler. */
+static void append_safely(char *path, size_t *length, const char *string) {
+    while (*string != '\0' && *length < PATH_LENGTH - 1) {
+        path[(*length)++] = *string++;
+    }
+    path[*length] = '\0';
+}
+
+/** Saves the input which crashed the program as a reproducer, then lets the signal kill us. */
+static void on_crash(int signalNumber) {
+    if (crashingData != NULL && crashingDir != NULL) {
+        char path[PATH_LENGTH], hash[17];
+        const uint64_t hashValue = lkp_hash_bytes((const void *)crashingData, crashingSize);
+        for (int i = 0; i < 16; i++) {
+            hash[i] = "0123456789abcdef"[(hashValue >> ((15 - i) * 4)) & 0xF];
+        }
+        hash[16] = '\0';
+        size_t length = 0;
+        path[0] = '\0';
+        append_safely(path, &length, crashingDir);
+        append_safely(path, &length, "/crash-");
+        append_safely(path, &length, hash);
+
+        const int flags = O_WRONLY | O_CREAT | O_TRUNC;
+        const int fd = __real_open != NULL
+            ? __real_open(path, flags, 0644) : open(path, flags, 0644);
+        if (fd >= 0) {
+            write_safely(fd, (const void *)crashingData, crashingSize);
+            if (__real_close != NULL) {
+                __real_close(fd);
+            } else {
+                close(fd);
+            }
+        }
+        const char *note = "\nLukip saved the input that crashed to ";
+        write_safely(STDERR_FILENO, note, strlen(note));
+        write_safely(STDERR_FILENO, path, length);
+        write_safely(STDERR_FILENO, "\n", 1);
+    }
+    raise(signalNumber); // The handler was reset to the default one, so this kills us for real.
+}
+
+/** Saves the inputs that crash the program while fuzzing, or restores the old handlers. */
+static void handle_crashes(const bool handle, struct sigaction oldActions[CRASH_SIGNAL_AMOUNT]) {
+    for (int i = 0; i < CRASH_SIGNAL_AMOUNT; i++) {
+        if (!handle) {
+            sigaction(crashSignals[i], &oldActions[i], NULL);
+            continue;
+        }
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = on_crash;
+        action.sa_flags = SA_RESETHAND | SA_NODEFER;
+        sigemptyset(&action.sa_mask);
+        sigaction(crashSignals[i], &action, &oldActions[i]);
+    }
+}
+
+/** Picks an input to mutate, where inputs which found more new edges get picked more often. */
+static const FuzzInput *pick_input(const FuzzTarget *fuzzTarget, uint64_t *state) {
+    int target = (int)(lkp_next_random(state) % (uint64_t)fuzzTarget->totalScore);
+    for (int i = 0; i < fuzzTarget->corpus.length; i++) {
+        target -= fuzzTarget->corpus.data[i].score;
+        if (target < 0) {
+            return &fuzzTarget->corpus.data[i];
+        }
+    }
+    return &fuzzTarget->corpus.data[fuzzTarget->corpus.length - 1];
+}
+
+/** Returns a random number in [0, bound). */
+static size_t random_below(uint64_t *state, const size_t bound) {
+    return bound == 0 ? 0 : (size_t)(lkp_next_random(state) % bound);
+}
+
+/**
+ * @brief Applies a few random mutations to an input.
+ * 
+ * @param data The input's bytes, which have room for MAX_INPUT_SIZE.
+ * @param size The input's size.
+ * 
+ * @return The mutated input's size.
+ */
+static size_t mutate(const FuzzTarget *fuzzTarget, uint64_t *state, uint8_t *data, size_t size) {
+    static const uint8_t interesting[] = {0, 1, 0x7F, 0x80, 0xFF, '0', '9', ' ', '\n', '"'};
+    const int mutations = 1 + (int)random_below(state, 4);
+    for (int i = 0; i < mutations; i++) {
+        const size_t position = random_below(state, size);
+        switch (random_below(state, 7)) {
+        case 0: // Flip a bit.
+            if (size > 0) {
+                data[position] ^= 1 << random_below(state, 8);
+            }
+            break;
+        case 1: // Set a random byte.
+            if (size > 0) {
+                data[position] = (uint8_t)lkp_next_random(state);
+            }
+            break;
+        case 2: // Set a byte that's likely to be a boundary.
+            if (size > 0) {
+                data[position] = interesting[random_below(state, sizeof(interesting))];
+            }
+            break;
+        case 3: // Nudge a byte up or down.
+            if (size > 0) {
+                data[position] += (uint8_t)(random_below(state, 33) - 16);
+            }
+            break;
+        case 4: // Insert a random byte.
+            if (size < MAX_INPUT_SIZE) {
+                memmove(&data[position + 1], &data[position], size - position);
+                data[position] = (uint8_t)lkp_next_random(state);
+                size++;
+            }
+            break;
+        case 5: { // Erase some bytes.
+            const size_t left = size - position;
+            const size_t amount = 1 + random_below(state, left < 8 ? left : 8);
+            if (size > 0) {
+                memmove(&data[position], &data[position + amount], size - position - amount);
+                size -= amount;
+            }
+            break;
+        }
+        case 6: { // Splice in a chunk of another input.
+            const FuzzInput *other = &fuzzTarget->corpus.data[
+                random_below(state, fuzzTarget->corpus.length)
+            ];
+            const size_t start = random_below(state, other->size);
+            size_t amount = 1 + random_below(state, other->size - start);
+            if (other->size == 0 || size + amount > MAX_INPUT_SIZE) {
+                break;
+            }
+            memmove(&data[position + amount], &data[position], size - position);
+            memcpy(&data[position], &other->data[start], amount);
+            size += amount;
+            break;
+        }
+        }
+    }
+    return size;
+}
+
+/**
+ * @brief Mutates the corpus for new inputs until the time (or amount of runs) runs out.
+ * 
+ * Stops at the first failing input, which is saved as a reproducer in the crashes directory.
+ * An input which crashes the whole program gets saved by the signal handler instead.
+ */
+static void fuzz(FuzzTarget *fuzzTarget, const char *name, const LkpOptions *options) {
+    make_directories(fuzzTarget->corpusDir);
+    make_directories(fuzzTarget->crashesDir);
+    if (fuzzTarget->corpus.length == 0) {
+        add_input(fuzzTarget, NULL, 0, 1);
+    }
+    uint64_t state = options->seed ^ lkp_hash_bytes(name, strlen(name));
+    uint8_t *input = lkp_allocate(MAX_INPUT_SIZE, sizeof(uint8_t));
+    struct sigaction oldActions[CRASH_SIGNAL_AMOUNT];
+    crashingDir = fuzzTarget->crashesDir;
+    handle_crashes(true, oldActions);
+
+    const long long start = now_ms();
+    const long long deadline = start + options->fuzzSeconds * 1000LL;
+    long long runs = 0;
+    int added = 0;
+    LkpCaseSink sink;
+    while (options->fuzzRuns == 0 || runs < options->fuzzRuns) {
+        if (runs % 256 == 0 && now_ms() >= deadline) {
+            break;
+        }
+        const FuzzInput *parent = pick_input(fuzzTarget, &state);
+        memcpy(input, parent->data, parent->size);
+        const size_t size = mutate(fuzzTarget, &state, input, parent->size);
+
+        crashingSize = size;
+        crashingData = input;
+        int newEdges;
+        const bool failed = run_input(fuzzTarget, input, size, &sink, &newEdges);
+        crashingData = NULL;
+        runs++;
+
+        char path[PATH_LENGTH];
+        if (failed) {
+            save_input(fuzzTarget->crashesDir, "fail-", input, size, path);
+            record_failure(fuzzTarget, &sink, path);
+            break;
+        }
+        if (newEdges > 0) {
+            save_input(fuzzTarget->corpusDir, "", input, size, path);
+            add_input(fuzzTarget, input, size, newEdges);
+            added++;
+        }
+    }
+    handle_crashes(false, oldActions);
+    crashingDir = NULL;
+    free(input);
+
+    const double seconds = (now_ms() - start) / 1000.0;
+    printf(
+        "Fuzzed %s: %lld runs in %.1lfs (%.0lf/s), %d new inputs, %d edges covered.\n",
+        name, runs, seconds, seconds > 0 ? runs / seconds : (double)runs, added, covered_edges()
+    );
+}
+
+#endif
+
+/** Runs the empty input and the saved ones first, since they're the regression tests. */
+void lkp_run_fuzz_test(
+    const LkpFuzzFunc target, const char *name, const LkpOptions *options, const int timeout,
+    LkpFuzzResult *result
+) {
+    result->info.status = LKP_TEST_UNKNOWN;
+    result->info.fileName = NULL;
+    result->info.funcName = NULL;
+    result->asserts = 0;
+    LKP_INIT_DA(&result->failures);
+
+    FuzzTarget fuzzTarget = {
+        .target = target, .totalScore = 0, .timeout = timeout, .result = result
+    };
+    LKP_INIT_DA(&fuzzTarget.corpus);
+    snprintf(
+        fuzzTarget.corpusDir, PATH_LENGTH, "%s/%s/" LKP_CORPUS_DIR, options->fuzzDir, name
+    );
+    snprintf(
+        fuzzTarget.crashesDir, PATH_LENGTH, "%s/%s/" LKP_CRASHES_DIR, options->fuzzDir, name
+    );
+
+    LkpCaseSink sink;
+    int newEdges;
+    if (run_input(&fuzzTarget, NULL, 0, &sink, &newEdges)) {
+        record_failure(&fuzzTarget, &sink, "(empty input)");
+    } else {
+        add_input(&fuzzTarget, NULL, 0, 1);
+    }
+    run_saved_inputs(&fuzzTarget, fuzzTarget.corpusDir, true);
+    run_saved_inputs(&fuzzTarget, fuzzTarget.crashesDir, false);
+
+#ifdef FUZZING
+    if (result->failures.length == 0) {
+        fuzz(&fuzzTarget, name, options);
+    }
+#endif
+    for (int i = 0; i < fuzzTarget.corpus.length; i++) {
+        free(fuzzTarget.corpus.data[i].data);
+    }
+    LKP_FREE_DA(&fuzzTarget.corpus);
+}
+
+/** Frees the message and path of every failure. */
+void lkp_free_fuzz_result(LkpFuzzResult *result) {
+    for (int i = 0; i < result->failures.length; i++) {
+        free(result->failures.data[i].failure.message);
+        free(result->failures.data[i].path);
+    }
+    LKP_FREE_DA(&result->failures);
+}
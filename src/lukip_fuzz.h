@@ -0,0 +1,63 @@
+/**
+ * @file lukip_fuzz.h
+ * @brief Header for fuzz tests: their saved inputs, and the coverage-guided fuzzer.
+ * 
+ * @author Larmix
+ */
+
+#ifndef LUKIP_FUZZ_H
+#define LUKIP_FUZZ_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "lukip_assert.h"
+#include "lukip_dynamic_array.h"
+#include "lukip_options.h"
+
+/** Directory (inside of a fuzz test's one) of inputs which reached new edges. */
+#define LKP_CORPUS_DIR "corpus"
+
+/** Directory (inside of a fuzz test's one) of inputs which failed or crashed. */
+#define LKP_CRASHES_DIR "crashes"
+
+/** An input which failed a fuzz test, and the file it's saved in. */
+typedef struct {
+    LkpCaseSink failure;
+    char *path; /** Allocated. */
+} LkpFuzzFailure;
+
+/** Every input that failed a fuzz test. */
+LKP_DECLARE_DA_STRUCT(LkpFuzzFailureArray, LkpFuzzFailure);
+
+/** What came out of running a fuzz test. */
+typedef struct {
+    LkpFuncInfo info; /** Where the first assert was called from. */
+    int asserts;
+    LkpFuzzFailureArray failures;
+} LkpFuzzResult;
+
+/**
+ * @brief Runs a fuzz test on the empty input and every saved one, then fuzzes it in fuzzing builds.
+ * 
+ * The saved inputs are in "<fuzzDir>/<name>/corpus" and "<fuzzDir>/<name>/crashes",
+ * so reproducers of old failures keep running as regression tests in every build.
+ * In builds with LKP_FUZZ, the test is then mutated for new inputs until the time runs out,
+ * where inputs reaching new edges join the corpus and the first failing one becomes a reproducer.
+ * An input which runs for longer than the timeout is skipped by a watchdog and fails.
+ * 
+ * @param target The fuzz test.
+ * @param name The fuzz test's name.
+ * @param options Where the inputs are kept, and how long to fuzz for.
+ * @param timeout How long each input can run for in milliseconds, or 0 for no limit.
+ * @param[out] result The results, which have to be freed with lkp_free_fuzz_result().
+ */
+void lkp_run_fuzz_test(
+    const LkpFuzzFunc target, const char *name, const LkpOptions *options, const int timeout,
+    LkpFuzzResult *result
+);
+
+/** Frees the failures of a fuzz test's result. */
+void lkp_free_fuzz_result(LkpFuzzResult *result);
+
+#endif
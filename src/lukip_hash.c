@@ -0,0 +1,116 @@
+/**
+ * @file lukip_hash.c
+ * @brief Hashes files with 64-bit FNV-1a to tell whether a test's inputs changed.
+ * 
+ * @author Larmix
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "lukip_hash.h"
+
+#define FNV_OFFSET 14695981039346656037ULL /** Starting value of an FNV-1a hash. */
+#define FNV_PRIME 1099511628211ULL /** What an FNV-1a hash is multiplied by after every byte. */
+
+/** Amount of bytes read from a file at once when hashing it. */
+#define READ_CHUNK 8192
+
+/** A file's path and the hash of its contents. */
+typedef struct {
+    char *path;
+    uint64_t hash;
+} FileHash;
+
+/** Every file that was already hashed, since many tests share the same files. */
+LKP_DECLARE_DA_STRUCT(FileHashArray, FileHash);
+
+static FileHashArray hashes = {.length = 0, .capacity = 0, .data = NULL};
+
+/** Continues an FNV-1a hash over some bytes. */
+static uint64_t hash_bytes(uint64_t hash, const void *bytes, const size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        hash ^= ((const uint8_t *)bytes)[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+/** Hashes bytes from the start of an FNV-1a hash. */
+uint64_t lkp_hash_bytes(const void *bytes, const size_t size) {
+    return hash_bytes(FNV_OFFSET, bytes, size);
+}
+
+/** Reads the whole file in chunks to hash it. */
+static uint64_t hash_file_contents(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return 0;
+    }
+    uint64_t hash = FNV_OFFSET;
+    unsigned char chunk[READ_CHUNK];
+    size_t amount;
+    while ((amount = fread(chunk, 1, READ_CHUNK, file)) > 0) {
+        hash = hash_bytes(hash, chunk, amount);
+    }
+    fclose(file);
+    return hash;
+}
+
+/** Looks the path up in the already hashed files before reading it. */
+uint64_t lkp_hash_file(const char *path) {
+    for (int i = 0; i < hashes.length; i++) {
+        if (strcmp(hashes.data[i].path, path) == 0) {
+            return hashes.data[i].hash;
+        }
+    }
+    const size_t length = strlen(path) + 1;
+    FileHash fileHash = {.path = lkp_allocate((int)length, sizeof(char)), .hash = 0};
+    memcpy(fileHash.path, path, length);
+    fileHash.hash = hash_file_contents(path);
+    LKP_APPEND_DA(&hashes, fileHash);
+    return fileHash.hash;
+}
+
+/**
+ * @brief Continues a hash with the hash of a file's contents.
+ * 
+ * @param[out] hash The hash to continue.
+ * @param path The file.
+ * 
+ * @return Whether the file could be read, since a missing input can't be known to be unchanged.
+ */
+static bool hash_input(uint64_t *hash, const char *path) {
+    const uint64_t fileHash = lkp_hash_file(path);
+    *hash = hash_bytes(*hash, &fileHash, sizeof(fileHash));
+    return fileHash != 0;
+}
+
+/** Hashes the hashes of every input in order, so that swapping files changes the result. */
+uint64_t lkp_hash_test_inputs(const char *sourcePath, const LkpDependencies *dependencies) {
+    uint64_t hash = FNV_OFFSET;
+    bool readAll = hash_input(&hash, sourcePath);
+
+    const size_t length = strlen(sourcePath);
+    if (length > 2 && strcmp(sourcePath + length - 2, ".c") == 0) {
+        char *objectPath = lkp_allocate((int)length + 1, sizeof(char));
+        memcpy(objectPath, sourcePath, length + 1);
+        objectPath[length - 1] = 'o';
+        readAll = hash_input(&hash, objectPath) && readAll;
+        free(objectPath);
+    }
+    for (int i = 0; i < dependencies->length; i++) {
+        readAll = hash_input(&hash, dependencies->data[i]) && readAll;
+    }
+    return readAll && hash != 0 ? hash : 0;
+}
+
+/** Frees every remembered path. */
+void lkp_free_hashes() {
+    for (int i = 0; i < hashes.length; i++) {
+        free(hashes.data[i].path);
+    }
+    LKP_FREE_DA(&hashes);
+    LKP_INIT_DA(&hashes);
+}
@@ -0,0 +1,55 @@
+/**
+ * @file lukip_hash.h
+ * @brief Header for hashing the files a test's results depend on.
+ * 
+ * @author Larmix
+ */
+
+#ifndef LUKIP_HASH_H
+#define LUKIP_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lukip_dynamic_array.h"
+
+/** Paths of extra files (like object files) every test depends on. */
+LKP_DECLARE_DA_STRUCT(LkpDependencies, const char *);
+
+/**
+ * @brief Hashes some bytes in memory, which is safe to call from a signal handler.
+ * 
+ * @param bytes The bytes to hash.
+ * @param size How many bytes there are.
+ * 
+ * @return The bytes' hash.
+ */
+uint64_t lkp_hash_bytes(const void *bytes, const size_t size);
+
+/**
+ * @brief Hashes the contents of a file, remembering it for later calls with the same path.
+ * 
+ * @param path The file to hash.
+ * 
+ * @return The file's hash, or 0 if it couldn't be read.
+ */
+uint64_t lkp_hash_file(const char *path);
+
+/**
+ * @brief Hashes everything a test defined in a certain source file depends on.
+ * 
+ * That's the source file itself, its object file next to it (if it's a ".c" file),
+ * and every extra dependency. Not the executable, which any rebuild changes for every test.
+ * 
+ * @param sourcePath The translation unit which defines the test.
+ * @param dependencies Extra files every test depends on.
+ * 
+ * @return The combined hash of all of them, or 0 if any of them couldn't be read
+ *     (like when running from another directory), which never counts as unchanged.
+ */
+uint64_t lkp_hash_test_inputs(const char *sourcePath, const LkpDependencies *dependencies);
+
+/** Forgets every remembered file hash. */
+void lkp_free_hashes();
+
+#endif
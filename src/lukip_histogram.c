@@ -0,0 +1,144 @@
+/**
+ * @file lukip_histogram.c
+ * @brief Log-linear histograms, recorded in constant time.
+ * 
+ * @author Larmix
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "lukip_allocator.h"
+#include "lukip_histogram.h"
+
+/** Buckets in each power of two past the exact ones. */
+#define HALF (LKP_HISTOGRAM_EXACT / 2)
+
+/** The largest value that still gets its own bucket. */
+#define MAX_TRACKED ((1LL << LKP_HISTOGRAM_MAX_BITS) - 1)
+
+/** Percentiles shown in the distribution, between its minimum and maximum. */
+static const double shownPercentiles[] = {50, 90, 99, 99.9};
+
+/** Returns the index of the highest set bit of a value, which has to be above 0. */
+static int highest_bit(const unsigned long long value) {
+#if defined(__GNUC__)
+    return 63 - __builtin_clzll(value);
+#else
+    int bit = 0;
+    while (value >> (bit + 1)) {
+        bit++;
+    }
+    return bit;
+#endif
+}
+
+/** Returns the bucket a value is counted in. */
+static int bucket_of(const long long value) {
+    if (value < LKP_HISTOGRAM_EXACT) {
+        return (int)value;
+    }
+    const int bit = highest_bit(value);
+    const int step = (int)(value >> (bit - (LKP_HISTOGRAM_EXACT_BITS - 1))) - HALF;
+    return LKP_HISTOGRAM_EXACT + (bit - LKP_HISTOGRAM_EXACT_BITS) * HALF + step;
+}
+
+/** Returns the highest value counted in a bucket. */
+static long long bucket_highest(const int bucket) {
+    if (bucket < LKP_HISTOGRAM_EXACT) {
+        return bucket;
+    }
+    const int shift = (bucket - LKP_HISTOGRAM_EXACT) / HALF + 1;
+    return lkp_bucket_lowest(bucket) + (1LL << shift) - 1;
+}
+
+/** Starts with no values, where min and max get set by the first one. */
+void lkp_init_histogram(LkpHistogram *histogram) {
+    memset(histogram->counts, 0, sizeof(histogram->counts));
+    histogram->total = 0;
+    histogram->min = 0;
+    histogram->max = 0;
+}
+
+/** Clamps the value to what the buckets cover, but keeps it exact in the min and max. */
+void lkp_record_value(LkpHistogram *histogram, long long value) {
+    if (value < 0) {
+        value = 0;
+    }
+    if (histogram->total == 0 || value < histogram->min) {
+        histogram->min = value;
+    }
+    if (histogram->total == 0 || value > histogram->max) {
+        histogram->max = value;
+    }
+    histogram->counts[bucket_of(value < MAX_TRACKED ? value : MAX_TRACKED)]++;
+    histogram->total++;
+}
+
+/** Adds the counts bucket by bucket. */
+void lkp_merge_histogram(LkpHistogram *into, const LkpHistogram *from) {
+    if (from->total == 0) {
+        return;
+    }
+    if (into->total == 0 || from->min < into->min) {
+        into->min = from->min;
+    }
+    if (into->total == 0 || from->max > into->max) {
+        into->max = from->max;
+    }
+    for (int i = 0; i < LKP_HISTOGRAM_BUCKETS; i++) {
+        into->counts[i] += from->counts[i];
+    }
+    into->total += from->total;
+}
+
+/** Walks the buckets up to the nearest rank, where the last one may hold larger values. */
+long long lkp_histogram_percentile(const LkpHistogram *histogram, const double percentile) {
+    long long rank = (long long)(percentile / 100 * histogram->total + 0.999999);
+    if (rank < 1) {
+        rank = 1;
+    } else if (rank > histogram->total) {
+        rank = histogram->total;
+    }
+    long long seen = 0;
+    for (int i = 0; i < LKP_HISTOGRAM_BUCKETS; i++) {
+        seen += histogram->counts[i];
+        if (seen >= rank && i < LKP_HISTOGRAM_BUCKETS - 1) {
+            const long long highest = bucket_highest(i);
+            if (highest < histogram->min) {
+                return histogram->min;
+            }
+            return highest < histogram->max ? highest : histogram->max;
+        }
+    }
+    return histogram->max;
+}
+
+/** The exact buckets are their own value, the others start at their power of two plus a step. */
+long long lkp_bucket_lowest(const int bucket) {
+    if (bucket < LKP_HISTOGRAM_EXACT) {
+        return bucket;
+    }
+    const int shift = (bucket - LKP_HISTOGRAM_EXACT) / HALF + 1;
+    return (long long)(HALF + (bucket - LKP_HISTOGRAM_EXACT) % HALF) << shift;
+}
+
+/** Shows the minimum, the usual percentiles and the maximum, along with the amount of values. */
+char *lkp_describe_histogram(const LkpHistogram *histogram) {
+    char description[256];
+    int length = snprintf(description, sizeof(description), "min %lld", histogram->min);
+    for (size_t i = 0; i < sizeof(shownPercentiles) / sizeof(shownPercentiles[0]); i++) {
+        length += snprintf(
+            description + length, sizeof(description) - length, ", p%g %lld", shownPercentiles[i],
+            lkp_histogram_percentile(histogram, shownPercentiles[i])
+        );
+    }
+    snprintf(
+        description + length, sizeof(description) - length, ", max %lld ns over %lld runs",
+        histogram->max, histogram->total
+    );
+    const size_t size = strlen(description) + 1;
+    char *allocated = lkp_allocate((int)size, sizeof(char));
+    memcpy(allocated, description, size);
+    return allocated;
+}
@@ -0,0 +1,75 @@
+/**
+ * @file lukip_histogram.h
+ * @brief Header for fixed-size, log-linear histograms of durations.
+ * 
+ * Values below LKP_HISTOGRAM_EXACT get a bucket each. Every power of two above that is split
+ * into LKP_HISTOGRAM_EXACT / 2 equal buckets, so a bucket is never wider than about 1.6%
+ * of the values in it, no matter how many values get recorded or how far apart they are.
+ * 
+ * @author Larmix
+ */
+
+#ifndef LUKIP_HISTOGRAM_H
+#define LUKIP_HISTOGRAM_H
+
+#include <stdbool.h>
+
+/** Bits of the values which are recorded exactly, which is also how precise the others are. */
+#define LKP_HISTOGRAM_EXACT_BITS 7
+
+/** Amount of values (from 0) which are recorded exactly. */
+#define LKP_HISTOGRAM_EXACT (1 << LKP_HISTOGRAM_EXACT_BITS)
+
+/** Values are tracked up to 2 to the power of this (about 18 minutes in nanoseconds). */
+#define LKP_HISTOGRAM_MAX_BITS 40
+
+/** The exact buckets, then half as many for each power of two above them. */
+#define LKP_HISTOGRAM_BUCKETS \
+    (LKP_HISTOGRAM_EXACT \
+        + (LKP_HISTOGRAM_MAX_BITS - LKP_HISTOGRAM_EXACT_BITS) * (LKP_HISTOGRAM_EXACT / 2))
+
+/**
+ * @brief Counts of recorded values by their bucket.
+ * 
+ * Recording is a couple of shifts and an increment, and never allocates.
+ * It's not atomic though, so threads record into their own histograms and merge them afterwards.
+ */
+typedef struct {
+    long long counts[LKP_HISTOGRAM_BUCKETS];
+    long long total; /** How many values were recorded. */
+    long long min; /** The smallest recorded value exactly. */
+    long long max; /** The largest recorded value exactly. */
+} LkpHistogram;
+
+/** Empties a histogram. */
+void lkp_init_histogram(LkpHistogram *histogram);
+
+/** Records a value, where negative values count as 0 and ones that are too large as the largest. */
+void lkp_record_value(LkpHistogram *histogram, long long value);
+
+/** Adds every value of a histogram to another one. */
+void lkp_merge_histogram(LkpHistogram *into, const LkpHistogram *from);
+
+/**
+ * @brief Returns the value at a percentile of a histogram.
+ * 
+ * @param histogram The histogram, which has to have at least one value.
+ * @param percentile From 0 to 100, like 99 for p99 (nearest rank).
+ * 
+ * @return The highest value in the percentile's bucket, but never past the recorded max.
+ */
+long long lkp_histogram_percentile(const LkpHistogram *histogram, const double percentile);
+
+/** Returns the lowest value which is recorded into a bucket. */
+long long lkp_bucket_lowest(const int bucket);
+
+/**
+ * @brief Describes the distribution of a histogram, like "min 40, p50 52, ... max 900 ns".
+ * 
+ * @param histogram The histogram, which has to have at least one value.
+ * 
+ * @return The description, allocated.
+ */
+char *lkp_describe_histogram(const LkpHistogram *histogram);
+
+#endif
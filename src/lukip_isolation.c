@@ -0,0 +1,535 @@
+/**
+ * @file lukip_isolation.c
+ * @brief Runs tests in forked processes and sends their results back to the parent.
+ * 
+ * @author Larmix
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "lukip_allocator.h"
+#include "lukip_dynamic_array.h"
+#include "lukip_isolation.h"
+#include "lukip_platform.h"
+
+#ifdef LKP_POSIX
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+/** Amount of bytes read from a child's pipe at once. */
+#define READ_CHUNK 4096
+/** Milliseconds between checks of whether a child whose pipe is still open already exited. */
+#define EXIT_CHECK_MS 100
+
+/** Dynamically growable bytes which a child's results are read into. */
+LKP_DECLARE_DA_STRUCT(ByteArray, char);
+
+/** The fixed size part of a child's results, which is followed by its messages. */
+typedef struct {
+    LkpFuncInfo info;
+    LkpUsage usage;
+    int asserts;
+    int failedAsserts;
+    int failures;
+    int warnings;
+    int latencies; /** Every latency record of the test, which replace the parent's. */
+    LkpScaling scaling; /** A benchmark's fit, whose points follow (the pointer is the child's). */
+} ResultHeader;
+
+static bool isChild = false; /** Whether we're a forked test process. */
+
+/** Reads LKP_ISOLATE_ENV. */
+bool lkp_env_isolation() {
+    const char *value = getenv(LKP_ISOLATE_ENV);
+    return value != NULL && strcmp(value, "1") == 0;
+}
+
+/** Returns whether we're in a forked test. */
+bool lkp_in_child() {
+    return isChild;
+}
+
+#ifdef LKP_POSIX
+
+/** Writes all the passed bytes, retrying on partial writes and interrupts. */
+static bool write_all(const int fd, const void *data, const size_t size) {
+    size_t written = 0;
+    while (written < size) {
+        const ssize_t result = write(fd, (const char *)data + written, size - written);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            return false;
+        }
+        written += result;
+    }
+    return true;
+}
+
+/** Writes a message's length followed by its characters (without the NUL). */
+static void write_message(const int fd, const char *message) {
+    const int length = strlen(message);
+    write_all(fd, &length, sizeof(length));
+    write_all(fd, message, length);
+}
+
+/**
+ * @brief Sends the results of the unit's last test to the parent.
+ * 
+ * @param fd The write end of the pipe to the parent.
+ * @param lukip The child's unit.
+ * @param before The parent's unit as it was when we forked, to only send what's new.
+ * @param failuresBefore How many failures the test had when we forked (from its earlier runs),
+ *     since its array is shared with before and the parent already has those.
+ */
+static void write_results(
+    const int fd, const LukipUnit *lukip, const LukipUnit *before, const int failuresBefore
+) {
+    const LkpTestFunc *test = &lukip->tests.data[lukip->tests.length - 1];
+    ResultHeader header = {
+        .info = test->info, .usage = test->usage, .asserts = lukip->asserts - before->asserts,
+        .failedAsserts = lukip->failedAsserts - before->failedAsserts,
+        .failures = test->failures.length - failuresBefore,
+        .warnings = lukip->warnings.length - before->warnings.length,
+        .latencies = test->latencies.length, .scaling = test->scaling
+    };
+    write_all(fd, &header, sizeof(header));
+
+    for (int i = failuresBefore; i < test->failures.length; i++) {
+        write_all(fd, &test->failures.data[i].line, sizeof(test->failures.data[i].line));
+        write_message(fd, test->failures.data[i].message);
+    }
+    for (int i = before->warnings.length; i < lukip->warnings.length; i++) {
+        write_all(fd, &lukip->warnings.data[i].location, sizeof(lukip->warnings.data[i].location));
+        write_message(fd, lukip->warnings.data[i].message);
+    }
+    for (int i = 0; i < test->latencies.length; i++) {
+        const LkpLatencyRecord *record = &test->latencies.data[i];
+        write_all(fd, &record->statement, sizeof(record->statement));
+        write_all(fd, &record->line, sizeof(record->line));
+        write_all(fd, record->histogram, sizeof(*record->histogram));
+    }
+    write_all(fd, test->scaling.points.data, test->scaling.points.length * sizeof(LkpBenchPoint));
+}
+
+/** Returns the milliseconds left until the deadline (never below 0). */
+static int remaining_ms(const struct timespec *deadline) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    const long long left = (deadline->tv_sec - now.tv_sec) * 1000LL
+        + (deadline->tv_nsec - now.tv_nsec) / 1000000LL;
+    return left > 0 ? (int)left : 0;
+}
+
+/** Returns whether the child exited, leaving it to be reaped by the waitpid() after reading. */
+static bool child_exited(const pid_t pid) {
+    siginfo_t info;
+    info.si_pid = 0;
+    return waitid(P_PID, (id_t)pid, &info, WEXITED | WNOHANG | WNOWAIT) == 0 && info.si_pid == pid;
+}
+
+/**
+ * @brief Reads everything the child sends until it closes the pipe or runs out of time.
+ * 
+ * Grandchildren the test spawned can inherit the pipe and keep it open after the child exited,
+ * so once the child is gone only what it already sent is read.
+ * 
+ * @param fd The read end of the pipe.
+ * @param pid The child writing into the pipe.
+ * @param[out] bytes Where the read bytes are appended.
+ * @param timeout Milliseconds to wait for, or 0 to wait forever.
+ * 
+ * @return False if the timeout passed before the child finished.
+ */
+static bool read_until_closed(const int fd, const pid_t pid, ByteArray *bytes, const int timeout) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeout / 1000;
+    deadline.tv_nsec += (timeout % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    char chunk[READ_CHUNK];
+    bool exited = false;
+    while (true) {
+        struct pollfd pollFd = {.fd = fd, .events = POLLIN};
+        int waitFor = timeout > 0 ? remaining_ms(&deadline) : EXIT_CHECK_MS;
+        if (exited) {
+            waitFor = 0;
+        } else if (waitFor > EXIT_CHECK_MS) {
+            waitFor = EXIT_CHECK_MS;
+        }
+        const int ready = poll(&pollFd, 1, waitFor);
+        if (ready < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ready == 0) {
+            if (exited) {
+                return true;
+            }
+            if (timeout > 0 && remaining_ms(&deadline) == 0) {
+                return false;
+            }
+            exited = child_exited(pid);
+            continue;
+        }
+        const ssize_t amount = read(fd, chunk, READ_CHUNK);
+        if (amount < 0 && errno == EINTR) {
+            continue;
+        }
+        if (amount <= 0) {
+            return true;
+        }
+        for (ssize_t i = 0; i < amount; i++) {
+            LKP_APPEND_DA(bytes, chunk[i]);
+        }
+    }
+}
+
+/** Copies the next size bytes out of the read results, returning false if there aren't enough. */
+static bool take_bytes(const ByteArray *bytes, int *cursor, void *out, const int size) {
+    if (*cursor + size > bytes->length) {
+        return false;
+    }
+    memcpy(out, bytes->data + *cursor, size);
+    *cursor += size;
+    return true;
+}
+
+/** Allocates the next message out of the read results, or returns NULL if it's cut off. */
+static char *take_message(const ByteArray *bytes, int *cursor) {
+    int length;
+    if (!take_bytes(bytes, cursor, &length, sizeof(length))) {
+        return NULL;
+    }
+    if (length < 0 || *cursor + length > bytes->length) {
+        return NULL;
+    }
+    char *message = lkp_allocate(length + 1, sizeof(char));
+    take_bytes(bytes, cursor, message, length);
+    message[length] = '\0';
+    return message;
+}
+
+/**
+ * @brief Merges the results a child sent into the parent's last test.
+ * 
+ * @return False if the results were incomplete (the child died while sending them).
+ */
+static bool merge_results(const ByteArray *bytes, LukipUnit *lukip) {
+    int cursor = 0;
+    ResultHeader header;
+    if (!take_bytes(bytes, &cursor, &header, sizeof(header))) {
+        return false;
+    }
+    LkpTestFunc *test = &lukip->tests.data[lukip->tests.length - 1];
+    test->info = header.info;
+    test->usage = header.usage;
+    lukip->asserts += header.asserts;
+    lukip->failedAsserts += header.failedAsserts;
+    if (header.info.status == LKP_TEST_FAILURE) {
+        lukip->hasFailed = true;
+    }
+
+    for (int i = 0; i < header.failures; i++) {
+        LkpFailure failure;
+        if (!take_bytes(bytes, &cursor, &failure.line, sizeof(failure.line))) {
+            return false;
+        }
+        if ((failure.message = take_message(bytes, &cursor)) == NULL) {
+            return false;
+        }
+        LKP_APPEND_DA(&test->failures, failure);
+    }
+    for (int i = 0; i < header.warnings; i++) {
+        LkpWarning warning;
+        if (!take_bytes(bytes, &cursor, &warning.location, sizeof(warning.location))) {
+            return false;
+        }
+        if ((warning.message = take_message(bytes, &cursor)) == NULL) {
+            return false;
+        }
+        LKP_APPEND_DA(&lukip->warnings, warning);
+    }
+    for (int i = 0; i < test->latencies.length; i++) {
+        free(test->latencies.data[i].histogram);
+    }
+    test->latencies.length = 0;
+    for (int i = 0; i < header.latencies; i++) {
+        LkpLatencyRecord record;
+        if (!take_bytes(bytes, &cursor, &record.statement, sizeof(record.statement))
+                || !take_bytes(bytes, &cursor, &record.line, sizeof(record.line))) {
+            return false;
+        }
+        record.histogram = lkp_allocate(1, sizeof(LkpHistogram));
+        if (!take_bytes(bytes, &cursor, record.histogram, sizeof(*record.histogram))) {
+            free(record.histogram);
+            return false;
+        }
+        LKP_APPEND_DA(&test->latencies, record);
+    }
+    LKP_FREE_DA(&test->scaling.points);
+    test->scaling = header.scaling;
+    LKP_INIT_DA(&test->scaling.points);
+    for (int i = 0; i < header.scaling.points.length; i++) {
+        LkpBenchPoint point;
+        if (!take_bytes(bytes, &cursor, &point, sizeof(point))) {
+            return false;
+        }
+        LKP_APPEND_DA(&test->scaling.points, point);
+    }
+    return true;
+}
+
+/** Runs the test in the freshly forked child, sends the results and exits without cleanups. */
+static void run_child(const int fd, LukipUnit *lukip, const LkpTestRunner runner) {
+    isChild = true;
+    const LukipUnit before = *lukip;
+    const int failuresBefore = lukip->tests.data[lukip->tests.length - 1].failures.length;
+    runner();
+    write_results(fd, lukip, &before, failuresBefore);
+    close(fd);
+
+    // Skip atexit() handlers, or the child would print the whole report too.
+    fflush(stdout);
+    fflush(stderr);
+    _exit(0);
+}
+
+/** Forks the test, waits for it to send its results (or time out), then reaps it. */
+LkpChildResult lkp_run_in_child(LukipUnit *lukip, const LkpTestRunner runner, const int timeout) {
+    LkpChildResult result = {.outcome = LKP_CHILD_UNSUPPORTED, .code = 0};
+    int fds[2];
+    if (pipe(fds) != 0) {
+        return result;
+    }
+    // Don't let the child inherit (and later print again) output that's still buffered.
+    fflush(stdout);
+    fflush(stderr);
+    const pid_t pid = fork();
+    if (pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return result;
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        run_child(fds[1], lukip, runner);
+    }
+    close(fds[1]);
+
+    ByteArray bytes;
+    LKP_INIT_DA(&bytes);
+    const bool finished = read_until_closed(fds[0], pid, &bytes, timeout);
+    close(fds[0]);
+    if (!finished) {
+        kill(pid, SIGKILL);
+    }
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+    }
+
+    const bool merged = merge_results(&bytes, lukip);
+    LKP_FREE_DA(&bytes);
+    if (!finished) {
+        result.outcome = LKP_CHILD_TIMED_OUT;
+    } else if (WIFSIGNALED(status)) {
+        result.outcome = LKP_CHILD_CRASHED;
+        result.code = WTERMSIG(status);
+    } else if (!merged || WEXITSTATUS(status) != 0) {
+        result.outcome = LKP_CHILD_EXITED;
+        result.code = WEXITSTATUS(status);
+    } else {
+        result.outcome = LKP_CHILD_FINISHED;
+    }
+    return result;
+}
+
+/** Runs the trial in a child whose output goes nowhere, and turns its exit status into a result. */
+LkpChildResult lkp_run_trial(const LkpTrialFunc trial, void *context) {
+    LkpChildResult result = {.outcome = LKP_CHILD_UNSUPPORTED, .code = 0};
+    fflush(stdout);
+    fflush(stderr);
+    const pid_t pid = fork();
+    if (pid < 0) {
+        return result;
+    }
+    if (pid == 0) {
+        isChild = true;
+        const int devNull = open("/dev/null", O_WRONLY);
+        if (devNull != -1) {
+            dup2(devNull, STDOUT_FILENO);
+            dup2(devNull, STDERR_FILENO);
+            close(devNull);
+        }
+        const bool failed = trial(context);
+        fflush(stdout);
+        fflush(stderr);
+        _exit(failed ? 1 : 0);
+    }
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+    }
+    if (WIFSIGNALED(status)) {
+        result.outcome = LKP_CHILD_CRASHED;
+        result.code = WTERMSIG(status);
+    } else if (WEXITSTATUS(status) != 0) {
+        result.outcome = LKP_CHILD_EXITED;
+        result.code = WEXITSTATUS(status);
+    } else {
+        result.outcome = LKP_CHILD_FINISHED;
+    }
+    return result;
+}
+
+/** Signals that kill a death test's child, even if the parent handles them. */
+static const int deathSignals[] = {SIGABRT, SIGSEGV, SIGBUS, SIGFPE, SIGILL};
+
+/** Forks the statement of a death test, sending its stderr (and whether it survived) back. */
+bool lkp_fork_death_child(LkpDeathChild *child) {
+    child->pid = -1;
+    child->error = 0;
+    int outputFds[2], survivedFds[2];
+    if (pipe(outputFds) != 0) {
+        child->error = errno;
+        return false;
+    }
+    if (pipe(survivedFds) != 0) {
+        child->error = errno;
+        close(outputFds[0]);
+        close(outputFds[1]);
+        return false;
+    }
+    fflush(stdout);
+    fflush(stderr);
+    const pid_t pid = fork();
+    if (pid == 0) {
+        isChild = true;
+        close(outputFds[0]);
+        close(survivedFds[0]);
+        dup2(outputFds[1], STDERR_FILENO);
+        close(outputFds[1]);
+        child->survived = survivedFds[1];
+        const struct rlimit noCores = {.rlim_cur = 0, .rlim_max = 0};
+        setrlimit(RLIMIT_CORE, &noCores);
+        for (size_t i = 0; i < sizeof(deathSignals) / sizeof(deathSignals[0]); i++) {
+            signal(deathSignals[i], SIG_DFL);
+        }
+        return true;
+    }
+    if (pid < 0) {
+        child->error = errno;
+    }
+    close(outputFds[1]);
+    close(survivedFds[1]);
+    if (pid < 0) {
+        close(outputFds[0]);
+        close(survivedFds[0]);
+        return false;
+    }
+    child->pid = pid;
+    child->output = outputFds[0];
+    child->survived = survivedFds[0];
+    return false;
+}
+
+/** Tells the parent the statement finished, then exits without cleanups. */
+void lkp_survive_death(LkpDeathChild *child) {
+    write_all(child->survived, "", 1);
+    fflush(stdout);
+    fflush(stderr);
+    _exit(0);
+}
+
+/** Reads the child's stderr until it ends, then reaps it. */
+LkpDeathResult lkp_wait_for_death(LkpDeathChild *child) {
+    LkpDeathResult result = {.outcome = LKP_DEATH_FORK_FAILED, .code = child->error};
+    ByteArray bytes;
+    LKP_INIT_DA(&bytes);
+    if (child->pid < 0) {
+        LKP_APPEND_DA(&bytes, '\0');
+        result.output = bytes.data;
+        return result;
+    }
+    const bool finished = read_until_closed(child->output, child->pid, &bytes, LKP_DEATH_TIMEOUT);
+    LKP_APPEND_DA(&bytes, '\0');
+    result.output = bytes.data;
+    if (!finished) {
+        kill(child->pid, SIGKILL);
+    }
+    int status = 0;
+    while (waitpid(child->pid, &status, 0) < 0 && errno == EINTR) {
+    }
+    // A grandchild may still hold the write end, so only take what's already there.
+    struct pollfd survivedPoll = {.fd = child->survived, .events = POLLIN};
+    char survived;
+    const bool finishedStatement = poll(&survivedPoll, 1, 0) == 1
+        && read(child->survived, &survived, 1) == 1;
+    close(child->output);
+    close(child->survived);
+
+    if (!finished) {
+        result.outcome = LKP_DEATH_TIMED_OUT;
+    } else if (finishedStatement) {
+        result.outcome = LKP_DEATH_SURVIVED;
+    } else if (WIFSIGNALED(status)) {
+        result.outcome = LKP_DEATH_SIGNALED;
+        result.code = WTERMSIG(status);
+    } else {
+        result.outcome = LKP_DEATH_EXITED;
+        result.code = WEXITSTATUS(status);
+    }
+    return result;
+}
+
+#else
+
+/** Forking isn't available, so there's nowhere to run trials. */
+LkpChildResult lkp_run_trial(const LkpTrialFunc trial, void *context) {
+    (void)trial;
+    (void)context;
+    LkpChildResult result = {.outcome = LKP_CHILD_UNSUPPORTED, .code = 0};
+    return result;
+}
+
+/** Forking isn't available, so death tests can't run. */
+bool lkp_fork_death_child(LkpDeathChild *child) {
+    child->pid = -1;
+    child->error = 0;
+    return false;
+}
+
+/** Never called, since there's never a child. */
+void lkp_survive_death(LkpDeathChild *child) {
+    (void)child;
+}
+
+/** There's never a child to wait for. */
+LkpDeathResult lkp_wait_for_death(LkpDeathChild *child) {
+    (void)child;
+    LkpDeathResult result = {.outcome = LKP_DEATH_UNSUPPORTED, .code = 0, .output = NULL};
+    result.output = lkp_allocate(1, sizeof(char));
+    result.output[0] = '\0';
+    return result;
+}
+
+/** Forking isn't available, so the caller has to run the test in-process. */
+LkpChildResult lkp_run_in_child(LukipUnit *lukip, const LkpTestRunner runner, const int timeout) {
+    (void)lukip;
+    (void)runner;
+    (void)timeout;
+    LkpChildResult result = {.outcome = LKP_CHILD_UNSUPPORTED, .code = 0};
+    return result;
+}
+
+#endif
@@ -0,0 +1,121 @@
+/**
+ * @file lukip_isolation.h
+ * @brief Header for running tests in their own forked process.
+ * 
+ * @author Larmix
+ */
+
+#ifndef LUKIP_ISOLATION_H
+#define LUKIP_ISOLATION_H
+
+#include "lukip_assert.h"
+
+/** Environment variable which turns isolation on for every test when set to 1. */
+#define LKP_ISOLATE_ENV "LUKIP_ISOLATE"
+
+/** How a forked test's process ended. */
+typedef enum {
+    LKP_CHILD_FINISHED, /** Ran to the end and sent back its results. */
+    LKP_CHILD_CRASHED, /** Got killed by a signal. */
+    LKP_CHILD_EXITED, /** Exited on its own before it could send back its results. */
+    LKP_CHILD_TIMED_OUT, /** Ran for too long, so it got killed. */
+    LKP_CHILD_UNSUPPORTED /** Couldn't fork at all (non-POSIX systems or fork() failing). */
+} LkpChildOutcome;
+
+/** The outcome of a forked test, with the signal or exit status if there's one. */
+typedef struct {
+    LkpChildOutcome outcome;
+    int code;
+} LkpChildResult;
+
+/** Milliseconds a death test's statement gets to die in before it's killed. */
+#define LKP_DEATH_TIMEOUT 10000
+
+/** How a death test's statement ended. */
+typedef enum {
+    LKP_DEATH_SURVIVED, /** Finished without dying. */
+    LKP_DEATH_EXITED, /** Called exit() (or returned from main() some other way). */
+    LKP_DEATH_SIGNALED, /** Got killed by a signal, like SIGABRT from abort(). */
+    LKP_DEATH_TIMED_OUT, /** Didn't end within LKP_DEATH_TIMEOUT, so it got killed. */
+    LKP_DEATH_FORK_FAILED, /** pipe() or fork() failed, with the errno as the code. */
+    LKP_DEATH_UNSUPPORTED /** Forking isn't available on this platform at all. */
+} LkpDeathOutcome;
+
+/** The outcome of a death test, with what it wrote to stderr. */
+typedef struct {
+    LkpDeathOutcome outcome;
+    int code; /** The exit status or signal. */
+    char *output; /** Everything it wrote to stderr, NUL terminated and allocated. */
+} LkpDeathResult;
+
+/** Runs the last test's setup, body, and teardown in the current process. */
+typedef void (*LkpTestRunner)();
+
+/** Runs some tests in a forked child, returning whether they failed. */
+typedef bool (*LkpTrialFunc)(void *context);
+
+/**
+ * @brief Reads whether isolation was turned on from the environment.
+ * 
+ * @return Whether LKP_ISOLATE_ENV is set to 1.
+ */
+bool lkp_env_isolation();
+
+/**
+ * @brief Returns whether this is a forked test process rather than the main one.
+ * 
+ * @return True inside of a child, false in the main process.
+ */
+bool lkp_in_child();
+
+/**
+ * @brief Forks and runs a test in the child, then merges its results into the parent.
+ * 
+ * The child inherits everything the parent built so far (copy-on-write), records
+ * its asserts as usual in its own copy of the unit, and sends the current test's results
+ * back through a pipe. They're then merged into the last test of the parent's unit.
+ * 
+ * @param lukip The unit whose last test is the one being run.
+ * @param runner What the child calls to run the test.
+ * @param timeout Milliseconds before the child gets killed, or 0 for no timeout.
+ * 
+ * @return How the child ended.
+ */
+LkpChildResult lkp_run_in_child(LukipUnit *lukip, const LkpTestRunner runner, const int timeout);
+
+/**
+ * @brief Forks a trial run of some tests, whose output is thrown away.
+ * 
+ * Unlike lkp_run_in_child(), nothing gets merged into the parent's unit,
+ * so the parent can try the same tests again in other orders.
+ * 
+ * @param trial What the child runs.
+ * @param context Passed on to the trial.
+ * 
+ * @return LKP_CHILD_FINISHED if the trial passed, LKP_CHILD_EXITED with a status of 1
+ * if it failed, or however else the child ended.
+ */
+LkpChildResult lkp_run_trial(const LkpTrialFunc trial, void *context);
+
+/**
+ * @brief Forks a death test, whose statement runs in the child.
+ * 
+ * The child's stderr goes to the parent, it never writes core dumps, and crashes kill it
+ * like they would without Lukip. It's also marked as a child, so calling exit() skips the report.
+ * 
+ * @param[out] child The child, to be passed on to lkp_wait_for_death() in the parent.
+ * 
+ * @return True in the child, and false in the parent (or if the fork failed).
+ */
+bool lkp_fork_death_child(LkpDeathChild *child);
+
+/**
+ * @brief Waits for a death test's child to end, killing it if it takes too long.
+ * 
+ * @param child The child, or one whose fork failed.
+ * 
+ * @return How it ended, whose output has to be freed.
+ */
+LkpDeathResult lkp_wait_for_death(LkpDeathChild *child);
+
+#endif
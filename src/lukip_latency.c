@@ -0,0 +1,94 @@
+/**
+ * @file lukip_latency.c
+ * @brief Times statements run by run on the real monotonic clock.
+ *
+ * @author Larmix
+ */
+
+#include <stdlib.h>
+
+#include "lukip_allocator.h"
+#include "lukip_clock.h"
+#include "lukip_latency.h"
+#include "lukip_parallel.h"
+
+/** Back to back clock reads used to find how long reading it takes. */
+#define CALIBRATION_READS 64
+
+/** One thread of a stress run, which only ever touches its own timing. */
+typedef struct {
+    LkpLatency latency;
+    LkpStressFunc operation;
+    void *context;
+    int thread;
+} StressWorker;
+
+/** The overhead is the smallest gap between two reads, since anything above it was noise. */
+void lkp_begin_latency(LkpLatency *latency, const int iterations) {
+    latency->iterations = iterations > 0 ? iterations : 1;
+    latency->warmup = latency->iterations / LKP_WARMUP_DIVISOR;
+    if (latency->warmup == 0) {
+        latency->warmup = 1;
+    }
+    lkp_init_histogram(&latency->histogram);
+    latency->run = 0;
+    latency->start = 0;
+    latency->deadline = 0;
+
+    long long previous = lkp_monotonic_ns();
+    latency->overhead = -1;
+    for (int i = 0; i < CALIBRATION_READS; i++) {
+        const long long now = lkp_monotonic_ns();
+        if (latency->overhead == -1 || now - previous < latency->overhead) {
+            latency->overhead = now - previous;
+        }
+        previous = now;
+    }
+}
+
+/** Warmup runs are timed like the others, but never recorded. The deadline reuses their end. */
+bool lkp_next_sample(LkpLatency *latency) {
+    const long long end = lkp_monotonic_ns();
+    if (latency->run > latency->warmup) {
+        lkp_record_value(&latency->histogram, end - latency->start - latency->overhead);
+    }
+    if (latency->run == latency->warmup + latency->iterations
+            || (latency->deadline != 0 && end >= latency->deadline)) {
+        return false;
+    }
+    latency->run++;
+    latency->start = lkp_monotonic_ns();
+    return true;
+}
+
+/** Runs a worker's share of the stress run, recording into its own histogram. */
+static void *run_stress_worker(void *worker) {
+    StressWorker *stress = worker;
+    while (lkp_next_sample(&stress->latency)) {
+        stress->operation(stress->context, stress->thread);
+    }
+    return NULL;
+}
+
+/** Workers are all prepared up front, so the ones whose thread couldn't start merge as empty. */
+void lkp_stress_latency(
+    const LkpStressFunc operation, void *context, const int threads, const int iterations,
+    const long long deadline, LkpHistogram *merged
+) {
+    const int amount = threads > 0 ? threads : 1;
+    StressWorker *workers = lkp_allocate(amount, sizeof(StressWorker));
+    for (int i = 0; i < amount; i++) {
+        lkp_begin_latency(&workers[i].latency, iterations);
+        workers[i].latency.deadline = deadline;
+        workers[i].operation = operation;
+        workers[i].context = context;
+        workers[i].thread = i;
+    }
+    lkp_run_parallel(run_stress_worker, workers, amount, sizeof(StressWorker));
+
+    lkp_init_histogram(merged);
+    for (int i = 0; i < amount; i++) {
+        lkp_merge_histogram(merged, &workers[i].latency.histogram);
+    }
+    free(workers);
+}
@@ -0,0 +1,71 @@
+/**
+ * @file lukip_latency.h
+ * @brief Header for timing a statement many times, for asserts on its latency.
+ * 
+ * @author Larmix
+ */
+
+#ifndef LUKIP_LATENCY_H
+#define LUKIP_LATENCY_H
+
+#include <stdbool.h>
+
+#include "lukip_histogram.h"
+
+/** Untimed warmup runs before the timed ones, as a divisor of the timed ones (at least 1). */
+#define LKP_WARMUP_DIVISOR 10
+
+/** An operation run by every thread of a stress run, given the context and the thread's index. */
+typedef void (*LkpStressFunc)(void *context, const int thread);
+
+/** A statement being timed, run by run. */
+typedef struct {
+    LkpHistogram histogram; /** Nanoseconds of each timed run. */
+    int iterations; /** How many runs are timed. */
+    int warmup; /** How many runs before them aren't. */
+    int run; /** Runs started so far. */
+    long long start; /** When the current run started. */
+    long long overhead; /** Nanoseconds reading the clock takes, taken off of every run. */
+    long long deadline; /** Monotonic nanoseconds after which no more runs start, or 0 for never. */
+} LkpLatency;
+
+/**
+ * @brief Prepares timing a statement, and calibrates the clock's own overhead.
+ * 
+ * @param[out] latency What to time the runs into.
+ * @param iterations How many runs to time (at least 1).
+ */
+void lkp_begin_latency(LkpLatency *latency, const int iterations);
+
+/**
+ * @brief Ends the current run (if there is one) and starts the next one.
+ * 
+ * Meant as the condition of the loop around the statement, so the only thing timed
+ * besides the statement is the loop itself and a clock read.
+ * 
+ * @param latency The timing.
+ * 
+ * @return Whether there's another run, or false after the last one (or past the deadline).
+ */
+bool lkp_next_sample(LkpLatency *latency);
+
+/**
+ * @brief Times an operation on several threads at once, each running it iterations times.
+ * 
+ * Every thread records into its own histogram without any locking,
+ * and they're merged once all of them finished. The operation shouldn't assert,
+ * since asserts only go to the test from the thread running it.
+ * 
+ * @param operation The operation.
+ * @param context Passed to every run of the operation.
+ * @param threads How many threads to run it on (at least 1).
+ * @param iterations How many runs to time on each thread.
+ * @param deadline Monotonic nanoseconds after which the threads stop early, or 0 for never.
+ * @param[out] merged The durations of every thread's runs.
+ */
+void lkp_stress_latency(
+    const LkpStressFunc operation, void *context, const int threads, const int iterations,
+    const long long deadline, LkpHistogram *merged
+);
+
+#endif
@@ -0,0 +1,305 @@
+/**
+ * @file lukip_leaks.c
+ * @brief Snapshots /proc/self to find the resources a test opened and never released.
+ * 
+ * @author Larmix
+ */
+
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lukip_leaks.h"
+
+#ifdef __linux__
+#include <dirent.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+/** How many times to look for leaked threads again before reporting them. */
+#define THREAD_EXIT_TRIES 20
+
+/** Dynamically growable text of the leaks found. */
+LKP_DECLARE_DA_STRUCT(LeakText, char);
+
+/** Appends a formatted string to the text, without its NUL. */
+static void append_text(LeakText *text, const char *format, ...) {
+    char piece[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(piece, sizeof(piece), format, args);
+    va_end(args);
+    for (size_t i = 0; piece[i] != '\0'; i++) {
+        LKP_APPEND_DA(text, piece[i]);
+    }
+}
+
+/** Returns whether the ID is in the array. */
+static bool has_id(const LkpIdArray *ids, const int id) {
+    for (int i = 0; i < ids->length; i++) {
+        if (ids->data[i] == id) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/** Returns whether the same file is mapped at the same place in the array. */
+static bool has_mapping(const LkpMappingArray *mappings, const LkpMapping *mapping) {
+    for (int i = 0; i < mappings->length; i++) {
+        const LkpMapping *other = &mappings->data[i];
+        if (other->start == mapping->start && strcmp(other->path, mapping->path) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+#ifdef __linux__
+
+/** Appends every numeric entry of a /proc directory, besides the one it was read through. */
+static void read_ids(const char *path, LkpIdArray *ids) {
+    DIR *directory = opendir(path);
+    if (directory == NULL) {
+        return;
+    }
+    const int ownFd = dirfd(directory);
+    struct dirent *entry;
+    while ((entry = readdir(directory)) != NULL) {
+        char *end;
+        const long id = strtol(entry->d_name, &end, 10);
+        if (end != entry->d_name && *end == '\0' && id != ownFd) {
+            LKP_APPEND_DA(ids, (int)id);
+        }
+    }
+    closedir(directory);
+}
+
+/** Copies a string into a new allocation. */
+static char *copy_string(const char *string) {
+    const size_t length = strlen(string);
+    char *copy = lkp_allocate((int)length + 1, sizeof(char));
+    memcpy(copy, string, length + 1);
+    return copy;
+}
+
+/** Returns whether the path is mapped with execute permissions in any of the lines. */
+static bool mapped_as_code(char **lines, const int amount, const char *path) {
+    for (int i = 0; i < amount; i++) {
+        char permissions[5];
+        int pathStart = 0;
+        if (sscanf(lines[i], "%*x-%*x %4s %*s %*s %*s %n", permissions, &pathStart) == 1
+                && permissions[2] == 'x' && pathStart > 0) {
+            if (strncmp(lines[i] + pathStart, path, strlen(path)) == 0) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/** Appends every mapped file of /proc/self/maps that isn't a library. */
+static void read_mappings(LkpMappingArray *mappings) {
+    FILE *maps = fopen("/proc/self/maps", "r");
+    if (maps == NULL) {
+        return;
+    }
+    LKP_DECLARE_DA_STRUCT(LineArray, char *);
+    LineArray lines;
+    LKP_INIT_DA(&lines);
+    char line[1024];
+    while (fgets(line, sizeof(line), maps) != NULL) {
+        line[strcspn(line, "\n")] = '\0';
+        LKP_APPEND_DA(&lines, copy_string(line));
+    }
+    fclose(maps);
+
+    for (int i = 0; i < lines.length; i++) {
+        unsigned long start, end;
+        int pathStart = 0;
+        if (sscanf(lines.data[i], "%lx-%lx %*s %*s %*s %*s %n", &start, &end, &pathStart) != 2
+                || pathStart == 0 || lines.data[i][pathStart] != '/') {
+            continue; // Anonymous, or one of the kernel's like [stack].
+        }
+        const char *path = lines.data[i] + pathStart;
+        if (!mapped_as_code(lines.data, lines.length, path)) {
+            LkpMapping mapping = {.start = start, .end = end, .path = copy_string(path)};
+            LKP_APPEND_DA(mappings, mapping);
+        }
+    }
+    for (int i = 0; i < lines.length; i++) {
+        free(lines.data[i]);
+    }
+    LKP_FREE_DA(&lines);
+}
+
+/** Reads the process' open descriptors, threads and mapped files. */
+void lkp_snapshot_resources(LkpResources *resources) {
+    LKP_INIT_DA(&resources->fds);
+    LKP_INIT_DA(&resources->threads);
+    LKP_INIT_DA(&resources->mappings);
+    read_ids("/proc/self/fd", &resources->fds);
+    read_ids("/proc/self/task", &resources->threads);
+    read_mappings(&resources->mappings);
+}
+
+/** Describes a leaked descriptor with what it points to, like a path or "socket:[1234]". */
+static void describe_fd(LeakText *text, const int fd) {
+    char path[64], target[256];
+    snprintf(path, sizeof(path), "/proc/self/fd/%d", fd);
+    const ssize_t length = readlink(path, target, sizeof(target) - 1);
+    if (length < 0) {
+        append_text(text, "fd %d", fd);
+        return;
+    }
+    target[length] = '\0';
+    append_text(text, "fd %d (%s)", fd, target);
+}
+
+/** Describes a leaked thread with its name. */
+static void describe_thread(LeakText *text, const int thread) {
+    char path[64], name[32] = "";
+    snprintf(path, sizeof(path), "/proc/self/task/%d/comm", thread);
+    FILE *comm = fopen(path, "r");
+    if (comm != NULL) {
+        if (fgets(name, sizeof(name), comm) == NULL) {
+            name[0] = '\0';
+        }
+        name[strcspn(name, "\n")] = '\0';
+        fclose(comm);
+    }
+    append_text(text, "thread %d (%s)", thread, name);
+}
+
+/** Waits a millisecond for exiting threads to disappear from /proc. */
+static void wait_for_threads() {
+    const struct timespec millisecond = {.tv_sec = 0, .tv_nsec = 1000000};
+    nanosleep(&millisecond, NULL);
+}
+
+#else
+
+/** There's no /proc to read, so nothing's ever found. */
+void lkp_snapshot_resources(LkpResources *resources) {
+    LKP_INIT_DA(&resources->fds);
+    LKP_INIT_DA(&resources->threads);
+    LKP_INIT_DA(&resources->mappings);
+}
+
+/** Never called, since snapshots are always empty. */
+static void describe_fd(LeakText *text, const int fd) {
+    append_text(text, "fd %d", fd);
+}
+
+/** Never called, since snapshots are always empty. */
+static void describe_thread(LeakText *text, const int thread) {
+    append_text(text, "thread %d", thread);
+}
+
+/** Never called, since snapshots are always empty. */
+static void wait_for_threads() {
+}
+
+#endif
+
+/** Starts a kind of leaks in the text, separating it from the kinds before it. */
+static void begin_kind(LeakText *text, const int amount, const char *kind) {
+    append_text(text, "%s%d %s%s: ", text->length == 0 ? "Leaked " : "; ", amount, kind,
+        amount == 1 ? "" : "s");
+}
+
+/** Adds the separator before an item, or says how many more there are past the listed ones. */
+static bool begin_item(LeakText *text, const int index, const int amount) {
+    if (index == LKP_LISTED_LEAKS) {
+        append_text(text, " and %d more", amount - index);
+    } else if (index > 0 && index < LKP_LISTED_LEAKS) {
+        append_text(text, ", ");
+    }
+    return index < LKP_LISTED_LEAKS;
+}
+
+/** Compares a new snapshot to the old one, giving exiting threads a moment first. */
+char *lkp_find_leaks(const LkpResources *before) {
+    LkpResources after;
+    lkp_snapshot_resources(&after);
+    LkpIdArray fds, threads;
+    LkpMappingArray mappings;
+    LKP_INIT_DA(&fds);
+    LKP_INIT_DA(&threads);
+    LKP_INIT_DA(&mappings);
+    for (int i = 0; i < after.fds.length; i++) {
+        if (!has_id(&before->fds, after.fds.data[i])) {
+            LKP_APPEND_DA(&fds, after.fds.data[i]);
+        }
+    }
+    for (int tries = 0; tries < THREAD_EXIT_TRIES; tries++) {
+        threads.length = 0;
+        for (int i = 0; i < after.threads.length; i++) {
+            if (!has_id(&before->threads, after.threads.data[i])) {
+                LKP_APPEND_DA(&threads, after.threads.data[i]);
+            }
+        }
+        if (threads.length == 0 || tries == THREAD_EXIT_TRIES - 1) {
+            break;
+        }
+        wait_for_threads();
+        LKP_FREE_DA(&after.threads);
+        LKP_INIT_DA(&after.threads);
+#ifdef __linux__
+        read_ids("/proc/self/task", &after.threads);
+#endif
+    }
+    for (int i = 0; i < after.mappings.length; i++) {
+        if (!has_mapping(&before->mappings, &after.mappings.data[i])) {
+            LKP_APPEND_DA(&mappings, after.mappings.data[i]);
+        }
+    }
+
+    LeakText text;
+    LKP_INIT_DA(&text);
+    if (fds.length > 0) {
+        begin_kind(&text, fds.length, "file descriptor");
+        for (int i = 0; i < fds.length && begin_item(&text, i, fds.length); i++) {
+            describe_fd(&text, fds.data[i]);
+        }
+    }
+    if (threads.length > 0) {
+        begin_kind(&text, threads.length, "thread");
+        for (int i = 0; i < threads.length && begin_item(&text, i, threads.length); i++) {
+            describe_thread(&text, threads.data[i]);
+        }
+    }
+    if (mappings.length > 0) {
+        begin_kind(&text, mappings.length, "mapping");
+        for (int i = 0; i < mappings.length && begin_item(&text, i, mappings.length); i++) {
+            append_text(
+                &text, "%s at 0x%" PRIxPTR "-0x%" PRIxPTR, mappings.data[i].path,
+                mappings.data[i].start, mappings.data[i].end
+            );
+        }
+    }
+    LKP_FREE_DA(&fds);
+    LKP_FREE_DA(&threads);
+    LKP_FREE_DA(&mappings);
+    lkp_free_resources(&after);
+    if (text.length == 0) {
+        return NULL;
+    }
+    append_text(&text, ".");
+    LKP_APPEND_DA(&text, '\0');
+    return text.data;
+}
+
+/** Frees the arrays and the paths of the mappings. */
+void lkp_free_resources(LkpResources *resources) {
+    for (int i = 0; i < resources->mappings.length; i++) {
+        free(resources->mappings.data[i].path);
+    }
+    LKP_FREE_DA(&resources->fds);
+    LKP_FREE_DA(&resources->threads);
+    LKP_FREE_DA(&resources->mappings);
+}
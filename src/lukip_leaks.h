@@ -0,0 +1,64 @@
+/**
+ * @file lukip_leaks.h
+ * @brief Header for finding file descriptors, threads and mappings that tests leave behind.
+ * 
+ * @author Larmix
+ */
+
+#ifndef LUKIP_LEAKS_H
+#define LUKIP_LEAKS_H
+
+#include <stdint.h>
+
+#include "lukip_dynamic_array.h"
+
+/** Most leaks of each kind listed in a test's warning, past which they're only counted. */
+#define LKP_LISTED_LEAKS 4
+
+/** A file mapped into memory. */
+typedef struct {
+    uintptr_t start;
+    uintptr_t end;
+    char *path; /** Allocated. */
+} LkpMapping;
+
+/** Open file descriptors or thread IDs. */
+LKP_DECLARE_DA_STRUCT(LkpIdArray, int);
+
+/** Mapped files. */
+LKP_DECLARE_DA_STRUCT(LkpMappingArray, LkpMapping);
+
+/** What the process held at some point, to compare against what it holds later. */
+typedef struct {
+    LkpIdArray fds;
+    LkpIdArray threads;
+    LkpMappingArray mappings;
+} LkpResources;
+
+/**
+ * @brief Takes a snapshot of the process' open file descriptors, threads and mapped files.
+ * 
+ * They're read from /proc/self, so the snapshot is always empty on other systems.
+ * Mappings of files that are mapped as code anywhere (dlopen()ed libraries) are left out,
+ * and so are anonymous mappings, since the allocator and thread stacks keep those around anyway.
+ * 
+ * @param[out] resources Where the snapshot goes, to be freed with lkp_free_resources().
+ */
+void lkp_snapshot_resources(LkpResources *resources);
+
+/**
+ * @brief Finds what's held now but wasn't when the snapshot was taken.
+ * 
+ * Threads get a few milliseconds to finish exiting, since a joined thread can still
+ * show up in /proc for a moment.
+ * 
+ * @param before The snapshot from before.
+ * 
+ * @return A sentence listing the leaks, allocated, or NULL if there weren't any.
+ */
+char *lkp_find_leaks(const LkpResources *before);
+
+/** Frees a snapshot. */
+void lkp_free_resources(LkpResources *resources);
+
+#endif
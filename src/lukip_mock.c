@@ -0,0 +1,121 @@
+/**
+ * @file lukip_mock.c
+ * @brief Arming, verifying and disarming the mocks that MOCK_FUNC() generates.
+ * 
+ * The generated __wrap_ function only does an atomic load while its mock is unarmed,
+ * so mocks cost next to nothing in tests that don't use them. Arming (and everything else here)
+ * is meant to be done from the test's own thread, while calls can come from any thread.
+ * 
+ * @author Larmix
+ */
+
+#include "lukip_assert.h"
+#include "lukip_mock.h"
+
+static LkpMock *armedMocks = NULL; /** Every mock armed in the current test. */
+
+/** Fails the test if the mocked function isn't wrapped, since the mock would never be called. */
+static bool check_wrapped(const LkpMock *mock, const bool wrapped, const LkpLineInfo info) {
+    if (!wrapped) {
+        lkp_verify_condition(
+            false, info, "Mocking %s() needs the program linked with -Wl,--wrap=%s.",
+            mock->name, mock->name
+        );
+    }
+    return wrapped;
+}
+
+/** Arms a mock that isn't armed yet, counting its calls from 0. */
+static void arm(LkpMock *mock) {
+    if (atomic_load(&mock->armed)) {
+        return;
+    }
+    atomic_store(&mock->calls, 0);
+    mock->next = armedMocks;
+    armedMocks = mock;
+    atomic_store_explicit(&mock->armed, true, memory_order_release);
+}
+
+/** Puts a mock back to how it was before it got armed. */
+static void reset(LkpMock *mock) {
+    atomic_store(&mock->armed, false);
+    atomic_store(&mock->calls, 0);
+    mock->behavior = LKP_MOCK_SPY;
+    mock->expected = -1;
+    mock->next = NULL;
+}
+
+/** Arms a mock with a new way of answering calls. */
+void lkp_arm_mock(
+    LkpMock *mock, const LkpMockBehavior behavior, const bool wrapped, const LkpLineInfo info
+) {
+    if (check_wrapped(mock, wrapped, info)) {
+        mock->behavior = behavior;
+        arm(mock);
+    }
+}
+
+/** Sets how many calls a mock expects, arming it as a spy if needed. */
+void lkp_expect_mock_calls(
+    LkpMock *mock, const long long times, const bool wrapped, const LkpLineInfo info
+) {
+    if (check_wrapped(mock, wrapped, info)) {
+        mock->expected = times;
+        mock->expectedAt = info;
+        arm(mock);
+    }
+}
+
+/** Finds a recorded call in the ring, where a missing one fails like a REQUIRE(). */
+int lkp_mock_slot(LkpMock *mock, const long long call, const LkpLineInfo info) {
+    const long long calls = atomic_load(&mock->calls);
+    const bool made = call >= 0 && call < calls;
+    if (!made || call < calls - LKP_MOCK_CALLS) {
+        lkp_begin_require();
+        if (!made) {
+            lkp_verify_condition(
+                false, info, "%s() has no call %lld, since it was called %lld time%s.",
+                mock->name, call, calls, calls == 1 ? "" : "s"
+            );
+        } else {
+            lkp_verify_condition(
+                false, info, "Call %lld of %s() was overwritten, as only the last %d are kept.",
+                call, mock->name, LKP_MOCK_CALLS
+            );
+        }
+        lkp_end_require();
+        return -1;
+    }
+    return (int)(call % LKP_MOCK_CALLS);
+}
+
+/** Disarms a single mock before the end of the test. */
+void lkp_disarm_mock(LkpMock *mock) {
+    for (LkpMock **link = &armedMocks; *link != NULL; link = &(*link)->next) {
+        if (*link == mock) {
+            *link = mock->next;
+            break;
+        }
+    }
+    reset(mock);
+}
+
+/** Verifies (if asked to) and disarms every mock armed in the test. */
+void lkp_finish_mocks(const bool verify) {
+    LkpMock *mock = armedMocks;
+    while (mock != NULL) {
+        LkpMock *next = mock->next;
+        const long long calls = atomic_load(&mock->calls);
+        if (verify && mock->expected >= 0) {
+            lkp_verify_condition(
+                calls == mock->expected, mock->expectedAt,
+                "Expected %s() to be called %lld time%s, but it was called %lld time%s.",
+                mock->name, mock->expected, mock->expected == 1 ? "" : "s",
+                calls, calls == 1 ? "" : "s"
+            );
+        }
+        reset(mock);
+        mock = next;
+    }
+    armedMocks = NULL;
+}
@@ -0,0 +1,132 @@
+/**
+ * @file lukip_mock.h
+ * @brief Helpers for the mocks which MOCK_FUNC() generates on top of the linker's --wrap.
+ * 
+ * A mocked function's parameters are written as a parenthesized list of type and name pairs,
+ * like (const char *, key, size_t, length), or (void) when it has none. The macros here turn
+ * that list into the parameters, arguments and recorded fields of the generated code.
+ * Up to LKP_MOCK_MAX_PARAMS parameters are supported.
+ * 
+ * @author Larmix
+ */
+
+#ifndef LUKIP_MOCK_H
+#define LUKIP_MOCK_H
+
+#include <stdbool.h>
+
+/** Calls of every mock whose arguments are kept, where older ones get overwritten. */
+#define LKP_MOCK_CALLS 64
+
+/** Most parameters a mocked function can have. */
+#define LKP_MOCK_MAX_PARAMS 6
+
+#ifdef __GNUC__
+    /** The real function is only there when the program was linked with --wrap. */
+    #define LKP_MOCK_WEAK __attribute__((weak))
+#else
+    #define LKP_MOCK_WEAK
+#endif
+
+#define LKP_MOCK_CAT_(a, b) a##b
+#define LKP_MOCK_CAT(a, b) LKP_MOCK_CAT_(a, b)
+#define LKP_MOCK_UNPAREN(...) __VA_ARGS__
+
+/** Counts the pairs of a parameter list, where a lone (void) has none. */
+#define LKP_MOCK_PAIRS(...) \
+    LKP_MOCK_PICK(__VA_ARGS__, 6, 0, 5, 0, 4, 0, 3, 0, 2, 0, 1, 0, unused)
+#define LKP_MOCK_PICK(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, count, ...) count
+
+/** Expands a macro family for the amount of pairs in the parameter list. */
+#define LKP_MOCK_APPLY(family, ...) \
+    LKP_MOCK_CAT(family, LKP_MOCK_PAIRS(__VA_ARGS__))(__VA_ARGS__)
+
+/** The parameters of the function, like "const char * key, size_t length". */
+#define LKP_MOCK_PARAMS(...) LKP_MOCK_APPLY(LKP_MOCK_PARAMS_, __VA_ARGS__)
+#define LKP_MOCK_PARAMS_0(none) void
+#define LKP_MOCK_PARAMS_1(t1, n1) t1 n1
+#define LKP_MOCK_PARAMS_2(t1, n1, t2, n2) t1 n1, t2 n2
+#define LKP_MOCK_PARAMS_3(t1, n1, t2, n2, t3, n3) t1 n1, t2 n2, t3 n3
+#define LKP_MOCK_PARAMS_4(t1, n1, t2, n2, t3, n3, t4, n4) t1 n1, t2 n2, t3 n3, t4 n4
+#define LKP_MOCK_PARAMS_5(t1, n1, t2, n2, t3, n3, t4, n4, t5, n5) \
+    t1 n1, t2 n2, t3 n3, t4 n4, t5 n5
+#define LKP_MOCK_PARAMS_6(t1, n1, t2, n2, t3, n3, t4, n4, t5, n5, t6, n6) \
+    t1 n1, t2 n2, t3 n3, t4 n4, t5 n5, t6 n6
+
+/** The arguments to pass the parameters on with, like "key, length". */
+#define LKP_MOCK_ARGS(...) LKP_MOCK_APPLY(LKP_MOCK_ARGS_, __VA_ARGS__)
+#define LKP_MOCK_ARGS_0(none)
+#define LKP_MOCK_ARGS_1(t1, n1) n1
+#define LKP_MOCK_ARGS_2(t1, n1, t2, n2) n1, n2
+#define LKP_MOCK_ARGS_3(t1, n1, t2, n2, t3, n3) n1, n2, n3
+#define LKP_MOCK_ARGS_4(t1, n1, t2, n2, t3, n3, t4, n4) n1, n2, n3, n4
+#define LKP_MOCK_ARGS_5(t1, n1, t2, n2, t3, n3, t4, n4, t5, n5) n1, n2, n3, n4, n5
+#define LKP_MOCK_ARGS_6(t1, n1, t2, n2, t3, n3, t4, n4, t5, n5, t6, n6) n1, n2, n3, n4, n5, n6
+
+/** The fields a call's arguments are recorded in, like "const char * key; size_t length;". */
+#define LKP_MOCK_FIELDS(...) LKP_MOCK_APPLY(LKP_MOCK_FIELDS_, __VA_ARGS__)
+#define LKP_MOCK_FIELDS_0(none)
+#define LKP_MOCK_FIELDS_1(t1, n1) t1 n1;
+#define LKP_MOCK_FIELDS_2(t1, n1, t2, n2) t1 n1; t2 n2;
+#define LKP_MOCK_FIELDS_3(t1, n1, t2, n2, t3, n3) t1 n1; t2 n2; t3 n3;
+#define LKP_MOCK_FIELDS_4(t1, n1, t2, n2, t3, n3, t4, n4) t1 n1; t2 n2; t3 n3; t4 n4;
+#define LKP_MOCK_FIELDS_5(t1, n1, t2, n2, t3, n3, t4, n4, t5, n5) \
+    t1 n1; t2 n2; t3 n3; t4 n4; t5 n5;
+#define LKP_MOCK_FIELDS_6(t1, n1, t2, n2, t3, n3, t4, n4, t5, n5, t6, n6) \
+    t1 n1; t2 n2; t3 n3; t4 n4; t5 n5; t6 n6;
+
+/** Copies the arguments into a call's record. */
+#define LKP_MOCK_STORE(record, ...) \
+    LKP_MOCK_STORE_I(record, LKP_MOCK_PAIRS(__VA_ARGS__), __VA_ARGS__)
+#define LKP_MOCK_STORE_I(record, count, ...) \
+    LKP_MOCK_CAT(LKP_MOCK_STORE_, count)(record, __VA_ARGS__)
+#define LKP_MOCK_STORE_0(record, none)
+#define LKP_MOCK_STORE_1(record, t1, n1) (record)->n1 = n1;
+#define LKP_MOCK_STORE_2(record, t1, n1, ...) \
+    (record)->n1 = n1; LKP_MOCK_STORE_1(record, __VA_ARGS__)
+#define LKP_MOCK_STORE_3(record, t1, n1, ...) \
+    (record)->n1 = n1; LKP_MOCK_STORE_2(record, __VA_ARGS__)
+#define LKP_MOCK_STORE_4(record, t1, n1, ...) \
+    (record)->n1 = n1; LKP_MOCK_STORE_3(record, __VA_ARGS__)
+#define LKP_MOCK_STORE_5(record, t1, n1, ...) \
+    (record)->n1 = n1; LKP_MOCK_STORE_4(record, __VA_ARGS__)
+#define LKP_MOCK_STORE_6(record, t1, n1, ...) \
+    (record)->n1 = n1; LKP_MOCK_STORE_5(record, __VA_ARGS__)
+
+/**
+ * @brief Declares the real function, and the state of its mock (which every MOCK_*() uses).
+ * 
+ * The calls ring is statically allocated, so recording a call never allocates.
+ * It starts at calls[1], so a failed lookup (slot -1) reads the zeroed calls[0]
+ * instead of another call's arguments.
+ */
+#define LKP_MOCK_STATE(returnField, returnType, func, params) \
+    extern returnType __real_##func(LKP_MOCK_PARAMS params) LKP_MOCK_WEAK; \
+    static struct { \
+        LkpMock mock; \
+        struct func##_mock_call { \
+            LKP_MOCK_FIELDS params char lkpUnused; \
+        } calls[LKP_MOCK_CALLS + 1]; \
+        returnType (*fake)(LKP_MOCK_PARAMS params); \
+        returnField \
+    } func##_mock = {.mock = {.name = #func, .expected = -1}}
+
+/** Counts an armed call and records its arguments into the ring. */
+#define LKP_MOCK_RECORD(func, params) \
+    do { \
+        const long long lkpCall = atomic_fetch_add_explicit( \
+            &func##_mock.mock.calls, 1, memory_order_relaxed \
+        ); \
+        struct func##_mock_call *lkpRecord = &func##_mock.calls[1 + lkpCall % LKP_MOCK_CALLS]; \
+        LKP_MOCK_STORE(lkpRecord, LKP_MOCK_UNPAREN params) \
+        (void)lkpRecord; \
+    } while (false)
+
+/**
+ * @brief Verifies the expected call counts of the test's mocks, then disarms all of them.
+ * 
+ * @param verify Whether to verify them, which is skipped when the test's body was cut short.
+ */
+void lkp_finish_mocks(const bool verify);
+
+#endif
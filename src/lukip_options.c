@@ -0,0 +1,127 @@
+/**
+ * @file lukip_options.c
+ * @brief Parses the command line options Lukip understands.
+ * 
+ * @author Larmix
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "lukip_options.h"
+
+/** Returns the value of a "--name=value" argument if it starts with prefix, otherwise NULL. */
+static const char *option_value(const char *argument, const char *prefix) {
+    const size_t length = strlen(prefix);
+    if (strncmp(argument, prefix, length) != 0) {
+        return NULL;
+    }
+    return argument + length;
+}
+
+/**
+ * Results are only kept if LKP_CACHE_ENV holds a path, until an option needs them.
+ * Without LKP_SEED_ENV, the seed comes from the time so every run tries new inputs.
+ */
+void lkp_init_options(LkpOptions *options) {
+    options->failedFirst = false;
+    options->onlyFailed = false;
+    options->stopEarly = false;
+    options->skipUnchanged = false;
+    options->capture = false;
+    options->repeat = 1;
+    options->untilFail = false;
+    options->reportPath = NULL;
+    options->shuffle = false;
+    options->bisect = NULL;
+    options->leaks = LKP_LEAKS_WARN;
+    options->timings = false;
+
+    const char *cachePath = getenv(LKP_CACHE_ENV);
+    options->cachePath = cachePath != NULL && cachePath[0] != '\0' ? cachePath : NULL;
+    const char *seed = getenv(LKP_SEED_ENV);
+    options->seed = seed != NULL ? strtoull(seed, NULL, 10) : (uint64_t)time(NULL) ^ clock();
+    options->shuffleSeed = options->seed;
+    options->jobs = 0;
+
+    const char *fuzzDir = getenv(LKP_FUZZ_DIR_ENV);
+    options->fuzzDir = fuzzDir != NULL && fuzzDir[0] != '\0' ? fuzzDir : LKP_DEFAULT_FUZZ_DIR;
+    options->fuzzSeconds = LKP_DEFAULT_FUZZ_SECONDS;
+    options->fuzzRuns = 0;
+}
+
+/**
+ * Goes over every argument and sets whichever option it matches.
+ * --until-fail without --repeat repeats up to LKP_DEFAULT_UNTIL_FAIL_RUNS times,
+ * and --shuffle without a seed uses the one of generated inputs.
+ * The options that read the last run's results keep them in LKP_DEFAULT_CACHE_PATH
+ * if no other path was given, unless --no-cache came after any --cache-file.
+ */
+void lkp_parse_options(LkpOptions *options, const int argc, char **argv) {
+    bool repeatGiven = false;
+    bool shuffleSeedGiven = false;
+    bool cacheDisabled = false;
+    for (int i = 1; i < argc; i++) {
+        const char *argument = argv[i];
+        const char *value;
+        if (strcmp(argument, "--failed-first") == 0) {
+            options->failedFirst = true;
+        } else if (strcmp(argument, "--only-failed") == 0) {
+            options->onlyFailed = true;
+        } else if (strcmp(argument, "--stop-early") == 0) {
+            options->stopEarly = true;
+        } else if (strcmp(argument, "--skip-unchanged") == 0) {
+            options->skipUnchanged = true;
+        } else if (strcmp(argument, "--capture") == 0) {
+            options->capture = true;
+        } else if (strcmp(argument, "--until-fail") == 0) {
+            options->untilFail = true;
+        } else if ((value = option_value(argument, "--repeat=")) != NULL) {
+            options->repeat = atoi(value) > 0 ? atoi(value) : 1;
+            repeatGiven = true;
+        } else if ((value = option_value(argument, "--report=")) != NULL) {
+            options->reportPath = value;
+        } else if (strcmp(argument, "--shuffle") == 0) {
+            options->shuffle = true;
+        } else if ((value = option_value(argument, "--shuffle=")) != NULL) {
+            options->shuffle = true;
+            options->shuffleSeed = strtoull(value, NULL, 10);
+            shuffleSeedGiven = true;
+        } else if ((value = option_value(argument, "--bisect=")) != NULL) {
+            options->bisect = value;
+        } else if (strcmp(argument, "--fail-leaks") == 0) {
+            options->leaks = LKP_LEAKS_FAIL;
+        } else if (strcmp(argument, "--ignore-leaks") == 0) {
+            options->leaks = LKP_LEAKS_IGNORE;
+        } else if (strcmp(argument, "--timings") == 0) {
+            options->timings = true;
+        } else if (strcmp(argument, "--no-cache") == 0) {
+            options->cachePath = NULL;
+            cacheDisabled = true;
+        } else if ((value = option_value(argument, "--cache-file=")) != NULL) {
+            options->cachePath = value;
+            cacheDisabled = false;
+        } else if ((value = option_value(argument, "--seed=")) != NULL) {
+            options->seed = strtoull(value, NULL, 10);
+        } else if ((value = option_value(argument, "--jobs=")) != NULL) {
+            options->jobs = atoi(value);
+        } else if ((value = option_value(argument, "--fuzz-dir=")) != NULL) {
+            options->fuzzDir = value;
+        } else if ((value = option_value(argument, "--fuzz-time=")) != NULL) {
+            options->fuzzSeconds = atoi(value);
+        } else if ((value = option_value(argument, "--fuzz-runs=")) != NULL) {
+            options->fuzzRuns = atoi(value);
+        }
+    }
+    if (options->untilFail && !repeatGiven) {
+        options->repeat = LKP_DEFAULT_UNTIL_FAIL_RUNS;
+    }
+    if (!shuffleSeedGiven) {
+        options->shuffleSeed = options->seed;
+    }
+    const bool needsCache = options->failedFirst || options->onlyFailed || options->skipUnchanged;
+    if (needsCache && options->cachePath == NULL && !cacheDisabled) {
+        options->cachePath = LKP_DEFAULT_CACHE_PATH;
+    }
+}
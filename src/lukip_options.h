@@ -0,0 +1,83 @@
+/**
+ * @file lukip_options.h
+ * @brief Header for the command line options Lukip understands.
+ * 
+ * @author Larmix
+ */
+
+#ifndef LUKIP_OPTIONS_H
+#define LUKIP_OPTIONS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/** Environment variable naming a file to keep the results of runs in (which turns caching on). */
+#define LKP_CACHE_ENV "LUKIP_CACHE"
+
+/** File the results of the last run are kept in when an option needs them and none is given. */
+#define LKP_DEFAULT_CACHE_PATH ".lukip_cache"
+
+/** Environment variable which overrides where the corpora of fuzz tests are kept. */
+#define LKP_FUZZ_DIR_ENV "LUKIP_FUZZ_DIR"
+
+/** Default directory the corpora of fuzz tests are kept in (one subdirectory per test). */
+#define LKP_DEFAULT_FUZZ_DIR "fuzz"
+
+/** Default amount of seconds each fuzz test runs for in fuzzing builds. */
+#define LKP_DEFAULT_FUZZ_SECONDS 10
+
+/** Most times --until-fail runs each test if --repeat doesn't say otherwise. */
+#define LKP_DEFAULT_UNTIL_FAIL_RUNS 1000
+
+/** Environment variable which holds the seed of everything Lukip generates randomly. */
+#define LKP_SEED_ENV "LUKIP_SEED"
+
+/** What to do about the file descriptors, threads and mappings a test leaves behind. */
+typedef enum {
+    LKP_LEAKS_WARN, /** Show them as warnings. */
+    LKP_LEAKS_FAIL, /** Fail the test. */
+    LKP_LEAKS_IGNORE /** Don't look for them at all. */
+} LkpLeakMode;
+
+/** Options which change which tests run and in what order. */
+typedef struct {
+    bool failedFirst; /** Run the tests that failed last time before the others. */
+    bool onlyFailed; /** Only run the tests that failed last time. */
+    bool stopEarly; /** Don't run anything else after the first failed test. */
+    bool skipUnchanged; /** Skip tests which passed last time if their inputs didn't change. */
+    bool capture; /** Keep what tests print in memory, and only show it for failed ones. */
+    int repeat; /** How many times each test runs, to tell flaky tests apart. */
+    bool untilFail; /** Stop repeating a test once it fails. */
+    const char *reportPath; /** Where to write a JSON report of the results, or NULL for nowhere. */
+    bool shuffle; /** Run the tests in a random order, to find the ones that depend on it. */
+    uint64_t shuffleSeed; /** Seed of the order, the generated inputs' one unless passed. */
+    LkpLeakMode leaks;
+    bool timings; /** Show a table of how long each test took and what its body used. */
+    const char *bisect; /** Name of a test to find the earlier test that makes it fail, or NULL. */
+    const char *cachePath; /** Where the results of runs are kept, or NULL to not keep them. */
+    uint64_t seed; /** Seed of generated inputs, which is random unless one's passed. */
+    int jobs; /** Threads that run generated cases and rows, where 0 means one per core. */
+    const char *fuzzDir; /** Where the corpora and reproducers of fuzz tests are kept. */
+    int fuzzSeconds; /** How long each fuzz test runs for in fuzzing builds. */
+    int fuzzRuns; /** Most inputs each fuzz test tries in fuzzing builds, or 0 for no limit. */
+} LkpOptions;
+
+/**
+ * @brief Sets the options to their defaults (which includes reading the environment).
+ * 
+ * @param options The options to initialize.
+ */
+void lkp_init_options(LkpOptions *options);
+
+/**
+ * @brief Parses Lukip's options out of the program's arguments.
+ * 
+ * Arguments Lukip doesn't know are left alone, since they're probably the program's own.
+ * 
+ * @param options The options to change.
+ * @param argc The amount of arguments.
+ * @param argv The arguments, where the first one is the program's name.
+ */
+void lkp_parse_options(LkpOptions *options, const int argc, char **argv);
+
+#endif
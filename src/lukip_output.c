@@ -8,9 +8,12 @@
 #include <stdio.h>
 
 #include "lukip_assert.h"
+#include "lukip_benchmark.h"
 
 #define LONG_LINE_LENGTH 100 /** Amount of characters placed to separate output. */
 
+#define BAR_LENGTH 40 /** Characters of the fullest row in a latency distribution. */
+
 #define DEFAULT "\033[0m" /** Resets color to normal. */
 
 #define RED "\033[1;31m"
@@ -99,6 +102,188 @@ static void show_warnings(const LukipUnit *lukip) {
     }
 }
 
+/**
+ * @brief Show how many tests weren't run because of the options (like --only-failed),
+ * and how many were skipped as cached.
+ * 
+ * @param lukip The Lukip unit which might've skipped tests.
+ */
+static void show_skipped(const LukipUnit *lukip) {
+    int cached = 0;
+    for (int i = 0; i < lukip->tests.length; i++) {
+        if (lukip->tests.data[i].info.status == LKP_TEST_CACHED) {
+            cached++;
+        }
+    }
+    if (lukip->skippedTests == 0 && cached == 0) {
+        return;
+    }
+    if (lukip->skippedTests != 0) {
+        printf("[" YELLOW "SKIPPED" DEFAULT "] %d tests weren't run.\n", lukip->skippedTests);
+    }
+    if (cached != 0) {
+        printf(
+            "[" GREEN "CACHED" DEFAULT "] %d tests passed last time and their inputs didn't change.\n",
+            cached
+        );
+    }
+    long_line('=');
+}
+
+/**
+ * @brief Show the seed of the order tests ran in if they were shuffled, so it can be repeated.
+ * 
+ * @param lukip The Lukip unit whose tests might've been shuffled.
+ */
+static void show_order(const LukipUnit *lukip) {
+    if (!lukip->options.shuffle) {
+        return;
+    }
+    printf(
+        "[" YELLOW "SHUFFLED" DEFAULT "] Tests ran in a random order, which --shuffle=%" PRIu64
+        " repeats.\n", lukip->options.shuffleSeed
+    );
+    long_line('=');
+}
+
+/**
+ * @brief Show every test that passed some of its runs and failed others, with its pass rate.
+ * 
+ * @param lukip The Lukip unit whose tests might've been repeated.
+ */
+static void show_flaky(const LukipUnit *lukip) {
+    bool hadFlaky = false;
+    for (int i = 0; i < lukip->tests.length; i++) {
+        const LkpTestFunc *test = &lukip->tests.data[i];
+        if (!lkp_is_flaky(test)) {
+            continue;
+        }
+        hadFlaky = true;
+        printf(
+            "[" YELLOW "FLAKY" DEFAULT "] %s|%s() passed %d/%d runs (%.1lf%%), "
+            "taking %.3lf ms (+-%.3lf).\n",
+            test->info.fileName, test->info.funcName, test->passedRuns, test->runs,
+            100.0 * test->passedRuns / test->runs, test->meanMs, lkp_time_deviation(test)
+        );
+    }
+    if (hadFlaky) {
+        long_line('=');
+    }
+}
+
+/**
+ * @brief Show the complexity class each benchmark fits, and its time at every size.
+ * 
+ * @param lukip The Lukip unit whose benchmarks ran.
+ */
+static void show_scaling(const LukipUnit *lukip) {
+    bool hadBenchmarks = false;
+    for (int i = 0; i < lukip->tests.length; i++) {
+        const LkpTestFunc *test = &lukip->tests.data[i];
+        if (test->scaling.points.length == 0) {
+            continue;
+        }
+        hadBenchmarks = true;
+        char *fit = lkp_describe_scaling(&test->scaling);
+        printf(
+            "[" YELLOW "SCALING" DEFAULT "] %s|%s() fits %s.\n%14s %14s %14s %10s\n",
+            test->info.fileName, test->info.funcName, fit, "n", "Median ns", "p99 ns", "Runs"
+        );
+        free(fit);
+        for (int j = 0; j < test->scaling.points.length; j++) {
+            const LkpBenchPoint *point = &test->scaling.points.data[j];
+            printf(
+                "%14lld %14lld %14lld %10lld\n", point->n, point->medianNs, point->p99Ns,
+                point->runs
+            );
+        }
+    }
+    if (hadBenchmarks) {
+        long_line('=');
+    }
+}
+
+/**
+ * @brief Shows a latency assert's percentiles, and its durations as a bar per power of two.
+ * 
+ * @param test The test which has the latency assert.
+ * @param record The latency assert's durations.
+ */
+static void show_distribution(const LkpTestFunc *test, const LkpLatencyRecord *record) {
+    // Row 0 is durations of 0, and row r is from 2 to the power of r - 1 up to the next row.
+    long long rows[LKP_HISTOGRAM_MAX_BITS + 1] = {0};
+    int firstRow = LKP_HISTOGRAM_MAX_BITS, lastRow = 0;
+    for (int i = 0; i < LKP_HISTOGRAM_BUCKETS; i++) {
+        if (record->histogram->counts[i] == 0) {
+            continue;
+        }
+        int row = 0;
+        for (long long lowest = lkp_bucket_lowest(i); lowest > 0; lowest >>= 1) {
+            row++;
+        }
+        rows[row] += record->histogram->counts[i];
+        firstRow = row < firstRow ? row : firstRow;
+        lastRow = row > lastRow ? row : lastRow;
+    }
+    long long fullest = 1;
+    for (int row = firstRow; row <= lastRow; row++) {
+        fullest = rows[row] > fullest ? rows[row] : fullest;
+    }
+
+    char *description = lkp_describe_histogram(record->histogram);
+    printf(
+        "[" YELLOW "LATENCY" DEFAULT "] Line %d: %s|%s(): `%s`\n    %s\n", record->line,
+        test->info.fileName, test->info.funcName, record->statement, description
+    );
+    free(description);
+    for (int row = firstRow; row <= lastRow; row++) {
+        char bar[BAR_LENGTH + 1];
+        int length = (int)(rows[row] * BAR_LENGTH / fullest);
+        length = length == 0 && rows[row] > 0 ? 1 : length;
+        memset(bar, '#', length);
+        bar[length] = '\0';
+        printf(
+            "%14lld ns |%-*s| %lld\n", row == 0 ? 0 : 1LL << (row - 1), BAR_LENGTH, bar, rows[row]
+        );
+    }
+}
+
+/**
+ * @brief Show a table of each test's mean time and what its body used over all of its runs,
+ * followed by the distribution of every latency assert.
+ * 
+ * Only shown with --timings, and without the cached tests (which didn't run).
+ * 
+ * @param lukip The Lukip unit whose tests ran.
+ */
+static void show_timings(const LukipUnit *lukip) {
+    if (!lukip->options.timings) {
+        return;
+    }
+    printf(
+        "%-30s %5s %10s %10s %7s %9s %9s %10s\n", "Test", "Runs", "Mean ms", "Minor flt",
+        "Major", "Vol ctxsw", "Preempted", "RSS KiB"
+    );
+    for (int i = 0; i < lukip->tests.length; i++) {
+        const LkpTestFunc *test = &lukip->tests.data[i];
+        if (test->runs == 0) {
+            continue;
+        }
+        printf(
+            "%-30.30s %5d %10.3lf %10lld %7lld %9lld %9lld %+10lld\n", test->name, test->runs,
+            test->meanMs, test->usage.minorFaults, test->usage.majorFaults,
+            test->usage.voluntarySwitches, test->usage.involuntarySwitches, test->usage.rssKb
+        );
+    }
+    for (int i = 0; i < lukip->tests.length; i++) {
+        const LkpTestFunc *test = &lukip->tests.data[i];
+        for (int j = 0; j < test->latencies.length; j++) {
+            show_distribution(test, &test->latencies.data[j]);
+        }
+    }
+    long_line('=');
+}
+
 /**
  * @brief Show an error message for each unit-test failure.
  * 
@@ -118,6 +303,14 @@ static void errors_info(const LukipUnit *lukip) {
                 failure.line, test->info.fileName, test->info.funcName, failure.message
             );
         }
+        if (test->output != NULL) {
+            const size_t length = strlen(test->output);
+            printf(
+                "[" YELLOW "OUTPUT" DEFAULT "] %s|%s() printed:\n%s%s",
+                test->info.fileName, test->info.funcName, test->output,
+                length > 0 && test->output[length - 1] == '\n' ? "" : "\n"
+            );
+        }
     }
 }
 
@@ -133,11 +326,16 @@ static void errors_info(const LukipUnit *lukip) {
 static void show_fail(const LukipUnit *lukip, const double executionTime) {
     int failures = 0;
     for (int i = 0; i < lukip->tests.length; i++) {
-        if (lukip->tests.data[i].info.status == LKP_TEST_FAILURE) {
+        if (lukip->tests.data[i].timedOut) {
+            putchar('T');
+            failures++;
+        } else if (lukip->tests.data[i].info.status == LKP_TEST_FAILURE) {
             putchar('F');
             failures++;
         } else if (lukip->tests.data[i].info.status == LKP_TEST_SUCCESS) {
             putchar('.');
+        } else if (lukip->tests.data[i].info.status == LKP_TEST_CACHED) {
+            putchar('C');
         } else {
             putchar('?');
         }
@@ -168,7 +366,12 @@ static void show_fail(const LukipUnit *lukip, const double executionTime) {
  */
 static void show_success(const LukipUnit *lukip, const double executionTime) {
     for (int i = 0; i < lukip->tests.length; i++) {
-        lukip->tests.data[i].info.status == LKP_TEST_SUCCESS ? putchar('.') : putchar('?');
+        const LkpTestStatus status = lukip->tests.data[i].info.status;
+        if (status == LKP_TEST_SUCCESS) {
+            putchar('.');
+        } else {
+            status == LKP_TEST_CACHED ? putchar('C') : putchar('?');
+        }
     }
     putchar('\n');
     long_line('=');
@@ -192,6 +395,11 @@ void lkp_show_results(const LukipUnit *lukip) {
     printf("\n\n\n");
     long_line('=');
     show_warnings(lukip);
+    show_skipped(lukip);
+    show_order(lukip);
+    show_flaky(lukip);
+    show_scaling(lukip);
+    show_timings(lukip);
 
     const clock_t endTime = clock();
     const double executionTime = (double)(endTime - lukip->startTime) / CLOCKS_PER_SEC;
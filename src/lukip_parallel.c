@@ -0,0 +1,63 @@
+/**
+ * @file lukip_parallel.c
+ * @brief Runs work on several threads at once with pthreads, or on one thread without them.
+ * 
+ * @author Larmix
+ */
+
+#include <stdlib.h>
+
+#include "lukip_allocator.h"
+#include "lukip_parallel.h"
+#include "lukip_platform.h"
+
+#ifdef LKP_POSIX
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#ifdef LKP_POSIX
+
+/** Asks the system how many cores are online. */
+int lkp_default_jobs() {
+    const long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return cores > 0 ? (int)cores : 1;
+}
+
+/** Starts a thread for every worker but the first, which this thread runs itself. */
+void lkp_run_parallel(
+    const LkpWorkerFunc func, void *workers, const int amount, const size_t workerSize
+) {
+    pthread_t *threads = lkp_allocate(amount, sizeof(pthread_t));
+    int started = 1;
+    while (started < amount) {
+        void *worker = (char *)workers + started * workerSize;
+        if (pthread_create(&threads[started], NULL, func, worker) != 0) {
+            break; // Just go on with the threads we've got.
+        }
+        started++;
+    }
+    func(workers);
+    for (int i = 1; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+}
+
+#else
+
+/** Without pthreads there's only one thread to use. */
+int lkp_default_jobs() {
+    return 1;
+}
+
+/** Runs the first worker on this thread. */
+void lkp_run_parallel(
+    const LkpWorkerFunc func, void *workers, const int amount, const size_t workerSize
+) {
+    (void)amount;
+    (void)workerSize;
+    func(workers);
+}
+
+#endif
@@ -0,0 +1,39 @@
+/**
+ * @file lukip_parallel.h
+ * @brief Header for running work on several threads at once.
+ * 
+ * @author Larmix
+ */
+
+#ifndef LUKIP_PARALLEL_H
+#define LUKIP_PARALLEL_H
+
+#include <stddef.h>
+
+/** What every thread runs, given its own worker. */
+typedef void *(*LkpWorkerFunc)(void *worker);
+
+/**
+ * @brief Returns how many threads to use when the user didn't pick an amount.
+ * 
+ * @return The amount of online cores, or 1 if it's unknown (or there are no threads).
+ */
+int lkp_default_jobs();
+
+/**
+ * @brief Runs a function on every worker, each on its own thread, and waits for all of them.
+ * 
+ * The calling thread runs the first worker itself. Workers are expected to take their work
+ * out of something shared, since a thread that can't be started just leaves its worker unused
+ * (which is also what happens to every worker but the first on platforms without pthreads).
+ * 
+ * @param func The function every thread runs.
+ * @param workers An array of workers, where each one is passed to one thread.
+ * @param amount How many workers there are.
+ * @param workerSize The size of each worker.
+ */
+void lkp_run_parallel(
+    const LkpWorkerFunc func, void *workers, const int amount, const size_t workerSize
+);
+
+#endif
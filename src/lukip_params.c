@@ -0,0 +1,534 @@
+/**
+ * @file lukip_params.c
+ * @brief Streams the rows of parameterized tests out of mapped files, in chunks over threads.
+ * 
+ * @author Larmix
+ */
+
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "lukip_allocator.h"
+#include "lukip_dynamic_array.h"
+#include "lukip_parallel.h"
+#include "lukip_params.h"
+#include "lukip_platform.h"
+
+#ifdef LKP_POSIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/** Bytes of the file in each chunk the threads claim, rounded down to whole records. */
+#define CHUNK_SIZE (1 << 20)
+
+/** Most failing rows that get reported one by one, where the rest are only counted. */
+#define MAX_REPORTED_ROWS 100
+
+/** Most characters of a CSV row that get written into its failure. */
+#define MAX_ROW_TEXT 64
+
+/** Most bytes of a binary record that get written into its failure. */
+#define MAX_RECORD_BYTES 16
+
+/** Length of the buffer a field gets copied into to be parsed as a number. */
+#define NUMBER_LENGTH 64
+
+/** A file that's either mapped, or read into memory on platforms without mmap(). */
+typedef struct {
+    const char *data;
+    size_t size;
+} LoadedFile;
+
+/** The chunks of a file which every thread takes the next one out of. */
+typedef struct {
+    LkpParamFunc func;
+    LoadedFile file;
+    size_t recordSize; /** 0 for CSV files. */
+    size_t usedSize; /** The size without a trailing partial record. */
+    size_t chunkSize;
+    long long chunks;
+    long long *chunkRows; /** How many rows each chunk had, so they can get their file index. */
+    long long deadline; /** When to stop claiming chunks in milliseconds, or 0 for never. */
+    atomic_llong nextChunk;
+    atomic_bool timedOut;
+} ChunkQueue;
+
+/** What a single thread went through while running chunks. */
+typedef struct {
+    ChunkQueue *queue;
+    LkpFuncInfo info;
+    long long asserts;
+    long long rowsRun;
+    long long rowsFailed;
+    LkpRowFailureArray failures; /** The thread's first failures, which are its lowest rows. */
+} Worker;
+
+/** Returns the current time in milliseconds. */
+static long long now_ms() {
+    struct timespec now;
+    timespec_get(&now, TIME_UTC);
+    return now.tv_sec * 1000LL + now.tv_nsec / 1000000;
+}
+
+#ifdef LKP_POSIX
+
+/** Maps the file, so only the pages currently being read take memory. Returns an error or NULL. */
+static char *load_file(const char *path, LoadedFile *file) {
+    file->data = NULL;
+    file->size = 0;
+    const int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        return lkp_strf_alloc("Couldn't open \"%s\": %s.", path, strerror(errno));
+    }
+    struct stat info;
+    if (fstat(fd, &info) == -1) {
+        close(fd);
+        return lkp_strf_alloc("Couldn't get the size of \"%s\": %s.", path, strerror(errno));
+    }
+    if (info.st_size > 0) {
+        void *data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            close(fd);
+            return lkp_strf_alloc("Couldn't map \"%s\": %s.", path, strerror(errno));
+        }
+        posix_madvise(data, (size_t)info.st_size, POSIX_MADV_SEQUENTIAL);
+        file->data = data;
+        file->size = (size_t)info.st_size;
+    }
+    close(fd);
+    return NULL;
+}
+
+/** Unmaps a loaded file. */
+static void unload_file(LoadedFile *file) {
+    if (file->data != NULL) {
+        munmap((void *)file->data, file->size);
+    }
+}
+
+#else
+
+/** Reads the whole file, since there's no mmap() to use. Returns an error or NULL. */
+static char *load_file(const char *path, LoadedFile *file) {
+    file->data = NULL;
+    file->size = 0;
+    FILE *stream = fopen(path, "rb");
+    if (stream == NULL) {
+        return lkp_strf_alloc("Couldn't open \"%s\".", path);
+    }
+    fseek(stream, 0, SEEK_END);
+    const long size = ftell(stream);
+    fseek(stream, 0, SEEK_SET);
+    char *data = size > 0 ? malloc((size_t)size) : NULL;
+    if (size > 0 && (data == NULL || fread(data, 1, (size_t)size, stream) != (size_t)size)) {
+        free(data);
+        fclose(stream);
+        return lkp_strf_alloc("Couldn't read \"%s\".", path);
+    }
+    fclose(stream);
+    file->data = data;
+    file->size = size > 0 ? (size_t)size : 0;
+    return NULL;
+}
+
+/** Frees a loaded file. */
+static void unload_file(LoadedFile *file) {
+    free((char *)file->data);
+}
+
+#endif
+
+/**
+ * @brief Runs the test on one row, with its asserts going into the passed sink.
+ * 
+ * @return Whether the row failed, in which case the sink's message has to be freed.
+ */
+static bool run_row(const LkpParamFunc func, const LkpRow *row, LkpCaseSink *sink) {
+    LkpJumpBuf jump;
+    sink->info.status = LKP_TEST_UNKNOWN;
+    sink->info.fileName = NULL;
+    sink->info.funcName = NULL;
+    sink->asserts = 0;
+    sink->message = NULL;
+    sink->line = 0;
+    sink->jump = &jump;
+
+    lkp_set_case_sink(sink);
+    if (LKP_SETJMP(jump) == 0) {
+        func(row);
+    }
+    lkp_set_case_sink(NULL);
+    return sink->message != NULL;
+}
+
+/** Returns an allocated copy of the start of a row, to show which one failed. */
+static char *describe_row(const LkpRow *row, const bool isCsv) {
+    if (isCsv) {
+        const int length = row->size > MAX_ROW_TEXT ? MAX_ROW_TEXT : (int)row->size;
+        return lkp_strf_alloc(
+            "\"%.*s%s\"", length, row->data, row->size > MAX_ROW_TEXT ? "..." : ""
+        );
+    }
+    char text[MAX_RECORD_BYTES * 3 + 8];
+    int written = snprintf(text, sizeof(text), "{");
+    for (size_t i = 0; i < row->size && i < MAX_RECORD_BYTES; i++) {
+        written += snprintf(
+            text + written, sizeof(text) - written, i == 0 ? "%02x" : " %02x",
+            (unsigned char)row->data[i]
+        );
+    }
+    snprintf(
+        text + written, sizeof(text) - written, "%s}", row->size > MAX_RECORD_BYTES ? " ..." : ""
+    );
+    return lkp_strf_alloc("%s", text);
+}
+
+/** Runs one row of a chunk, and keeps its failure if the thread hasn't kept enough of them. */
+static void test_row(Worker *worker, const long long chunk, const long long index, LkpRow *row) {
+    LkpCaseSink sink;
+    const bool failed = run_row(worker->queue->func, row, &sink);
+    worker->asserts += sink.asserts;
+    worker->rowsRun++;
+    if (worker->info.fileName == NULL) {
+        worker->info = sink.info;
+    }
+    if (!failed) {
+        return;
+    }
+    worker->rowsFailed++;
+    if (worker->failures.length >= MAX_REPORTED_ROWS) {
+        free(sink.message);
+        return;
+    }
+    sink.jump = NULL;
+    const LkpRowFailure failure = {
+        .chunk = chunk, .row = index, .failure = sink,
+        .text = describe_row(row, worker->queue->recordSize == 0)
+    };
+    LKP_APPEND_DA(&worker->failures, failure);
+}
+
+/** Splits a CSV row on commas, where a field in double quotes can have commas inside of it. */
+static void split_fields(LkpRow *row) {
+    const char *current = row->data;
+    const char *end = row->data + row->size;
+    row->fieldCount = 0;
+    while (true) {
+        LkpField *field = &row->fields[row->fieldCount++];
+        const char *closingQuote = NULL;
+        if (current < end && *current == '"') {
+            closingQuote = memchr(current + 1, '"', end - current - 1);
+        }
+        const char *searchFrom = closingQuote != NULL ? closingQuote : current;
+        const char *comma = row->fieldCount == LKP_MAX_FIELDS
+            ? NULL : memchr(searchFrom, ',', end - searchFrom);
+        if (closingQuote != NULL) {
+            field->start = current + 1;
+            field->length = (int)(closingQuote - current - 1);
+        } else {
+            field->start = current;
+            field->length = (int)((comma != NULL ? comma : end) - current);
+        }
+        if (comma == NULL) {
+            return;
+        }
+        current = comma + 1;
+    }
+}
+
+/**
+ * @brief Runs the rows which start inside of a CSV chunk.
+ * 
+ * Chunks are cut at fixed offsets, so a row belongs to the chunk its first character is in,
+ * and may end in the next one. Empty lines and ones starting with '#' aren't rows.
+ */
+static void run_csv_chunk(Worker *worker, const long long chunk) {
+    const ChunkQueue *queue = worker->queue;
+    const char *data = queue->file.data;
+    const size_t size = queue->file.size;
+    size_t position = (size_t)chunk * queue->chunkSize;
+    const size_t end = position + queue->chunkSize < size ? position + queue->chunkSize : size;
+    if (position > 0 && data[position - 1] != '\n') {
+        const char *newline = memchr(data + position, '\n', size - position);
+        position = newline != NULL ? (size_t)(newline - data) + 1 : size;
+    }
+
+    LkpRow row;
+    long long rows = 0;
+    while (position < end) {
+        const char *newline = memchr(data + position, '\n', size - position);
+        const size_t lineEnd = newline != NULL ? (size_t)(newline - data) : size;
+        size_t length = lineEnd - position;
+        if (length > 0 && data[position + length - 1] == '\r') {
+            length--;
+        }
+        if (length > 0 && data[position] != '#') {
+            row.data = data + position;
+            row.size = length;
+            split_fields(&row);
+            test_row(worker, chunk, rows++, &row);
+        }
+        position = lineEnd + 1;
+    }
+    queue->chunkRows[chunk] = rows;
+}
+
+/** Runs every record of a binary chunk, which always holds whole records. */
+static void run_binary_chunk(Worker *worker, const long long chunk) {
+    const ChunkQueue *queue = worker->queue;
+    const size_t start = (size_t)chunk * queue->chunkSize;
+    const size_t end = start + queue->chunkSize < queue->usedSize
+        ? start + queue->chunkSize : queue->usedSize;
+
+    LkpRow row;
+    row.fieldCount = 0;
+    row.size = queue->recordSize;
+    long long rows = 0;
+    for (size_t offset = start; offset < end; offset += queue->recordSize) {
+        row.data = queue->file.data + offset;
+        test_row(worker, chunk, rows++, &row);
+    }
+    queue->chunkRows[chunk] = rows;
+}
+
+/**
+ * @brief Keeps claiming the next chunk until they run out or the timeout passes.
+ * 
+ * The timeout is only checked before claiming, so the claimed chunks are always a prefix
+ * of the file where every row got run, which keeps the row indices right.
+ */
+static void *run_chunks(void *workerArg) {
+    Worker *worker = workerArg;
+    ChunkQueue *queue = worker->queue;
+    while (true) {
+        if (queue->deadline != 0 && now_ms() >= queue->deadline) {
+            atomic_store(&queue->timedOut, true);
+            break;
+        }
+        const long long chunk = atomic_fetch_add(&queue->nextChunk, 1);
+        if (chunk >= queue->chunks) {
+            break;
+        }
+        if (queue->recordSize == 0) {
+            run_csv_chunk(worker, chunk);
+        } else {
+            run_binary_chunk(worker, chunk);
+        }
+    }
+    return NULL;
+}
+
+/** Orders failures by their chunk, then by their row inside of it. */
+static int compare_failures(const void *left, const void *right) {
+    const LkpRowFailure *leftFailure = left;
+    const LkpRowFailure *rightFailure = right;
+    if (leftFailure->chunk != rightFailure->chunk) {
+        return leftFailure->chunk < rightFailure->chunk ? -1 : 1;
+    }
+    if (leftFailure->row != rightFailure->row) {
+        return leftFailure->row < rightFailure->row ? -1 : 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Merges the failures of every thread into the first ones of the whole file.
+ * 
+ * Each thread claims chunks in increasing order, so the lowest failing rows of the file
+ * are always among the first ones every thread kept. Their index in the file is then the
+ * amount of rows in the chunks before theirs, plus their index inside of their own chunk.
+ */
+static void merge_failures(
+    Worker *workers, const int threads, ChunkQueue *queue, LkpParamResult *result
+) {
+    for (int i = 0; i < threads; i++) {
+        for (int j = 0; j < workers[i].failures.length; j++) {
+            LKP_APPEND_DA(&result->failures, workers[i].failures.data[j]);
+        }
+        LKP_FREE_DA(&workers[i].failures);
+    }
+    if (result->failures.length == 0) {
+        return;
+    }
+    qsort(
+        result->failures.data, result->failures.length, sizeof(LkpRowFailure), compare_failures
+    );
+    while (result->failures.length > MAX_REPORTED_ROWS) {
+        LkpRowFailure *extra = &result->failures.data[--result->failures.length];
+        free(extra->failure.message);
+        free(extra->text);
+    }
+
+    long long rowsBefore = 0;
+    for (long long chunk = 0; chunk < queue->chunks; chunk++) {
+        const long long rows = queue->chunkRows[chunk];
+        queue->chunkRows[chunk] = rowsBefore;
+        rowsBefore += rows;
+    }
+    for (int i = 0; i < result->failures.length; i++) {
+        LkpRowFailure *failure = &result->failures.data[i];
+        failure->row += queue->chunkRows[failure->chunk];
+    }
+}
+
+/** Loads the file, runs its chunks on every thread, then merges what each one went through. */
+void lkp_run_param_test(
+    const LkpParamFunc func, const char *path, const size_t recordSize, const int jobs,
+    const int timeout, LkpParamResult *result
+) {
+    result->info.status = LKP_TEST_UNKNOWN;
+    result->info.fileName = NULL;
+    result->info.funcName = NULL;
+    result->asserts = 0;
+    result->rowsRun = 0;
+    result->rowsFailed = 0;
+    result->timedOut = false;
+    LKP_INIT_DA(&result->failures);
+
+    ChunkQueue queue = {
+        .func = func, .recordSize = recordSize,
+        .deadline = timeout > 0 ? now_ms() + timeout : 0
+    };
+    result->error = load_file(path, &queue.file);
+    if (result->error != NULL) {
+        return;
+    }
+    queue.usedSize = queue.file.size;
+    queue.chunkSize = CHUNK_SIZE;
+    if (recordSize != 0) {
+        queue.usedSize -= queue.file.size % recordSize;
+        queue.chunkSize = (CHUNK_SIZE / recordSize > 0 ? CHUNK_SIZE / recordSize : 1) * recordSize;
+        if (queue.usedSize != queue.file.size) {
+            result->error = lkp_strf_alloc(
+                "\"%s\" ends with a partial record (%zu bytes of %zu).",
+                path, queue.file.size - queue.usedSize, recordSize
+            );
+        }
+    }
+    queue.chunks = (long long)((queue.usedSize + queue.chunkSize - 1) / queue.chunkSize);
+    queue.chunkRows = lkp_allocate(queue.chunks > 0 ? (int)queue.chunks : 1, sizeof(long long));
+    memset(queue.chunkRows, 0, (queue.chunks > 0 ? queue.chunks : 1) * sizeof(long long));
+    atomic_init(&queue.nextChunk, 0);
+    atomic_init(&queue.timedOut, false);
+
+    int threads = jobs > 0 ? jobs : lkp_default_jobs();
+    threads = threads < queue.chunks ? threads : (queue.chunks > 0 ? (int)queue.chunks : 1);
+    Worker *workers = lkp_allocate(threads, sizeof(Worker));
+    for (int i = 0; i < threads; i++) {
+        workers[i] = (Worker){.queue = &queue, .asserts = 0, .rowsRun = 0, .rowsFailed = 0};
+        workers[i].info = result->info;
+        LKP_INIT_DA(&workers[i].failures);
+    }
+    lkp_run_parallel(run_chunks, workers, threads, sizeof(Worker));
+
+    for (int i = 0; i < threads; i++) {
+        result->asserts += workers[i].asserts;
+        result->rowsRun += workers[i].rowsRun;
+        result->rowsFailed += workers[i].rowsFailed;
+        if (result->info.fileName == NULL) {
+            result->info = workers[i].info;
+        }
+    }
+    merge_failures(workers, threads, &queue, result);
+    result->timedOut = atomic_load(&queue.timedOut);
+    free(workers);
+    free(queue.chunkRows);
+    unload_file(&queue.file);
+}
+
+/** Returns how many fields a CSV row has. */
+int lkp_row_fields(const LkpRow *row) {
+    return row->fieldCount;
+}
+
+/** Copies the field, failing the row if it's missing or too long. */
+int lkp_row_string(
+    const LkpRow *row, const int field, char *buffer, const int size, const LkpLineInfo info
+) {
+    if (field < 0 || field >= row->fieldCount) {
+        lkp_raise_assert(
+            LKP_RAISE_FAIL, info, "Row has no field %d (it has %d).", field, row->fieldCount
+        );
+        return -1;
+    }
+    const LkpField *source = &row->fields[field];
+    if (source->length >= size) {
+        lkp_raise_assert(
+            LKP_RAISE_FAIL, info, "Field %d is %d long, which doesn't fit in %d.",
+            field, source->length, size
+        );
+        return -1;
+    }
+    memcpy(buffer, source->start, source->length);
+    buffer[source->length] = '\0';
+    return source->length;
+}
+
+/** Returns whether the parse stopped at the end of the number, with only spaces after it. */
+static bool parsed_whole(const char *end) {
+    while (*end == ' ') {
+        end++;
+    }
+    return *end == '\0';
+}
+
+/** Parses the field in base 10, since leading zeroes in tables aren't meant to be octal. */
+LkpInt lkp_row_int(const LkpRow *row, const int field, const LkpLineInfo info) {
+    char number[NUMBER_LENGTH];
+    if (lkp_row_string(row, field, number, NUMBER_LENGTH, info) == -1) {
+        return 0;
+    }
+    char *end;
+    errno = 0;
+    const long long value = strtoll(number, &end, 10);
+    if (end == number || !parsed_whole(end) || errno == ERANGE) {
+        lkp_raise_assert(
+            LKP_RAISE_FAIL, info, "Field %d (\"%s\") isn't an integer.", field, number
+        );
+        return 0;
+    }
+    return (LkpInt)value;
+}
+
+/** Parses the field as a double. */
+LkpFloat lkp_row_float(const LkpRow *row, const int field, const LkpLineInfo info) {
+    char number[NUMBER_LENGTH];
+    if (lkp_row_string(row, field, number, NUMBER_LENGTH, info) == -1) {
+        return 0;
+    }
+    char *end;
+    const double value = strtod(number, &end);
+    if (end == number || !parsed_whole(end)) {
+        lkp_raise_assert(LKP_RAISE_FAIL, info, "Field %d (\"%s\") isn't a float.", field, number);
+        return 0;
+    }
+    return (LkpFloat)value;
+}
+
+/** Returns the record, which is only NULL when it failed for being the wrong size. */
+const void *lkp_row_record(const LkpRow *row, const size_t size, const LkpLineInfo info) {
+    if (row->fieldCount != 0 || row->size != size) {
+        lkp_raise_assert(
+            LKP_RAISE_FAIL, info, "Row is %zu bytes, not a record of %zu.", row->size, size
+        );
+        return NULL;
+    }
+    return row->data;
+}
+
+/** Frees the error and failures of a parameterized test's result. */
+void lkp_free_param_result(LkpParamResult *result) {
+    free(result->error);
+    for (int i = 0; i < result->failures.length; i++) {
+        free(result->failures.data[i].failure.message);
+        free(result->failures.data[i].text);
+    }
+    LKP_FREE_DA(&result->failures);
+}
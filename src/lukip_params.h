@@ -0,0 +1,83 @@
+/**
+ * @file lukip_params.h
+ * @brief Header for parameterized tests, whose rows are streamed out of CSV or binary files.
+ * 
+ * @author Larmix
+ */
+
+#ifndef LUKIP_PARAMS_H
+#define LUKIP_PARAMS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "lukip_assert.h"
+#include "lukip_dynamic_array.h"
+
+/** Most fields a CSV row is split into, where the rest stay in the last one. */
+#define LKP_MAX_FIELDS 32
+
+/** A field of a CSV row, which points into the file so it isn't NUL terminated. */
+typedef struct {
+    const char *start;
+    int length;
+} LkpField;
+
+/**
+ * @brief A single row of a parameterized test's file.
+ * 
+ * Rows point straight into the (mapped) file instead of being copied out of it,
+ * so they're only valid while the row's test is running.
+ */
+struct LkpRow {
+    const char *data; /** The row's line without its newline, or its record in binary files. */
+    size_t size;
+    int fieldCount; /** Always 0 in binary files. */
+    LkpField fields[LKP_MAX_FIELDS];
+};
+
+/** A row which failed, where it's kept as the chunk and the row inside of it until the end. */
+typedef struct {
+    long long chunk;
+    long long row; /** Inside of its chunk, then the index in the whole file once it's merged. */
+    LkpCaseSink failure;
+    char *text; /** The start of the row's text (or bytes in hex), allocated. */
+} LkpRowFailure;
+
+/** Failing rows of a parameterized test. */
+LKP_DECLARE_DA_STRUCT(LkpRowFailureArray, LkpRowFailure);
+
+/** What came out of running a parameterized test over its file. */
+typedef struct {
+    LkpFuncInfo info; /** Where the first assert was called from. */
+    long long asserts; /** Asserts of every row which ran. */
+    long long rowsRun;
+    long long rowsFailed; /** Every failed row, including the ones past the reported failures. */
+    bool timedOut; /** Whether the rows stopped early because the timeout passed. */
+    char *error; /** Why the file couldn't be (fully) used, allocated, or NULL. */
+    LkpRowFailureArray failures; /** The first failing rows in order, up to a limit. */
+} LkpParamResult;
+
+/**
+ * @brief Runs a parameterized test on every row of a file, on several threads.
+ * 
+ * The file is mapped (on POSIX) and split into fixed chunks, which the threads keep claiming
+ * until they run out. Nothing is kept per row, only per chunk, so a table of any size
+ * runs in the same memory besides the failures that are reported.
+ * 
+ * @param func The parameterized test.
+ * @param path The file of the rows.
+ * @param recordSize The size of each record in a binary file, or 0 if the file is a CSV.
+ * @param jobs How many threads to use, where 0 is one per core.
+ * @param timeout Milliseconds to stop running rows after, or 0 for no limit.
+ * @param[out] result The results, which have to be freed with lkp_free_param_result().
+ */
+void lkp_run_param_test(
+    const LkpParamFunc func, const char *path, const size_t recordSize, const int jobs,
+    const int timeout, LkpParamResult *result
+);
+
+/** Frees the error and failures of a parameterized test's result. */
+void lkp_free_param_result(LkpParamResult *result);
+
+#endif
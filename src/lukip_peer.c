@@ -0,0 +1,448 @@
+/**
+ * @file lukip_peer.c
+ * @brief Scripted peers running over socketpairs or loopback TCP connections.
+ * 
+ * Every wait of the peer's thread polls its socket along with a pipe lkp_stop_peer() writes to,
+ * so stopping never hangs on a client that's gone quiet, while steps which don't depend
+ * on the client still finish deterministically. Delays use poll() instead of sleeping,
+ * so the virtual clock never holds up a peer.
+ * 
+ * @author Larmix
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lukip_allocator.h"
+#include "lukip_assert.h"
+#include "lukip_dynamic_array.h"
+#include "lukip_peer.h"
+#include "lukip_platform.h"
+
+#ifdef LKP_POSIX
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/** Longest part of some unexpected bytes that gets shown in an error. */
+#define SHOWN_BYTES 64
+
+/** What a step of a peer's script does. */
+typedef enum {
+    STEP_EXPECT,
+    STEP_SEND,
+    STEP_DELAY,
+    STEP_CLOSE,
+    STEP_RESET
+} StepKind;
+
+/** One step of a peer's script. */
+typedef struct {
+    StepKind kind;
+    char *data; /** Allocated bytes to expect or send. */
+    size_t size;
+    int latency; /** Milliseconds before each fragment of a send, or the length of a delay. */
+    size_t fragment; /** Most bytes per write of a send, or 0 for all of them at once. */
+} Step;
+
+LKP_DECLARE_DA_STRUCT(StepArray, Step);
+
+struct LkpPeer {
+    LkpPeerKind kind;
+    StepArray steps;
+    int latency; /** Applied to the sends added from now on. */
+    size_t fragment; /** Applied to the sends added from now on. */
+    int fd; /** The peer's end of the connection, or -1 before a TCP client connected. */
+    int clientFd; /** The test's end of a socketpair, or -1. */
+    int listener; /** The listening socket of a TCP peer, or -1. */
+    int port;
+    int stopPipe[2]; /** Written to when the peer is being stopped. */
+    bool started;
+    pthread_t thread;
+    char *error; /** The first failure of the script, allocated. */
+};
+
+/** Records the peer's error, keeping only the first one. */
+static void peer_error(LkpPeer *peer, char *error) {
+    if (peer->error == NULL) {
+        peer->error = error;
+    } else {
+        free(error);
+    }
+}
+
+/**
+ * @brief Waits until the socket is ready for the events, or the peer is being stopped.
+ * 
+ * @return Whether the socket is ready. Readiness wins when both happened.
+ */
+static bool wait_for(LkpPeer *peer, const int fd, const short events) {
+    struct pollfd fds[2] = {
+        {.fd = fd, .events = events}, {.fd = peer->stopPipe[0], .events = POLLIN}
+    };
+    while (true) {
+        if (poll(fds, 2, -1) == -1 && errno != EINTR) {
+            return false;
+        }
+        if (fds[0].revents != 0) {
+            return true;
+        }
+        if (fds[1].revents != 0) {
+            return false;
+        }
+    }
+}
+
+/** Accepts the one client of a TCP peer, returning whether it connected. */
+static bool accept_client(LkpPeer *peer) {
+    if (!wait_for(peer, peer->listener, POLLIN)) {
+        peer_error(
+            peer, lkp_strf_alloc("Stopped before a client connected to port %d.", peer->port)
+        );
+        return false;
+    }
+    peer->fd = accept(peer->listener, NULL, NULL);
+    if (peer->fd == -1) {
+        peer_error(peer, lkp_strf_alloc("Couldn't accept a client: %s.", strerror(errno)));
+        return false;
+    }
+    const int noDelay = 1;
+    setsockopt(peer->fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    return true;
+}
+
+/** Reads exactly the step's bytes from the client, returning whether they matched. */
+static bool run_expect(LkpPeer *peer, const Step *step) {
+    char *received = lkp_allocate(step->size + 1, sizeof(char));
+    size_t amount = 0;
+    bool stopped = false;
+    while (amount < step->size) {
+        if (!wait_for(peer, peer->fd, POLLIN)) {
+            stopped = true;
+            break;
+        }
+        const ssize_t result = recv(peer->fd, received + amount, step->size - amount, 0);
+        if (result == -1 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            break;
+        }
+        amount += (size_t)result;
+    }
+    const bool matched = amount == step->size && memcmp(received, step->data, step->size) == 0;
+    if (!matched) {
+        char *expected = lkp_escape_bytes(step->data, step->size, SHOWN_BYTES);
+        char *got = lkp_escape_bytes(received, amount, SHOWN_BYTES);
+        const char *cutShort = stopped ? " before the peer was stopped" : " before it disconnected";
+        peer_error(peer, lkp_strf_alloc(
+            "Expected \"%s\" from the client, got \"%s\"%s.", expected, got,
+            amount < step->size ? cutShort : ""
+        ));
+        free(expected);
+        free(got);
+    }
+    free(received);
+    return matched;
+}
+
+/** Sends the step's bytes in fragments, waiting the latency before each one. */
+static bool run_send(LkpPeer *peer, const Step *step) {
+    size_t sent = 0;
+    while (sent < step->size) {
+        if (step->latency > 0) {
+            poll(NULL, 0, step->latency);
+        }
+        size_t fragment = step->size - sent;
+        if (step->fragment != 0 && fragment > step->fragment) {
+            fragment = step->fragment;
+        }
+        const size_t fragmentEnd = sent + fragment;
+        while (sent < fragmentEnd) {
+            if (!wait_for(peer, peer->fd, POLLOUT)) {
+                peer_error(peer, lkp_strf_alloc(
+                    "Stopped after sending %zu of %zu bytes to the client.", sent, step->size
+                ));
+                return false;
+            }
+            // Without blocking, so a client that stops reading can't keep the peer from stopping.
+            const ssize_t result = send(
+                peer->fd, step->data + sent, fragmentEnd - sent, MSG_NOSIGNAL | MSG_DONTWAIT
+            );
+            if (result == -1 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) {
+                continue;
+            }
+            if (result <= 0) {
+                peer_error(peer, lkp_strf_alloc(
+                    "Couldn't send to the client after %zu of %zu bytes.", sent, step->size
+                ));
+                return false;
+            }
+            sent += (size_t)result;
+        }
+    }
+    return true;
+}
+
+/** Ends the connection, with a reset making TCP send RST instead of FIN. */
+static void run_close(LkpPeer *peer, const bool reset) {
+    if (reset && peer->kind == LKP_PEER_TCP) {
+        const struct linger linger = {.l_onoff = 1, .l_linger = 0};
+        setsockopt(peer->fd, SOL_SOCKET, SO_LINGER, &linger, sizeof(linger));
+    }
+    close(peer->fd);
+    peer->fd = -1;
+}
+
+/** Runs the peer's script until it ends or a step fails. */
+static void *run_script(void *peerArg) {
+    LkpPeer *peer = peerArg;
+    if (peer->kind == LKP_PEER_TCP && !accept_client(peer)) {
+        return NULL;
+    }
+    for (int i = 0; i < peer->steps.length; i++) {
+        const Step *step = &peer->steps.data[i];
+        bool succeeded = true;
+        switch (step->kind) {
+        case STEP_EXPECT: succeeded = run_expect(peer, step); break;
+        case STEP_SEND: succeeded = run_send(peer, step); break;
+        case STEP_DELAY: poll(NULL, 0, step->latency); break;
+        case STEP_CLOSE: run_close(peer, false); return NULL;
+        case STEP_RESET: run_close(peer, true); return NULL;
+        }
+        if (!succeeded) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+/** Makes the listening socket of a TCP peer on an ephemeral port of 127.0.0.1. */
+static bool listen_on_loopback(LkpPeer *peer) {
+    peer->listener = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (peer->listener == -1) {
+        return false;
+    }
+    struct sockaddr_in address = {.sin_family = AF_INET, .sin_port = 0};
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    if (bind(peer->listener, (struct sockaddr *)&address, sizeof(address)) == -1
+        || listen(peer->listener, 1) == -1
+        || getsockname(peer->listener, (struct sockaddr *)&address, &length) == -1) {
+        close(peer->listener);
+        return false;
+    }
+    peer->port = ntohs(address.sin_port);
+    return true;
+}
+
+/** Makes the peer's sockets, so the test can reach it before it starts. */
+LkpPeer *lkp_create_peer(const LkpPeerKind kind) {
+    LkpPeer *peer = lkp_allocate(1, sizeof(LkpPeer));
+    *peer = (LkpPeer){
+        .kind = kind, .latency = 0, .fragment = 0, .fd = -1, .clientFd = -1, .listener = -1,
+        .port = -1, .started = false, .error = NULL
+    };
+    LKP_INIT_DA(&peer->steps);
+    if (pipe(peer->stopPipe) == -1) {
+        free(peer);
+        return NULL;
+    }
+    int pair[2];
+    const bool connected = kind == LKP_PEER_TCP
+        ? listen_on_loopback(peer) : socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, pair) == 0;
+    if (!connected) {
+        close(peer->stopPipe[0]);
+        close(peer->stopPipe[1]);
+        free(peer);
+        return NULL;
+    }
+    if (kind == LKP_PEER_SOCKETPAIR) {
+        peer->fd = pair[0];
+        peer->clientFd = pair[1];
+    }
+    return peer;
+}
+
+/** Appends a step to the peer's script, copying its bytes. */
+static void add_step(LkpPeer *peer, const StepKind kind, const void *data, const size_t size) {
+    Step step = {
+        .kind = kind, .data = NULL, .size = size, .latency = peer->latency,
+        .fragment = peer->fragment
+    };
+    if (size > 0) {
+        step.data = lkp_allocate(size, sizeof(char));
+        memcpy(step.data, data, size);
+    }
+    LKP_APPEND_DA(&peer->steps, step);
+}
+
+/** Adds a step waiting for exact bytes from the client. */
+void lkp_peer_expect(LkpPeer *peer, const void *data, const size_t size) {
+    if (peer != NULL) {
+        add_step(peer, STEP_EXPECT, data, size);
+    }
+}
+
+/** Adds a step sending bytes to the client. */
+void lkp_peer_send(LkpPeer *peer, const void *data, const size_t size) {
+    if (peer != NULL) {
+        add_step(peer, STEP_SEND, data, size);
+    }
+}
+
+/** Adds a step doing nothing for a while. */
+void lkp_peer_delay(LkpPeer *peer, const int milliseconds) {
+    if (peer != NULL) {
+        add_step(peer, STEP_DELAY, NULL, 0);
+        peer->steps.data[peer->steps.length - 1].latency = milliseconds;
+    }
+}
+
+/** Adds a step ending the connection. */
+void lkp_peer_close(LkpPeer *peer, const bool reset) {
+    if (peer != NULL) {
+        add_step(peer, reset ? STEP_RESET : STEP_CLOSE, NULL, 0);
+    }
+}
+
+/** Sets the latency of the sends added from now on. */
+void lkp_peer_latency(LkpPeer *peer, const int milliseconds) {
+    if (peer != NULL) {
+        peer->latency = milliseconds > 0 ? milliseconds : 0;
+    }
+}
+
+/** Sets the fragment size of the sends added from now on. */
+void lkp_peer_fragment(LkpPeer *peer, const size_t bytes) {
+    if (peer != NULL) {
+        peer->fragment = bytes;
+    }
+}
+
+/** Starts the peer's thread. */
+bool lkp_start_peer(LkpPeer *peer) {
+    if (peer == NULL || peer->started) {
+        return peer != NULL;
+    }
+    peer->started = pthread_create(&peer->thread, NULL, run_script, peer) == 0;
+    return peer->started;
+}
+
+/** Returns the test's end of a socketpair. */
+int lkp_peer_fd(const LkpPeer *peer) {
+    return peer != NULL ? peer->clientFd : -1;
+}
+
+/** Returns the port of a TCP peer. */
+int lkp_peer_port(const LkpPeer *peer) {
+    return peer != NULL ? peer->port : -1;
+}
+
+/** Stops the peer's thread (if it ran), reporting steps it never got to. */
+char *lkp_stop_peer(LkpPeer *peer) {
+    if (peer == NULL) {
+        return NULL;
+    }
+    if (peer->started) {
+        const ssize_t written = write(peer->stopPipe[1], "", 1);
+        (void)written;
+        pthread_join(peer->thread, NULL);
+    } else if (peer->steps.length > 0) {
+        peer_error(peer, lkp_strf_alloc("Stopped without ever being started."));
+    }
+    if (peer->fd != -1) {
+        close(peer->fd);
+    }
+    if (peer->listener != -1) {
+        close(peer->listener);
+    }
+    close(peer->stopPipe[0]);
+    close(peer->stopPipe[1]);
+    for (int i = 0; i < peer->steps.length; i++) {
+        free(peer->steps.data[i].data);
+    }
+    LKP_FREE_DA(&peer->steps);
+    char *error = peer->error;
+    free(peer);
+    return error;
+}
+
+#else
+
+/** Peers need POSIX sockets and threads. */
+LkpPeer *lkp_create_peer(const LkpPeerKind kind) {
+    (void)kind;
+    return NULL;
+}
+
+/** Does nothing, since there's never a peer. */
+void lkp_peer_expect(LkpPeer *peer, const void *data, const size_t size) {
+    (void)peer;
+    (void)data;
+    (void)size;
+}
+
+/** Does nothing, since there's never a peer. */
+void lkp_peer_send(LkpPeer *peer, const void *data, const size_t size) {
+    (void)peer;
+    (void)data;
+    (void)size;
+}
+
+/** Does nothing, since there's never a peer. */
+void lkp_peer_delay(LkpPeer *peer, const int milliseconds) {
+    (void)peer;
+    (void)milliseconds;
+}
+
+/** Does nothing, since there's never a peer. */
+void lkp_peer_close(LkpPeer *peer, const bool reset) {
+    (void)peer;
+    (void)reset;
+}
+
+/** Does nothing, since there's never a peer. */
+void lkp_peer_latency(LkpPeer *peer, const int milliseconds) {
+    (void)peer;
+    (void)milliseconds;
+}
+
+/** Does nothing, since there's never a peer. */
+void lkp_peer_fragment(LkpPeer *peer, const size_t bytes) {
+    (void)peer;
+    (void)bytes;
+}
+
+/** There's never a peer to start. */
+bool lkp_start_peer(LkpPeer *peer) {
+    (void)peer;
+    return false;
+}
+
+/** There's never a socket. */
+int lkp_peer_fd(const LkpPeer *peer) {
+    (void)peer;
+    return -1;
+}
+
+/** There's never a port. */
+int lkp_peer_port(const LkpPeer *peer) {
+    (void)peer;
+    return -1;
+}
+
+/** There's never a peer to stop. */
+char *lkp_stop_peer(LkpPeer *peer) {
+    (void)peer;
+    return NULL;
+}
+
+#endif
@@ -0,0 +1,80 @@
+/**
+ * @file lukip_peer.h
+ * @brief Header for scripted peers, which stand in for network services inside of the test process.
+ * 
+ * A peer runs its script on its own thread, over a socketpair or a TCP connection on 127.0.0.1.
+ * Only available on POSIX platforms.
+ * 
+ * @author Larmix
+ */
+
+#ifndef LUKIP_PEER_H
+#define LUKIP_PEER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/** How the code under test reaches a peer. */
+typedef enum {
+    LKP_PEER_SOCKETPAIR, /** Through a connected socket handed to the test. */
+    LKP_PEER_TCP /** By connecting to 127.0.0.1 on the peer's port. */
+} LkpPeerKind;
+
+/** A scripted peer, which is only used through pointers. */
+typedef struct LkpPeer LkpPeer;
+
+/**
+ * @brief Makes a peer with an empty script, which only starts running it in lkp_start_peer().
+ * 
+ * @param kind How the code under test reaches it.
+ * 
+ * @return The peer to be freed with lkp_stop_peer(), or NULL if it couldn't make its sockets.
+ */
+LkpPeer *lkp_create_peer(const LkpPeerKind kind);
+
+/** Adds a step that waits for the client to send exactly these bytes. */
+void lkp_peer_expect(LkpPeer *peer, const void *data, const size_t size);
+
+/** Adds a step that sends bytes to the client, with the current latency and fragment size. */
+void lkp_peer_send(LkpPeer *peer, const void *data, const size_t size);
+
+/** Adds a step that does nothing for some milliseconds. */
+void lkp_peer_delay(LkpPeer *peer, const int milliseconds);
+
+/**
+ * @brief Adds a step that ends the connection, which also ends the script.
+ * 
+ * @param peer The peer.
+ * @param reset Whether to reset the connection (RST on TCP) instead of closing it gracefully.
+ *     On a socketpair a reset is a close, which reads as ECONNRESET if the peer had unread data.
+ */
+void lkp_peer_close(LkpPeer *peer, const bool reset);
+
+/** Waits this many milliseconds before each fragment of the sends added after it. */
+void lkp_peer_latency(LkpPeer *peer, const int milliseconds);
+
+/** Splits the sends added after it into separate writes of at most this many bytes (0 for none). */
+void lkp_peer_fragment(LkpPeer *peer, const size_t bytes);
+
+/** Starts running the script on its own thread, returning whether the thread started. */
+bool lkp_start_peer(LkpPeer *peer);
+
+/** Returns the test's end of a socketpair peer (which the test closes), or -1 for TCP ones. */
+int lkp_peer_fd(const LkpPeer *peer);
+
+/** Returns the port a TCP peer accepts its one connection on, or -1 for socketpair ones. */
+int lkp_peer_port(const LkpPeer *peer);
+
+/**
+ * @brief Stops a peer and frees it.
+ * 
+ * Steps that don't wait on the client (sends, delays, closing) still run to the end,
+ * but a step still waiting for the client to connect or send something fails.
+ * 
+ * @param peer The peer.
+ * 
+ * @return The first error of the script (allocated), or NULL if all of it ran as expected.
+ */
+char *lkp_stop_peer(LkpPeer *peer);
+
+#endif
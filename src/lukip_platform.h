@@ -0,0 +1,31 @@
+/**
+ * @file lukip_platform.h
+ * @brief Small layer over the few things Lukip does differently per platform.
+ * 
+ * @author Larmix
+ */
+
+#ifndef LUKIP_PLATFORM_H
+#define LUKIP_PLATFORM_H
+
+#include <setjmp.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+    #define LKP_POSIX /** Signals, fork() and friends are available. */
+#endif
+
+#ifdef LKP_POSIX
+    /** A jump buffer that also restores the signal mask (so we can jump out of handlers). */
+    typedef sigjmp_buf LkpJumpBuf;
+
+    #define LKP_SETJMP(buffer) (sigsetjmp(buffer, 1))
+    #define LKP_LONGJMP(buffer, value) (siglongjmp(buffer, value))
+#else
+    /** A plain jump buffer, since there's no signal mask to restore without POSIX signals. */
+    typedef jmp_buf LkpJumpBuf;
+
+    #define LKP_SETJMP(buffer) (setjmp(buffer))
+    #define LKP_LONGJMP(buffer, value) (longjmp(buffer, value))
+#endif
+
+#endif
@@ -0,0 +1,504 @@
+/**
+ * @file lukip_property.c
+ * @brief Generates the cases of properties, runs them on several threads and shrinks failures.
+ * 
+ * @author Larmix
+ */
+
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "lukip_dynamic_array.h"
+#include "lukip_parallel.h"
+#include "lukip_platform.h"
+#include "lukip_property.h"
+
+/** Most times a failing case gets run again while shrinking it. */
+#define MAX_SHRINK_ATTEMPTS 10000
+
+/** Most bytes of a generated buffer that get written into a counterexample. */
+#define MAX_DESCRIBED_BYTES 16
+
+/** Length of the buffer a single generated value is described in. */
+#define DESCRIPTION_LENGTH 256
+
+/** The cases of a property which every thread takes the next one out of. */
+typedef struct {
+    LkpPropertyFunc property;
+    int cases;
+    uint64_t seed;
+    long long deadline; /** When to stop generating cases in milliseconds, or 0 for never. */
+    atomic_int nextCase;
+    atomic_int failedCase; /** Lowest failing case so far, or the amount of cases if none failed. */
+    atomic_bool timedOut;
+} CaseQueue;
+
+/** What a single thread went through while running cases. */
+typedef struct {
+    CaseQueue *queue;
+    LkpFuncInfo info;
+    int asserts;
+    int casesRun;
+} Worker;
+
+/** Keeps the simplest failing choices found while shrinking a case. */
+typedef struct {
+    LkpPropertyFunc property;
+    LkpGen gen;
+    LkpCaseSink sink;
+    LkpChoiceArray best;
+    long long deadline;
+    int attempts;
+    int shrinks;
+} Shrinker;
+
+/** Returns the current time in milliseconds. */
+static long long now_ms() {
+    struct timespec now;
+    timespec_get(&now, TIME_UTC);
+    return now.tv_sec * 1000LL + now.tv_nsec / 1000000;
+}
+
+/** Returns whether the deadline (if there's one) has passed. */
+static bool past_deadline(const long long deadline) {
+    return deadline != 0 && now_ms() >= deadline;
+}
+
+/** Splitmix64, which is small, fast and good enough for generating inputs. */
+uint64_t lkp_next_random(uint64_t *state) {
+    uint64_t mixed = (*state += 0x9E3779B97F4A7C15ULL);
+    mixed = (mixed ^ (mixed >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    mixed = (mixed ^ (mixed >> 27)) * 0x94D049BB133111EBULL;
+    return mixed ^ (mixed >> 31);
+}
+
+/** Returns the seed of a single case, which only depends on the property's seed and its index. */
+static uint64_t case_seed(const uint64_t seed, const int index) {
+    uint64_t state = seed ^ ((uint64_t)index * 0xD1B54A32D192ED03ULL);
+    return lkp_next_random(&state);
+}
+
+/** Initializes a generator that draws new random choices (or replays some if replay isn't NULL). */
+static void init_gen(LkpGen *gen, const uint64_t *replay, const int replayLength) {
+    gen->state = 0;
+    gen->replay = replay;
+    gen->replayLength = replayLength;
+    gen->describe = false;
+    LKP_INIT_DA(&gen->choices);
+    LKP_INIT_DA(&gen->description);
+    LKP_APPEND_DA(&gen->description, '\0');
+}
+
+/** Frees the arrays of a generator. */
+static void free_gen(LkpGen *gen) {
+    LKP_FREE_DA(&gen->choices);
+    LKP_FREE_DA(&gen->description);
+}
+
+/** Replaces the contents of a choice array with a copy of other choices. */
+static void copy_choices(LkpChoiceArray *destination, const uint64_t *choices, const int length) {
+    destination->length = 0;
+    for (int i = 0; i < length; i++) {
+        LKP_APPEND_DA(destination, choices[i]);
+    }
+}
+
+/**
+ * @brief Draws the case's next choice, which is below bound (unless bound is 0).
+ * 
+ * Replayed choices are reduced by the bound as well, since shrinking an earlier choice
+ * can make a later one mean something else. Drawing past the end of a replay gives 0.
+ */
+static uint64_t draw(LkpGen *gen, const uint64_t bound) {
+    uint64_t choice;
+    if (gen->replay != NULL) {
+        choice = gen->choices.length < gen->replayLength ? gen->replay[gen->choices.length] : 0;
+    } else {
+        choice = lkp_next_random(&gen->state);
+    }
+    if (bound != 0) {
+        choice %= bound;
+    }
+    LKP_APPEND_DA(&gen->choices, choice);
+    return choice;
+}
+
+/** Adds a formatted value to the case's description, if it's being described. */
+static void describe(LkpGen *gen, const char *format, ...) {
+    if (!gen->describe) {
+        return;
+    }
+    char value[DESCRIPTION_LENGTH];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(value, DESCRIPTION_LENGTH, format, args);
+    va_end(args);
+
+    LKP_DROP_DA(&gen->description); // Pop NUL temporarily.
+    if (gen->description.length != 0) {
+        LKP_APPEND_DA(&gen->description, ',');
+        LKP_APPEND_DA(&gen->description, ' ');
+    }
+    for (int i = 0; value[i] != '\0'; i++) {
+        LKP_APPEND_DA(&gen->description, value[i]);
+    }
+    LKP_APPEND_DA(&gen->description, '\0');
+}
+
+/**
+ * Choices map to values in order of distance from the origin (0, 1, -1, 2, -2...),
+ * and once one side runs out of room, the rest only go towards the other side.
+ * The math is unsigned so the full range of LkpInt can't overflow.
+ */
+LkpInt lkp_gen_int(LkpGen *gen, const LkpInt min, const LkpInt max) {
+    if (max <= min) {
+        describe(gen, LKP_INT_FMT, min);
+        return min;
+    }
+    const LkpInt origin = min > 0 ? min : (max < 0 ? max : 0);
+    const uint64_t below = (uint64_t)origin - (uint64_t)min;
+    const uint64_t above = (uint64_t)max - (uint64_t)origin;
+    const uint64_t offset = draw(gen, below + above + 1); // Wraps to 0 (no bound) for every LkpInt.
+    const uint64_t paired = below < above ? below : above;
+
+    LkpInt value;
+    if (offset <= paired * 2) {
+        const uint64_t distance = (offset + 1) / 2;
+        const uint64_t unsignedValue = offset % 2 == 1
+            ? (uint64_t)origin + distance : (uint64_t)origin - distance;
+        value = (LkpInt)unsignedValue;
+    } else if (above > below) {
+        value = (LkpInt)((uint64_t)origin + (offset - paired));
+    } else {
+        value = (LkpInt)((uint64_t)origin - (offset - paired));
+    }
+    describe(gen, LKP_INT_FMT, value);
+    return value;
+}
+
+/** The lowest bit of the choice picks a side of the origin, and the rest how far from it. */
+LkpFloat lkp_gen_float(LkpGen *gen, const LkpFloat min, const LkpFloat max) {
+    if (max <= min) {
+        describe(gen, "%g", min);
+        return min;
+    }
+    const LkpFloat origin = min > 0 ? min : (max < 0 ? max : 0);
+    const uint64_t choice = draw(gen, 1ULL << 53);
+    const LkpFloat fraction = (LkpFloat)(choice >> 1) / (LkpFloat)(1ULL << 52);
+    const LkpFloat value = choice & 1
+        ? origin - fraction * (origin - min) : origin + fraction * (max - origin);
+    describe(gen, "%g", value);
+    return value;
+}
+
+/** The length is drawn first, then each byte is its own choice. */
+int lkp_gen_bytes(LkpGen *gen, void *buffer, const int maxLength) {
+    const int length = maxLength > 0 ? (int)draw(gen, (uint64_t)maxLength + 1) : 0;
+    uint8_t *bytes = buffer;
+    for (int i = 0; i < length; i++) {
+        bytes[i] = (uint8_t)draw(gen, 256);
+    }
+    if (!gen->describe) {
+        return length;
+    }
+    char text[DESCRIPTION_LENGTH];
+    int written = snprintf(text, DESCRIPTION_LENGTH, "{");
+    for (int i = 0; i < length && i < MAX_DESCRIBED_BYTES; i++) {
+        written += snprintf(
+            text + written, DESCRIPTION_LENGTH - written, i == 0 ? "%u" : ", %u", bytes[i]
+        );
+    }
+    snprintf(
+        text + written, DESCRIPTION_LENGTH - written, "%s}",
+        length > MAX_DESCRIBED_BYTES ? ", ..." : ""
+    );
+    describe(gen, "%s", text);
+    return length;
+}
+
+/** Characters are drawn from the printable ones, where the simplest one is 'a'. */
+int lkp_gen_string(LkpGen *gen, char *buffer, const int maxLength) {
+    const int printable = '~' - ' ' + 1;
+    const int length = maxLength > 0 ? (int)draw(gen, (uint64_t)maxLength + 1) : 0;
+    for (int i = 0; i < length; i++) {
+        buffer[i] = (char)(' ' + ((int)draw(gen, printable) + 'a' - ' ') % printable);
+    }
+    buffer[length] = '\0';
+    describe(gen, "\"%s\"", buffer);
+    return length;
+}
+
+/**
+ * @brief Runs one case of a property, with its asserts going into the passed sink.
+ * 
+ * @return Whether the case failed, in which case the sink's message has to be freed.
+ */
+static bool run_case(const LkpPropertyFunc property, LkpGen *gen, LkpCaseSink *sink) {
+    LkpJumpBuf jump;
+    sink->info.status = LKP_TEST_UNKNOWN;
+    sink->info.fileName = NULL;
+    sink->info.funcName = NULL;
+    sink->asserts = 0;
+    sink->message = NULL;
+    sink->line = 0;
+    sink->jump = &jump;
+    gen->choices.length = 0;
+
+    lkp_set_case_sink(sink);
+    if (LKP_SETJMP(jump) == 0) {
+        property(gen);
+    }
+    lkp_set_case_sink(NULL);
+    return sink->message != NULL;
+}
+
+/** Lowers the queue's failed case to the passed one, unless a lower case already failed. */
+static void record_failed_case(CaseQueue *queue, const int index) {
+    int current = atomic_load(&queue->failedCase);
+    while (index < current && !atomic_compare_exchange_weak(&queue->failedCase, &current, index)) {
+    }
+}
+
+/** Keeps taking the next case out of the queue until they run out, fail, or time out. */
+static void *run_cases(void *workerArg) {
+    Worker *worker = workerArg;
+    CaseQueue *queue = worker->queue;
+    LkpGen gen;
+    init_gen(&gen, NULL, 0);
+    LkpCaseSink sink;
+    while (true) {
+        const int index = atomic_fetch_add(&queue->nextCase, 1);
+        if (index >= queue->cases || index > atomic_load(&queue->failedCase)) {
+            break;
+        }
+        if (past_deadline(queue->deadline)) {
+            atomic_store(&queue->timedOut, true);
+            break;
+        }
+        gen.state = case_seed(queue->seed, index);
+        const bool failed = run_case(queue->property, &gen, &sink);
+        worker->asserts += sink.asserts;
+        worker->casesRun++;
+        if (worker->info.fileName == NULL) {
+            worker->info = sink.info;
+        }
+        if (failed) {
+            free(sink.message);
+            record_failed_case(queue, index);
+            break;
+        }
+    }
+    free_gen(&gen);
+    return NULL;
+}
+
+/** Returns whether choices are simpler than others (shorter, or lexicographically smaller). */
+static bool simpler_choices(const LkpChoiceArray *choices, const LkpChoiceArray *other) {
+    if (choices->length != other->length) {
+        return choices->length < other->length;
+    }
+    for (int i = 0; i < choices->length; i++) {
+        if (choices->data[i] != other->data[i]) {
+            return choices->data[i] < other->data[i];
+        }
+    }
+    return false;
+}
+
+/** Runs the candidate choices, and keeps what they drew as the best if it's simpler and fails. */
+static bool try_shrink(Shrinker *shrinker, const LkpChoiceArray *candidate) {
+    if (shrinker->attempts >= MAX_SHRINK_ATTEMPTS || past_deadline(shrinker->deadline)) {
+        return false;
+    }
+    shrinker->attempts++;
+    shrinker->gen.replay = candidate->data;
+    shrinker->gen.replayLength = candidate->length;
+    if (!run_case(shrinker->property, &shrinker->gen, &shrinker->sink)) {
+        return false;
+    }
+    free(shrinker->sink.message);
+    if (!simpler_choices(&shrinker->gen.choices, &shrinker->best)) {
+        return false;
+    }
+    copy_choices(&shrinker->best, shrinker->gen.choices.data, shrinker->gen.choices.length);
+    shrinker->shrinks++;
+    return true;
+}
+
+/** Tries removing chunks of choices, from big ones to single choices. */
+static bool shrink_by_removing(Shrinker *shrinker, LkpChoiceArray *candidate) {
+    bool improved = false;
+    for (int size = 8; size >= 1; size /= 2) {
+        int start = 0;
+        while (start + size <= shrinker->best.length) {
+            copy_choices(candidate, shrinker->best.data, start);
+            for (int i = start + size; i < shrinker->best.length; i++) {
+                LKP_APPEND_DA(candidate, shrinker->best.data[i]);
+            }
+            if (try_shrink(shrinker, candidate)) {
+                improved = true;
+            } else {
+                start++;
+            }
+        }
+    }
+    return improved;
+}
+
+/** Binary searches the lowest value of every choice that still fails. */
+static bool shrink_by_lowering(Shrinker *shrinker, LkpChoiceArray *candidate) {
+    bool improved = false;
+    for (int i = 0; i < shrinker->best.length; i++) {
+        uint64_t low = 0, high = shrinker->best.data[i];
+        while (low < high && i < shrinker->best.length) {
+            const uint64_t middle = low + (high - low) / 2;
+            copy_choices(candidate, shrinker->best.data, shrinker->best.length);
+            candidate->data[i] = middle;
+            if (try_shrink(shrinker, candidate)) {
+                high = middle;
+                improved = true;
+            } else {
+                low = middle + 1;
+            }
+        }
+    }
+    return improved;
+}
+
+/** Shrinks the best choices until neither way of shrinking finds anything simpler. */
+static void shrink(Shrinker *shrinker) {
+    LkpChoiceArray candidate;
+    LKP_INIT_DA(&candidate);
+    bool improved = true;
+    while (improved && shrinker->attempts < MAX_SHRINK_ATTEMPTS) {
+        improved = shrink_by_removing(shrinker, &candidate);
+        improved = shrink_by_lowering(shrinker, &candidate) || improved;
+    }
+    LKP_FREE_DA(&candidate);
+}
+
+/**
+ * @brief Shrinks the failed case, then runs the simplest one again to describe it.
+ * 
+ * A case that doesn't fail when it's run again on its own (like one that depends on global state)
+ * is still reported, but as it was instead of shrunk.
+ */
+static void shrink_failure(
+    const LkpPropertyFunc property, const uint64_t seed, const long long deadline,
+    LkpPropertyResult *result
+) {
+    Shrinker shrinker = {.property = property, .deadline = deadline, .attempts = 0, .shrinks = 0};
+    init_gen(&shrinker.gen, NULL, 0);
+    LKP_INIT_DA(&shrinker.best);
+
+    shrinker.gen.state = case_seed(seed, result->failedCase);
+    if (run_case(property, &shrinker.gen, &shrinker.sink)) {
+        free(shrinker.sink.message);
+        copy_choices(&shrinker.best, shrinker.gen.choices.data, shrinker.gen.choices.length);
+        shrink(&shrinker);
+        shrinker.gen.replay = shrinker.best.data;
+        shrinker.gen.replayLength = shrinker.best.length;
+    } else {
+        shrinker.gen.state = case_seed(seed, result->failedCase);
+    }
+
+    shrinker.gen.describe = true;
+    const bool failedAgain = run_case(property, &shrinker.gen, &shrinker.sink);
+    result->failure = shrinker.sink;
+    result->failure.jump = NULL;
+    if (!failedAgain) {
+        result->failure.message = lkp_strf_alloc("Failed, but passed when it was run again.");
+    }
+    result->shrinks = shrinker.shrinks;
+    result->counterexample = shrinker.gen.description.data;
+    LKP_FREE_DA(&shrinker.gen.choices);
+    LKP_FREE_DA(&shrinker.best);
+}
+
+/** Runs the cases on every thread, then merges what each one went through. */
+void lkp_check_property(
+    const LkpPropertyFunc property, const int cases, const uint64_t seed, const int jobs,
+    const int timeout, LkpPropertyResult *result
+) {
+    CaseQueue queue = {
+        .property = property, .cases = cases, .seed = seed,
+        .deadline = timeout > 0 ? now_ms() + timeout : 0
+    };
+    atomic_init(&queue.nextCase, 0);
+    atomic_init(&queue.failedCase, cases);
+    atomic_init(&queue.timedOut, false);
+
+    int threads = jobs > 0 ? jobs : lkp_default_jobs();
+    threads = threads < cases ? threads : (cases > 0 ? cases : 1);
+    Worker *workers = lkp_allocate(threads, sizeof(Worker));
+    for (int i = 0; i < threads; i++) {
+        workers[i] = (Worker){.queue = &queue, .asserts = 0, .casesRun = 0};
+        workers[i].info.status = LKP_TEST_UNKNOWN;
+        workers[i].info.fileName = NULL;
+        workers[i].info.funcName = NULL;
+    }
+    lkp_run_parallel(run_cases, workers, threads, sizeof(Worker));
+
+    result->asserts = 0;
+    result->casesRun = 0;
+    result->shrinks = 0;
+    result->failure.info = workers[0].info;
+    result->failure.message = NULL;
+    result->failure.line = 0;
+    result->counterexample = NULL;
+    for (int i = 0; i < threads; i++) {
+        result->asserts += workers[i].asserts;
+        result->casesRun += workers[i].casesRun;
+        if (result->failure.info.fileName == NULL) {
+            result->failure.info = workers[i].info;
+        }
+    }
+    free(workers);
+
+    const int failedCase = atomic_load(&queue.failedCase);
+    result->failedCase = failedCase < cases ? failedCase : -1;
+    result->timedOut = atomic_load(&queue.timedOut);
+    if (result->failedCase >= 0) {
+        shrink_failure(property, seed, queue.deadline, result);
+    }
+}
+
+/** Sets up the result as if the passed case was the first one that failed, then shrinks it. */
+void lkp_shrink_case(
+    const LkpPropertyFunc property, const uint64_t seed, const int failedCase, const int timeout,
+    LkpPropertyResult *result
+) {
+    result->asserts = 0;
+    result->casesRun = 0;
+    result->failedCase = failedCase;
+    result->shrinks = 0;
+    result->timedOut = false;
+    result->counterexample = NULL;
+    shrink_failure(property, seed, timeout > 0 ? now_ms() + timeout : 0, result);
+}
+
+/** Initializes a generator that draws new random choices. */
+void lkp_init_gen(LkpGen *gen) {
+    init_gen(gen, NULL, 0);
+}
+
+/** Starts drawing the choices of a case over, from its own seed. */
+void lkp_seed_gen(LkpGen *gen, const uint64_t seed, const int index) {
+    gen->state = case_seed(seed, index);
+    gen->choices.length = 0;
+}
+
+/** Frees the arrays of a generator. */
+void lkp_free_gen(LkpGen *gen) {
+    free_gen(gen);
+}
+
+/** Frees the failure's message and the counterexample. */
+void lkp_free_property_result(LkpPropertyResult *result) {
+    free(result->failure.message);
+    free(result->counterexample);
+}
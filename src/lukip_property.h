@@ -0,0 +1,112 @@
+/**
+ * @file lukip_property.h
+ * @brief Header for property-based testing: generators, shrinking and running cases in parallel.
+ * 
+ * @author Larmix
+ */
+
+#ifndef LUKIP_PROPERTY_H
+#define LUKIP_PROPERTY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "lukip_assert.h"
+#include "lukip_dynamic_array.h"
+
+/** Every raw choice a case drew, which is what gets shrunk instead of the values themselves. */
+LKP_DECLARE_DA_STRUCT(LkpChoiceArray, uint64_t);
+
+/** Text describing the values a case was given, built only for the final counterexample. */
+LKP_DECLARE_DA_STRUCT(LkpGenText, char);
+
+/**
+ * @brief The source of a case's inputs.
+ * 
+ * Generators turn raw 64-bit choices into values, where smaller choices always map
+ * to simpler values (closer to 0, shorter buffers...). A case is then fully described by
+ * its choices, so shrinking only has to look for a smaller sequence of them that still fails.
+ */
+struct LkpGen {
+    uint64_t state; /** State of the random generator when drawing new choices. */
+    const uint64_t *replay; /** Choices to draw again when shrinking, or NULL to draw new ones. */
+    int replayLength;
+    LkpChoiceArray choices; /** Every choice drawn so far by the case. */
+    bool describe; /** Whether to write the generated values into the description. */
+    LkpGenText description;
+};
+
+/** What came out of checking a property. */
+typedef struct {
+    int asserts; /** Asserts of every case which ran. */
+    int casesRun;
+    int failedCase; /** Index of the first failing case, or -1 if none failed. */
+    int shrinks; /** How many times the failing case got simpler. */
+    bool timedOut; /** Whether the cases stopped early because the timeout passed. */
+    LkpCaseSink failure; /** The failure of the shrunk case. */
+    char *counterexample; /** The shrunk case's values, allocated. */
+} LkpPropertyResult;
+
+/**
+ * @brief Runs a property against generated cases on several threads.
+ * 
+ * Case i is always generated from the same seed, no matter which thread runs it.
+ * Once a case fails the others stop, and the first failing one gets shrunk on this thread.
+ * 
+ * @param property The property to check.
+ * @param cases How many cases to generate.
+ * @param seed The seed every case's own seed is derived from.
+ * @param jobs How many threads to use, where 0 is one per core.
+ * @param timeout Milliseconds to stop generating (and shrinking) cases after, or 0 for no limit.
+ * @param[out] result The results, whose strings have to be freed with lkp_free_property_result().
+ */
+void lkp_check_property(
+    const LkpPropertyFunc property, const int cases, const uint64_t seed, const int jobs,
+    const int timeout, LkpPropertyResult *result
+);
+
+/**
+ * @brief Shrinks a case that's known to fail, without running any of the other cases.
+ * 
+ * This is for inputs which were generated (and failed) outside of lkp_check_property(),
+ * through a generator seeded with lkp_seed_gen() and the same seed and index.
+ * 
+ * @param property A property that generates the same inputs and fails the same way.
+ * @param seed The seed every case's own seed is derived from.
+ * @param failedCase The index of the failing case.
+ * @param timeout Milliseconds to stop shrinking after, or 0 for no limit.
+ * @param[out] result The results, whose strings have to be freed with lkp_free_property_result().
+ */
+void lkp_shrink_case(
+    const LkpPropertyFunc property, const uint64_t seed, const int failedCase, const int timeout,
+    LkpPropertyResult *result
+);
+
+/** Initializes a generator that draws new random choices, to be freed with lkp_free_gen(). */
+void lkp_init_gen(LkpGen *gen);
+
+/**
+ * @brief Makes a generator draw the same choices as a property's case from the start.
+ * 
+ * @param gen The generator.
+ * @param seed The seed every case's own seed is derived from.
+ * @param index The case's index.
+ */
+void lkp_seed_gen(LkpGen *gen, const uint64_t seed, const int index);
+
+/** Frees the arrays of a generator. */
+void lkp_free_gen(LkpGen *gen);
+
+/**
+ * @brief Draws the next random number of a splitmix64 generator.
+ * 
+ * @param state The generator's state, which is advanced.
+ * 
+ * @return A random 64-bit number.
+ */
+uint64_t lkp_next_random(uint64_t *state);
+
+/** Frees the strings of a property's result. */
+void lkp_free_property_result(LkpPropertyResult *result);
+
+#endif
@@ -0,0 +1,151 @@
+/**
+ * @file lukip_report.c
+ * @brief Writes the results of a run as a JSON report.
+ * 
+ * @author Larmix
+ */
+
+#include <stdio.h>
+
+#include "lukip_benchmark.h"
+#include "lukip_report.h"
+
+/** Returns the name of a test's status in the report. */
+static const char *status_name(const LkpTestFunc *test) {
+    if (test->timedOut) {
+        return "timed_out";
+    }
+    switch (test->info.status) {
+    case LKP_TEST_SUCCESS: return "passed";
+    case LKP_TEST_FAILURE: return "failed";
+    case LKP_TEST_CACHED: return "cached";
+    default: return "no_asserts";
+    }
+}
+
+/** Writes a string as a quoted JSON string, escaping what JSON doesn't allow as is. */
+static void write_string(FILE *file, const char *string) {
+    if (string == NULL) {
+        fputs("null", file);
+        return;
+    }
+    fputc('"', file);
+    for (const unsigned char *current = (const unsigned char *)string; *current; current++) {
+        if (*current == '"' || *current == '\\') {
+            fprintf(file, "\\%c", *current);
+        } else if (*current == '\n') {
+            fputs("\\n", file);
+        } else if (*current < 0x20) {
+            fprintf(file, "\\u%04x", *current);
+        } else {
+            fputc(*current, file);
+        }
+    }
+    fputc('"', file);
+}
+
+/** Writes a latency assert's percentiles, then every bucket with values as [lowest, count]. */
+static void write_latency(FILE *file, const LkpLatencyRecord *record) {
+    const LkpHistogram *histogram = record->histogram;
+    fprintf(file, "{\"line\": %d, \"statement\": ", record->line);
+    write_string(file, record->statement);
+    fprintf(
+        file, ", \"runs\": %lld, \"min_ns\": %lld, \"p50_ns\": %lld, \"p90_ns\": %lld,"
+        " \"p99_ns\": %lld, \"p99_9_ns\": %lld, \"max_ns\": %lld, \"buckets\": [",
+        histogram->total, histogram->min, lkp_histogram_percentile(histogram, 50),
+        lkp_histogram_percentile(histogram, 90), lkp_histogram_percentile(histogram, 99),
+        lkp_histogram_percentile(histogram, 99.9), histogram->max
+    );
+    bool first = true;
+    for (int i = 0; i < LKP_HISTOGRAM_BUCKETS; i++) {
+        if (histogram->counts[i] != 0) {
+            fprintf(
+                file, "%s[%lld, %lld]", first ? "" : ", ", lkp_bucket_lowest(i),
+                histogram->counts[i]
+            );
+            first = false;
+        }
+    }
+    fputs("]}", file);
+}
+
+/** Writes a benchmark's fit, followed by how long it took at each size. */
+static void write_scaling(FILE *file, const LkpScaling *scaling) {
+    fprintf(
+        file, "{\"complexity\": \"%s\", \"coefficient_ns\": %.6g, \"error\": %.4lf, \"sizes\": [",
+        lkp_complexity_name(scaling->complexity), scaling->coefficient, scaling->error
+    );
+    for (int i = 0; i < scaling->points.length; i++) {
+        const LkpBenchPoint *point = &scaling->points.data[i];
+        fprintf(
+            file, "%s{\"n\": %lld, \"median_ns\": %lld, \"p99_ns\": %lld, \"runs\": %lld}",
+            i == 0 ? "" : ", ", point->n, point->medianNs, point->p99Ns, point->runs
+        );
+    }
+    fputs("]}", file);
+}
+
+/** Writes one test's results as a JSON object. */
+static void write_test(FILE *file, const LkpTestFunc *test) {
+    fputs("    {\"file\": ", file);
+    write_string(file, test->caller.testInfo.fileName);
+    fputs(", \"name\": ", file);
+    write_string(file, test->name);
+    fprintf(
+        file, ", \"status\": \"%s\", \"flaky\": %s, \"runs\": %d, \"passed_runs\": %d,"
+        " \"mean_ms\": %.3lf, \"deviation_ms\": %.3lf,",
+        status_name(test), lkp_is_flaky(test) ? "true" : "false", test->runs, test->passedRuns,
+        test->meanMs, lkp_time_deviation(test)
+    );
+    fprintf(
+        file, " \"minor_faults\": %lld, \"major_faults\": %lld, \"voluntary_switches\": %lld,"
+        " \"involuntary_switches\": %lld, \"rss_growth_kb\": %lld, \"latencies\": [",
+        test->usage.minorFaults, test->usage.majorFaults, test->usage.voluntarySwitches,
+        test->usage.involuntarySwitches, test->usage.rssKb
+    );
+    for (int i = 0; i < test->latencies.length; i++) {
+        fputs(i == 0 ? "" : ", ", file);
+        write_latency(file, &test->latencies.data[i]);
+    }
+    fputs("], \"scaling\": ", file);
+    if (test->scaling.points.length > 0) {
+        write_scaling(file, &test->scaling);
+    } else {
+        fputs("null", file);
+    }
+    fputs(", \"failures\": [", file);
+    for (int i = 0; i < test->failures.length; i++) {
+        fprintf(
+            file, "%s{\"line\": %d, \"message\": ", i == 0 ? "" : ", ", test->failures.data[i].line
+        );
+        write_string(file, test->failures.data[i].message);
+        fputc('}', file);
+    }
+    fputs("]}", file);
+}
+
+/** Writes the totals first, then an array with every test. */
+bool lkp_write_report(const LukipUnit *lukip, const char *path) {
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+        return false;
+    }
+    fprintf(
+        file, "{\n  \"passed\": %s,\n  \"seed\": %" PRIu64 ",\n",
+        lukip->hasFailed ? "false" : "true", lukip->options.seed
+    );
+    if (lukip->options.shuffle) {
+        fprintf(file, "  \"shuffle_seed\": %" PRIu64 ",\n", lukip->options.shuffleSeed);
+    }
+    fprintf(
+        file, "  \"repeat\": %d,\n  \"asserts\": %d,\n  \"failed_asserts\": %d,\n  \"tests\": [\n",
+        lukip->options.repeat, lukip->asserts, lukip->failedAsserts
+    );
+    for (int i = 0; i < lukip->tests.length; i++) {
+        write_test(file, &lukip->tests.data[i]);
+        fputs(i + 1 < lukip->tests.length ? ",\n" : "\n", file);
+    }
+    fputs("  ]\n}\n", file);
+    const bool written = !ferror(file);
+    return fclose(file) == 0 && written;
+}
@@ -0,0 +1,29 @@
+/**
+ * @file lukip_report.h
+ * @brief Header for writing the results of a run in a machine-readable form.
+ * 
+ * @author Larmix
+ */
+
+#ifndef LUKIP_REPORT_H
+#define LUKIP_REPORT_H
+
+#include <stdbool.h>
+
+#include "lukip_assert.h"
+
+/**
+ * @brief Writes the results of every test as JSON.
+ * 
+ * Each test is identified like in the cache (the file it was called from and its name),
+ * and has its status, whether it's flaky, its pass rate and timing over its runs,
+ * what its body used (summed over the runs), and its failures.
+ * 
+ * @param lukip The unit whose tests ran.
+ * @param path The file to write to, which gets replaced.
+ * 
+ * @return False if the file couldn't be written (with errno set).
+ */
+bool lkp_write_report(const LukipUnit *lukip, const char *path);
+
+#endif
@@ -0,0 +1,165 @@
+/**
+ * @file lukip_timeout.c
+ * @brief A watchdog timer for tests, built on SIGALRM.
+ * 
+ * The watchdog borrows SIGALRM and the real time timer while a test runs,
+ * and gives both back once it's disarmed.
+ * 
+ * @author Larmix
+ */
+
+#include <stdlib.h>
+
+#include "lukip_clock.h"
+#include "lukip_platform.h"
+#include "lukip_timeout.h"
+
+#ifdef LKP_POSIX
+#include <string.h>
+#endif
+
+/** Reads LKP_TIMEOUT_ENV as a positive amount of milliseconds. */
+int lkp_env_timeout() {
+    const char *value = getenv(LKP_TIMEOUT_ENV);
+    if (value == NULL) {
+        return 0;
+    }
+    const long milliseconds = strtol(value, NULL, 10);
+    return milliseconds > 0 ? (int)milliseconds : 0;
+}
+
+#ifdef LKP_POSIX
+
+static LkpTimeoutHandler timeoutHandler = NULL; /** What to call when the watchdog fires. */
+static pthread_t ownerThread; /** The thread which armed the watchdog (the one running the test). */
+static long long deadline = 0; /** When the watchdog fires in monotonic nanoseconds, or 0. */
+static bool held = false; /** Whether SIGALRM is blocked by lkp_hold_watchdog(). */
+
+/**
+ * SIGALRM can be delivered to any thread, but the handler has to run on the thread
+ * that's running the test, so forward it there if another one got it.
+ */
+static void on_alarm(int signal) {
+    if (!pthread_equal(pthread_self(), ownerThread)) {
+        pthread_kill(ownerThread, signal);
+        return;
+    }
+    if (timeoutHandler != NULL) {
+        timeoutHandler();
+    }
+}
+
+/** Sets the real time interval timer to fire once after the passed milliseconds. */
+static void set_timer(const int milliseconds, struct itimerval *previous) {
+    struct itimerval timer;
+    memset(&timer, 0, sizeof(timer));
+    timer.it_value.tv_sec = milliseconds / 1000;
+    timer.it_value.tv_usec = (milliseconds % 1000) * 1000;
+    setitimer(ITIMER_REAL, &timer, previous);
+}
+
+/** Installs the SIGALRM handler and starts the timer, saving whatever was there. */
+bool lkp_arm_watchdog(
+    const int milliseconds, const LkpTimeoutHandler onTimeout, LkpWatchdog *saved
+) {
+    saved->armed = false;
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = on_alarm;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGALRM, &action, &saved->action) != 0) {
+        return false;
+    }
+    saved->armed = true;
+    saved->handler = timeoutHandler;
+    saved->owner = ownerThread;
+    saved->armedAt = lkp_monotonic_ns();
+    saved->deadline = deadline;
+    deadline = saved->armedAt + milliseconds * 1000000LL;
+    timeoutHandler = onTimeout;
+    ownerThread = pthread_self();
+    set_timer(milliseconds, &saved->timer);
+    return true;
+}
+
+/**
+ * Cancels the timer before removing the handler, so a late alarm can't call it.
+ * The replaced timer goes on with the time it had left, and if that ran out
+ * while the watchdog was armed, it fires right away instead of being lost.
+ */
+void lkp_disarm_watchdog(LkpWatchdog *saved) {
+    if (!saved->armed) {
+        return;
+    }
+    saved->armed = false;
+    set_timer(0, NULL);
+    timeoutHandler = saved->handler;
+    ownerThread = saved->owner;
+    deadline = saved->deadline;
+    sigaction(SIGALRM, &saved->action, NULL);
+    struct itimerval *timer = &saved->timer;
+    if (timer->it_value.tv_sec == 0 && timer->it_value.tv_usec == 0) {
+        return;
+    }
+    const long long elapsedUs = (lkp_monotonic_ns() - saved->armedAt) / 1000;
+    long long remainingUs = timer->it_value.tv_sec * 1000000LL + timer->it_value.tv_usec
+        - elapsedUs;
+    if (remainingUs < 1) {
+        remainingUs = 1;
+    }
+    timer->it_value.tv_sec = remainingUs / 1000000;
+    timer->it_value.tv_usec = remainingUs % 1000000;
+    setitimer(ITIMER_REAL, timer, NULL);
+}
+
+/** Blocks SIGALRM, which threads started afterwards inherit. */
+long long lkp_hold_watchdog() {
+    if (timeoutHandler == NULL || held) {
+        return held ? deadline : 0;
+    }
+    sigset_t alarm;
+    sigemptyset(&alarm);
+    sigaddset(&alarm, SIGALRM);
+    held = pthread_sigmask(SIG_BLOCK, &alarm, NULL) == 0;
+    return deadline;
+}
+
+/** Unblocks SIGALRM, where a pending one gets delivered before this returns. */
+void lkp_release_watchdog() {
+    if (!held) {
+        return;
+    }
+    held = false;
+    sigset_t alarm;
+    sigemptyset(&alarm);
+    sigaddset(&alarm, SIGALRM);
+    pthread_sigmask(SIG_UNBLOCK, &alarm, NULL);
+}
+
+#else
+
+/** Timeouts aren't supported without POSIX signals. */
+bool lkp_arm_watchdog(
+    const int milliseconds, const LkpTimeoutHandler onTimeout, LkpWatchdog *saved
+) {
+    (void)milliseconds;
+    (void)onTimeout;
+    saved->armed = false;
+    return false;
+}
+
+/** There's no watchdog to hold without POSIX signals. */
+long long lkp_hold_watchdog() {
+    return 0;
+}
+
+/** There's no watchdog to release without POSIX signals. */
+void lkp_release_watchdog() {
+}
+
+/** Nothing to disarm without POSIX signals. */
+void lkp_disarm_watchdog(LkpWatchdog *saved) {
+    (void)saved;
+}
+
+#endif
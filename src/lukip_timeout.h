@@ -0,0 +1,88 @@
+/**
+ * @file lukip_timeout.h
+ * @brief Header for the watchdog that stops tests which run for too long.
+ * 
+ * @author Larmix
+ */
+
+#ifndef LUKIP_TIMEOUT_H
+#define LUKIP_TIMEOUT_H
+
+#include <stdbool.h>
+
+#include "lukip_platform.h"
+
+#ifdef LKP_POSIX
+#include <pthread.h>
+#include <signal.h>
+#include <sys/time.h>
+#endif
+
+/** Environment variable which holds the default timeout of every test in milliseconds. */
+#define LKP_TIMEOUT_ENV "LUKIP_TIMEOUT_MS"
+
+/** Function the watchdog calls (from a signal handler) once the time runs out. */
+typedef void (*LkpTimeoutHandler)();
+
+/**
+ * @brief What an armed watchdog took the place of, so a nested test's one can be undone.
+ * 
+ * That's the program's SIGALRM handler and real time timer for the outermost one,
+ * or the watchdog of the test it's nested in otherwise.
+ */
+typedef struct {
+    bool armed; /** Whether there's anything to restore. */
+#ifdef LKP_POSIX
+    struct sigaction action;
+    struct itimerval timer;
+    long long armedAt; /** When the watchdog was armed, in monotonic nanoseconds. */
+    long long deadline; /** When the replaced watchdog fires, or 0 if there wasn't one. */
+    LkpTimeoutHandler handler;
+    pthread_t owner;
+#endif
+} LkpWatchdog;
+
+/**
+ * @brief Reads the default test timeout from the environment.
+ * 
+ * @return The timeout in milliseconds, or 0 if it's unset or invalid.
+ */
+int lkp_env_timeout();
+
+/**
+ * @brief Starts a watchdog which calls onTimeout if it isn't disarmed in time.
+ * 
+ * The program's SIGALRM handler and real time timer are saved, and restored by
+ * lkp_disarm_watchdog(). A watchdog armed while another one is gets undone the same way.
+ * 
+ * @param milliseconds How long until the watchdog fires.
+ * @param onTimeout The function called on the thread that armed the watchdog.
+ * @param[out] saved What the watchdog replaced.
+ * 
+ * @return Whether the watchdog could be armed (it can't on non-POSIX systems).
+ */
+bool lkp_arm_watchdog(
+    const int milliseconds, const LkpTimeoutHandler onTimeout, LkpWatchdog *saved
+);
+
+/**
+ * @brief Holds off the watchdog on the calling thread (and threads it starts) until released.
+ * 
+ * Meant for code that can't be jumped out of, like a thread that has to join its workers.
+ * An alarm while it's held stays pending, and fires once it's released.
+ * 
+ * @return When the watchdog fires in monotonic nanoseconds, or 0 if it isn't armed.
+ */
+long long lkp_hold_watchdog();
+
+/** Lets the watchdog fire again, right away if its time ran out while it was held. */
+void lkp_release_watchdog();
+
+/**
+ * @brief Stops the watchdog and puts back what it replaced.
+ * 
+ * @param saved What lkp_arm_watchdog() saved, where nothing happens unless it was armed.
+ */
+void lkp_disarm_watchdog(LkpWatchdog *saved);
+
+#endif
@@ -0,0 +1,101 @@
+/**
+ * @file lukip_usage.c
+ * @brief Reads the resource usage counters of the thread running a test.
+ * 
+ * @author Larmix
+ */
+
+#if defined(__GNUC__) && defined(__linux__)
+    #define _GNU_SOURCE /** For RUSAGE_THREAD. */
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "lukip_platform.h"
+#include "lukip_usage.h"
+
+#ifdef LKP_POSIX
+#include <sys/resource.h>
+#endif
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+
+extern int __real_open(const char *path, int flags, ...) __attribute__((weak));
+extern ssize_t __real_read(int fd, void *buffer, size_t count) __attribute__((weak));
+extern int __real_close(int fd) __attribute__((weak));
+#endif
+
+/**
+ * Reads VmRSS out of /proc/self/status, or returns 0 where there's none.
+ * It's read into the stack without stdio, so measuring doesn't allocate or fault pages itself.
+ * The real open() and read() are used when they're wrapped, since a test's faked I/O
+ * is still active when its body's end is measured.
+ */
+static long long resident_kb() {
+#ifdef __linux__
+    const char *path = "/proc/self/status";
+    const int flags = O_RDONLY | O_CLOEXEC;
+    const int fd = __real_open != NULL ? __real_open(path, flags) : open(path, flags);
+    if (fd == -1) {
+        return 0;
+    }
+    char status[4096];
+    size_t length = 0;
+    ssize_t amount;
+    while (length < sizeof(status) - 1) {
+        char *end = status + length;
+        const size_t space = sizeof(status) - 1 - length;
+        amount = __real_read != NULL ? __real_read(fd, end, space) : read(fd, end, space);
+        if (amount <= 0) {
+            break;
+        }
+        length += amount;
+    }
+    if (__real_close != NULL) {
+        __real_close(fd);
+    } else {
+        close(fd);
+    }
+    status[length] = '\0';
+    const char *line = strstr(status, "VmRSS:");
+    return line != NULL ? strtoll(line + 6, NULL, 10) : 0;
+#else
+    return 0;
+#endif
+}
+
+/** Only the calling thread's counters where RUSAGE_THREAD exists, the process' otherwise. */
+void lkp_measure_counters(LkpUsage *usage) {
+    memset(usage, 0, sizeof(*usage));
+#ifdef LKP_POSIX
+    struct rusage counters;
+#ifdef RUSAGE_THREAD
+    const int who = RUSAGE_THREAD;
+#else
+    const int who = RUSAGE_SELF;
+#endif
+    if (getrusage(who, &counters) == 0) {
+        usage->minorFaults = counters.ru_minflt;
+        usage->majorFaults = counters.ru_majflt;
+        usage->voluntarySwitches = counters.ru_nvcsw;
+        usage->involuntarySwitches = counters.ru_nivcsw;
+    }
+#endif
+}
+
+void lkp_measure_usage(LkpUsage *usage) {
+    lkp_measure_counters(usage);
+    usage->rssKb = resident_kb();
+}
+
+/** Every counter only grows besides the resident memory, which can also shrink. */
+void lkp_add_usage(LkpUsage *total, const LkpUsage *start, const LkpUsage *end) {
+    total->minorFaults += end->minorFaults - start->minorFaults;
+    total->majorFaults += end->majorFaults - start->majorFaults;
+    total->voluntarySwitches += end->voluntarySwitches - start->voluntarySwitches;
+    total->involuntarySwitches += end->involuntarySwitches - start->involuntarySwitches;
+    total->rssKb += end->rssKb - start->rssKb;
+}
@@ -0,0 +1,48 @@
+/**
+ * @file lukip_usage.h
+ * @brief Header for measuring the page faults, context switches and memory of test bodies.
+ * 
+ * @author Larmix
+ */
+
+#ifndef LUKIP_USAGE_H
+#define LUKIP_USAGE_H
+
+/** Counters of the running thread, or the changes in them over a test's body. */
+typedef struct {
+    long long minorFaults; /** Page faults that didn't need any I/O. */
+    long long majorFaults; /** Page faults that had to read from the disk. */
+    long long voluntarySwitches; /** Context switches from waiting (on I/O, locks, sleeps...). */
+    long long involuntarySwitches; /** Context switches from being preempted. */
+    long long rssKb; /** The process' resident memory in KiB. */
+} LkpUsage;
+
+/**
+ * @brief Reads the current thread's counters and the process' resident memory.
+ * 
+ * Uses getrusage() (with RUSAGE_THREAD where it's available) and /proc/self/status,
+ * so whatever's unavailable is left at 0.
+ * 
+ * @param[out] usage Where the counters go.
+ */
+void lkp_measure_usage(LkpUsage *usage);
+
+/**
+ * @brief Reads only the current thread's getrusage() counters, leaving the resident memory at 0.
+ * 
+ * Cheap enough to be taken before every generated case.
+ * 
+ * @param[out] usage Where the counters go.
+ */
+void lkp_measure_counters(LkpUsage *usage);
+
+/**
+ * @brief Adds what changed between two measurements into a total.
+ * 
+ * @param total The total to add to.
+ * @param start The measurement from the start.
+ * @param end The measurement from the end.
+ */
+void lkp_add_usage(LkpUsage *total, const LkpUsage *start, const LkpUsage *end);
+
+#endif
@@ -28,3 +28,9 @@ TEST_CASE(string_test2) {
     char str1[10] = "string!9", str2[10] = "string!";
     ASSERT_STRING_EQUAL(str1, str2);
 }
+
+/** Looks an item's price up, which stands in for an expensive call to another service. */
+int fetch_price(const char *item) {
+    printf("Fetching the price of %s from a service that isn't there.\n", item);
+    return -1;
+}
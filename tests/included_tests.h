@@ -19,4 +19,7 @@ DECLARE_TEARDOWN(tear_down2);
 /** A random test from a different file. A string comparison test in this case. */
 TEST_CASE(string_test2);
 
+/** Looks an item's price up, which stands in for an expensive call to another service. */
+int fetch_price(const char *item);
+
 #endif
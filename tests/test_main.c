@@ -5,13 +5,72 @@
  * @author Larmix
  */
 
+#include <errno.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
+#include <time.h>
 
 #include "lukip.h"
 #include "included_tests.h"
 
+#ifdef LKP_POSIX
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#endif
+
+/** Set in the environment of the copies of this program that only run the order demo. */
+#define ORDER_DEMO_ENV "LUKIP_ORDER_DEMO"
+
+static const char *programPath; /** How this program was started, so tests can start it again. */
+
+static int *warmedCache = NULL; /** State that's expensive to build, shared through the zygote. */
+
+/** One-time setup that every isolated test gets forked from. */
+DECLARE_SUITE_SETUP(zygote_setup) {
+    warmedCache = malloc(sizeof(int) * 1024);
+    for (int i = 0; i < 1024; i++) {
+        warmedCache[i] = i;
+    }
+}
+
+/** One-time teardown of the zygote's state. */
+DECLARE_SUITE_TEARDOWN(zygote_teardown) {
+    free(warmedCache);
+}
+
+/** Fixture of a suite standing in for a database, which is only built once. */
+typedef struct {
+    int *rows;
+    int rowCount;
+    int lookups;
+} TableFixture;
+
+/** Builds the table once for the whole suite. */
+SUITE_SETUP(table_setup, TableFixture) {
+    fixture->rowCount = 4096;
+    fixture->rows = malloc(sizeof(int) * fixture->rowCount);
+    for (int i = 0; i < fixture->rowCount; i++) {
+        fixture->rows[i] = i * 2;
+    }
+}
+
+/** Frees the table once the suite's over. */
+SUITE_TEARDOWN(table_teardown, TableFixture) {
+    free(fixture->rows);
+}
+
+/** Resets the per-test state of the table. */
+FIXTURE_SETUP(table_test_setup, TableFixture) {
+    fixture->lookups = 0;
+}
+
 /** General setup for the tests. */
 DECLARE_SETUP(test_setup) {
     printf("Setup activated.\n");
@@ -80,9 +139,584 @@ TEST_CASE(string_test) {
     ASSERT_STRING_EQUAL(str1, str2);
 }
 
+/** Tests that a failed REQUIRE stops the test before it dereferences NULL. */
+TEST_CASE(fatal_test) {
+    int *missing = NULL;
+    REQUIRE_NOT_NULL(missing);
+    ASSERT_INT_EQUAL(*missing, 5);
+}
+
+/** Tests that a hung test gets skipped by its timeout instead of blocking forever. */
+TEST_CASE(timeout_test) {
+    ASSERT_TRUE(true);
+    volatile bool hung = true;
+    while (hung) {
+    }
+}
+
+/** Tests that every isolated test starts from the zygote's state, even if an earlier one changed it. */
+TEST_CASE(zygote_test) {
+    REQUIRE_NOT_NULL(warmedCache);
+    ASSERT_INT_EQUAL(warmedCache[1000], 1000);
+    warmedCache[1000] = -1;
+}
+
+/** A test that crashes, which should only fail itself when isolated. */
+TEST_CASE(crash_test) {
+    ASSERT_TRUE(true);
+    int *volatile invalid = NULL;
+    *invalid = 1;
+}
+
+/** Tests that a fixture test gets the suite's fixture, with its per-test setup applied. */
+FIXTURE_TEST_CASE(table_lookup_test, TableFixture) {
+    REQUIRE_NOT_NULL(fixture->rows);
+    ASSERT_INT_EQUAL(fixture->lookups, 0);
+    fixture->lookups++;
+    ASSERT_INT_EQUAL(fixture->rows[100], 200);
+}
+
+/** Reverses a string in place, standing in for a codec whose decoding undoes its encoding. */
+static void reverse_string(char *string, const int length) {
+    for (int i = 0; i < length / 2; i++) {
+        const char tmp = string[i];
+        string[i] = string[length - i - 1];
+        string[length - i - 1] = tmp;
+    }
+}
+
+/** Reversing a generated string twice should always give back the same string. */
+PROPERTY_CASE(reverse_twice_property) {
+    char original[65], reversed[65];
+    const int length = GEN_STRING(original, 64);
+    memcpy(reversed, original, length + 1);
+    reverse_string(reversed, length);
+    reverse_string(reversed, length);
+    ASSERT_STRING_EQUAL(original, reversed);
+}
+
+/** A property that's wrong on purpose, whose failures should all be shrunk down to 500. */
+PROPERTY_CASE(small_number_property) {
+    const int64_t number = GEN_INT(0, 1000);
+    ASSERT_INT64_LESS(number, 500);
+}
+
+/** Splits "key=value" bytes at the first '=', standing in for a parser fed with untrusted input. */
+static bool parse_pair(
+    const uint8_t *data, const size_t size, size_t *keyLength, size_t *valueLength
+) {
+    const uint8_t *equals = size > 0 ? memchr(data, '=', size) : NULL;
+    if (equals == NULL) {
+        return false;
+    }
+    *keyLength = equals - data;
+    *valueLength = size - *keyLength - 1;
+    return true;
+}
+
+/** Whatever the input is, a parsed pair should account for every byte of it. */
+FUZZ_CASE(parse_pair_fuzz, data, size) {
+    size_t keyLength, valueLength;
+    if (parse_pair(data, size, &keyLength, &valueLength)) {
+        ASSERT_SIZE_T_EQUAL(keyLength + valueLength + 1, size);
+    } else {
+        ASSERT_TRUE(size == 0 || memchr(data, '=', size) == NULL);
+    }
+}
+
+/** Bytes to checksum, standing in for the input of a kernel that got rewritten for speed. */
+typedef struct {
+    uint8_t bytes[256];
+    int length;
+} ChecksumInput;
+
+/** Sums the bytes one at a time, which is obviously right. */
+static void checksum_reference(const ChecksumInput *input, uint64_t *sum) {
+    for (int i = 0; i < input->length; i++) {
+        *sum += input->bytes[i];
+    }
+}
+
+/** Sums the bytes with 4 independent accumulators, which should give the same sum faster. */
+static void checksum_unrolled(const ChecksumInput *input, uint64_t *sum) {
+    uint64_t lanes[4] = {0, 0, 0, 0};
+    int i = 0;
+    for (; i + 4 <= input->length; i += 4) {
+        lanes[0] += input->bytes[i];
+        lanes[1] += input->bytes[i + 1];
+        lanes[2] += input->bytes[i + 2];
+        lanes[3] += input->bytes[i + 3];
+    }
+    for (; i < input->length; i++) {
+        lanes[0] += input->bytes[i];
+    }
+    *sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+
+DIFFERENTIAL_GENERATOR(checksum_input, ChecksumInput, uint64_t, input) {
+    input->length = GEN_BYTES(input->bytes, 256);
+}
+
+DIFFERENTIAL_CASE(checksum_reference, checksum_unrolled, checksum_input);
+
+/** Every row of the table is a number and its square, where one of them is wrong on purpose. */
+PARAM_TEST_CASE(square_row) {
+    REQUIRE_TRUE(ROW_FIELDS() == 2);
+    const int64_t number = ROW_INT(0);
+    ASSERT_INT64_EQUAL(number * number, ROW_INT(1));
+}
+
+/** Two strings with an allocation each, standing in for state built all or nothing. */
+typedef struct {
+    char *key;
+    char *value;
+} TextPair;
+
+/** Copies both strings into the pair, or leaves it empty if memory runs out. */
+static bool make_pair(TextPair *pair, const char *key, const char *value) {
+    pair->key = malloc(strlen(key) + 1);
+    if (pair->key == NULL) {
+        return false;
+    }
+    pair->value = malloc(strlen(value) + 1);
+    if (pair->value == NULL) {
+        free(pair->key);
+        pair->key = NULL;
+        return false;
+    }
+    strcpy(pair->key, key);
+    strcpy(pair->value, value);
+    return true;
+}
+
+/** Whichever allocation fails, the pair should either be whole or empty. */
+TEST_CASE(make_pair_test) {
+    TextPair pair = {NULL, NULL};
+    if (make_pair(&pair, "key", "value")) {
+        ASSERT_STRING_EQUAL(pair.value, "value");
+        free(pair.key);
+        free(pair.value);
+    } else {
+        ASSERT_NULL(pair.key);
+    }
+}
+
+/** The pair's second allocation failing shouldn't leave the first one behind. */
+TEST_CASE(out_of_memory_test) {
+    TextPair pair = {NULL, NULL};
+    FAIL_NTH_ALLOCATION(2);
+    ASSERT_FALSE(make_pair(&pair, "key", "value"));
+    ASSERT_NULL(pair.key);
+    ASSERT_INT_EQUAL(FAILED_ALLOCATIONS(), 1);
+}
+
+/** Tries an operation that only works on its 4th attempt, backing off for 1, 2 then 4 seconds. */
+static int connect_with_backoff() {
+    int attempts = 1;
+    for (time_t backoff = 1; attempts < 4; backoff *= 2, attempts++) {
+        const struct timespec duration = {.tv_sec = backoff, .tv_nsec = 0};
+        nanosleep(&duration, NULL);
+    }
+    return attempts;
+}
+
+/** Seven seconds of backoff and a minute of expiry, without waiting for either. */
+TEST_CASE(virtual_clock_test) {
+    START_VIRTUAL_CLOCK();
+    const time_t start = time(NULL);
+    const int attempts = connect_with_backoff();
+    ASSERT_INT_EQUAL(attempts, 4);
+    ASSERT_INT_EQUAL(time(NULL) - start, 7);
+
+    ADVANCE_TIME(60000);
+    ASSERT_INT_EQUAL(time(NULL) - start, 67);
+}
+
+#ifdef LKP_POSIX
+
+/** Writes all of the text to a new file and syncs it, retrying short and interrupted writes. */
+static bool save_text(const char *path, const char *text) {
+    const int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        return false;
+    }
+    size_t written = 0;
+    while (written < strlen(text)) {
+        const ssize_t result = write(fd, text + written, strlen(text) - written);
+        if (result == -1 && errno != EINTR) {
+            close(fd);
+            return false;
+        }
+        written += result > 0 ? (size_t)result : 0;
+    }
+    const bool synced = fsync(fd) == 0;
+    return close(fd) == 0 && synced;
+}
+
+/** Saving should survive short and interrupted writes, but report a full disk. */
+TEST_CASE(fake_files_test) {
+    FAKE_FILES("/lukip/");
+    SHORTEN_IO(WRITE, "/lukip/", 1, 5);
+    FAIL_IO(WRITE, "/lukip/", 2, EINTR);
+    ASSERT_TRUE(save_text("/lukip/saved.txt", "Hello, world!"));
+
+    char text[32] = {0};
+    const int fd = open("/lukip/saved.txt", O_RDONLY);
+    const ssize_t amount = read(fd, text, sizeof(text) - 1);
+    ASSERT_INT_EQUAL(amount, 13);
+    ASSERT_STRING_EQUAL(text, "Hello, world!");
+    close(fd);
+
+    FAIL_IO(FSYNC, "/lukip/", 1, ENOSPC);
+    ASSERT_FALSE(save_text("/lukip/saved.txt", "Hello again!"));
+    ASSERT_INT_EQUAL(INJECTED_IO_FAULTS(), 3);
+}
+
+static LkpPeer *pingServer = NULL; /** Stands in for a server answering pings. */
+
+/** Scripts a server that answers a ping slowly and in pieces, then drops the connection. */
+DECLARE_SETUP(start_ping_server) {
+    pingServer = NEW_PEER(TCP);
+    PEER_EXPECT(pingServer, "PING\n");
+    PEER_LATENCY(pingServer, 1);
+    PEER_FRAGMENT(pingServer, 2);
+    PEER_SEND(pingServer, "PONG\n");
+    PEER_RESET(pingServer);
+    START_PEER(pingServer);
+}
+
+/** Fails the test if the server's script didn't go as expected. */
+DECLARE_TEARDOWN(stop_ping_server) {
+    STOP_PEER(pingServer);
+}
+
+/** Connects to a port of 127.0.0.1, returning the socket or -1. */
+static int connect_to_port(const int port) {
+    const int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in address = {.sin_family = AF_INET, .sin_port = htons(port)};
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (fd != -1 && connect(fd, (struct sockaddr *)&address, sizeof(address)) == -1) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/** Sends a ping, and reads a whole line back no matter how it's split up. */
+static bool ping(const int fd) {
+    if (send(fd, "PING\n", 5, MSG_NOSIGNAL) != 5) {
+        return false;
+    }
+    char line[16] = {0};
+    size_t length = 0;
+    while (length < sizeof(line) - 1 && (length == 0 || line[length - 1] != '\n')) {
+        const ssize_t received = recv(fd, line + length, sizeof(line) - 1 - length, 0);
+        if (received <= 0) {
+            return false;
+        }
+        length += (size_t)received;
+    }
+    return strcmp(line, "PONG\n") == 0;
+}
+
+/** The answer should come back whole even though it arrives in pieces, then the reset shows. */
+TEST_CASE(ping_test) {
+    const int fd = connect_to_port(PEER_PORT(pingServer));
+    ASSERT_TRUE(ping(fd));
+    char byte;
+    const ssize_t received = recv(fd, &byte, 1, 0);
+    const int error = errno;
+    ASSERT_INT_EQUAL(received, -1);
+    ASSERT_INT_EQUAL(error, ECONNRESET);
+    close(fd);
+}
+
+#endif
+
+MOCK_FUNC(int, fetch_price, (const char *, item));
+
+/** Adds the prices of the items up, or returns -1 if one of them couldn't be fetched. */
+static int basket_total(const char **items, const int amount) {
+    int total = 0;
+    for (int i = 0; i < amount; i++) {
+        const int price = fetch_price(items[i]);
+        if (price == -1) {
+            return -1;
+        }
+        total += price;
+    }
+    return total;
+}
+
+/** The basket should be priced from the (mocked) service, one item at a time. */
+TEST_CASE(mock_test) {
+    const char *items[] = {"apple", "pear", "plum"};
+    MOCK_RETURN(fetch_price, 250);
+    EXPECT_CALL(fetch_price, 3);
+    const int total = basket_total(items, 3);
+    ASSERT_INT_EQUAL(total, 750);
+    ASSERT_STRING_EQUAL(MOCK_ARG(fetch_price, 1, item), "pear");
+}
+
+/** Fails every third run through leftover state, which only --repeat=N catches as flaky. */
+TEST_CASE(flaky_test) {
+    static int runs = 0;
+    runs++;
+    ASSERT_TRUE(runs % 3 != 0);
+}
+
+static int cachedEntries = 0; /** Left behind by cache_fill_test for every test after it. */
+
+/** Expects an empty cache, so it only passes before cache_fill_test (which --shuffle exposes). */
+TEST_CASE(cache_empty_test) {
+    const int entries = cachedEntries;
+    ASSERT_INT_EQUAL(entries, 0);
+}
+
+/** Fills the cache without ever clearing it. */
+TEST_CASE(cache_fill_test) {
+    cachedEntries += 3;
+    const int entries = cachedEntries;
+    ASSERT_TRUE(entries >= 3);
+}
+
+#ifdef LKP_POSIX
+
+/** Checks a header's magic number, aborting on corruption like an invariant check would. */
+static void check_header(const uint32_t magic) {
+    if (magic != 0x4C4B5000) {
+        fprintf(stderr, "Corrupted header: %08x.\n", magic);
+        abort();
+    }
+}
+
+/** Loads a config, exiting with status 2 if there's none like a program's main() would. */
+static void load_config(const char *path) {
+    if (path == NULL) {
+        fprintf(stderr, "No config was given.\n");
+        exit(2);
+    }
+}
+
+/** The invariant checks should actually fire, without taking the rest of the tests down. */
+TEST_CASE(death_test) {
+    ASSERT_DEATH(check_header(0xDEADBEEF), KILLED_BY(SIGABRT), "Corrupted header: deadbeef");
+    ASSERT_DEATH(load_config(NULL), EXITED_WITH(2), "^No config");
+}
+
+/** Forgets the write end of a pipe, which gets warned about as a leaked descriptor. */
+TEST_CASE(leaky_test) {
+    int fds[2];
+    const int piped = pipe(fds);
+    ASSERT_INT_EQUAL(piped, 0);
+    close(fds[0]);
+}
+
+/** The first test of the order demo, which passes. */
+TEST_CASE(order_first_test) {
+    puts("ran order_first_test");
+    ASSERT_TRUE(true);
+}
+
+/** The second test of the order demo, which always fails. */
+TEST_CASE(order_failing_test) {
+    puts("ran order_failing_test");
+    ASSERT_TRUE(false);
+}
+
+/** The last test of the order demo, which passes. */
+TEST_CASE(order_last_test) {
+    puts("ran order_last_test");
+    ASSERT_TRUE(true);
+}
+
+/** What a copy of this program started by run_order_demo() runs instead of the other tests. */
+static int order_demo(int argc, char **argv) {
+    LUKIP_INIT_ARGS(argc, argv);
+    TEST(order_first_test);
+    TEST(order_failing_test);
+    TEST(order_last_test);
+    return 0;
+}
+
+/**
+ * Starts this program again with the options so it runs the order demo,
+ * and reads everything it printed into output (empty if it couldn't be started).
+ */
+static void run_order_demo(
+    const char *option, const char *cacheOption, char *output, const size_t size
+) {
+    output[0] = '\0';
+    int fds[2];
+    if (pipe(fds) == -1) {
+        return;
+    }
+    const pid_t pid = fork();
+    if (pid == 0) {
+        dup2(fds[1], STDOUT_FILENO);
+        close(fds[0]);
+        close(fds[1]);
+        setenv(ORDER_DEMO_ENV, "1", 1);
+        setenv("LUKIP_COVERAGE_FILE", "/dev/null", 1); // Would start this run's map over.
+        char *arguments[] = {(char *)programPath, (char *)option, (char *)cacheOption, NULL};
+        execvp(programPath, arguments);
+        _exit(127);
+    }
+    close(fds[1]);
+    size_t length = 0;
+    ssize_t amount;
+    while (pid > 0 && length < size - 1
+            && (amount = read(fds[0], output + length, size - 1 - length)) > 0) {
+        length += amount;
+    }
+    output[length] = '\0';
+    close(fds[0]);
+    if (pid > 0) {
+        waitpid(pid, NULL, 0);
+    }
+}
+
+/** Keeps only the names of the tests the order demo's output says ran, in order. */
+static void tests_that_ran(const char *output, char *ran, const size_t size) {
+    ran[0] = '\0';
+    size_t length = 0;
+    const char *line = output;
+    while (length < size && (line = strstr(line, "ran order_")) != NULL) {
+        line += strlen("ran ");
+        const int nameLength = (int)strcspn(line, "\n");
+        length += snprintf(ran + length, size - length, "%.*s ", nameLength, line);
+    }
+}
+
+/** The run order options should change which tests of the order demo run, and when. */
+TEST_CASE(run_order_test) {
+    char cacheOption[] = "--cache-file=/tmp/lukip_order_XXXXXX";
+    char *cachePath = cacheOption + strlen("--cache-file=");
+    const int fd = mkstemp(cachePath);
+    REQUIRE_TRUE(fd != -1);
+    close(fd);
+
+    static char output[16384];
+    char ran[256];
+    run_order_demo("--failed-first", cacheOption, output, sizeof(output));
+    tests_that_ran(output, ran, sizeof(ran));
+    ASSERT_STRING_EQUAL(ran, "order_first_test order_failing_test order_last_test ");
+    run_order_demo("--failed-first", cacheOption, output, sizeof(output));
+    tests_that_ran(output, ran, sizeof(ran));
+    ASSERT_STRING_EQUAL(ran, "order_failing_test order_first_test order_last_test ");
+    run_order_demo("--only-failed", cacheOption, output, sizeof(output));
+    tests_that_ran(output, ran, sizeof(ran));
+    ASSERT_STRING_EQUAL(ran, "order_failing_test ");
+    run_order_demo("--stop-early", cacheOption, output, sizeof(output));
+    tests_that_ran(output, ran, sizeof(ran));
+    ASSERT_STRING_EQUAL(ran, "order_first_test order_failing_test ");
+    unlink(cachePath);
+}
+
+/** With --capture, only the failing test of the order demo should print, under its failure. */
+TEST_CASE(capture_test) {
+    static char output[16384];
+    char ran[256];
+    run_order_demo("--capture", "--no-cache", output, sizeof(output));
+    tests_that_ran(output, ran, sizeof(ran));
+    ASSERT_STRING_EQUAL(ran, "order_failing_test ");
+    const char *failure = strstr(output, "order_failing_test(): ");
+    const char *printed = strstr(output, "ran order_failing_test");
+    ASSERT_TRUE(failure != NULL && printed > failure);
+}
+
+#endif
+
+/** Touching a fresh MiB faults in about 256 pages, which stays well within the budget. */
+TEST_CASE(page_faults_test) {
+    const size_t size = 1 << 20;
+    char *buffer = malloc(size);
+    REQUIRE_NOT_NULL(buffer);
+    memset(buffer, 1, size);
+    free(buffer);
+    ASSERT_MAX_PAGE_FAULTS(1024);
+    ASSERT_MAX_CONTEXT_SWITCHES(100);
+}
+
+/** Returns the index of a value in a sorted array with a binary search, or -1 if it's not there. */
+static int find_sorted(const int *values, const int length, const int value) {
+    int low = 0, high = length - 1;
+    while (low <= high) {
+        const int middle = low + (high - low) / 2;
+        if (values[middle] == value) {
+            return middle;
+        }
+        values[middle] < value ? (low = middle + 1) : (high = middle - 1);
+    }
+    return -1;
+}
+
+/** Looks up a different prime on each thread, as a stress operation. */
+static void lookup_primes(void *context, const int thread) {
+    static const int primes[] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37};
+    *((volatile int *)context + thread % 4) = find_sorted(primes, 12, primes[thread % 12]);
+}
+
+/** A lookup in a small table has to stay cheap, even in its slowest runs (and on many threads). */
+TEST_CASE(latency_test) {
+    static const int primes[] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37};
+    int found = 0;
+    ASSERT_DURATION_BELOW(LKP_DO_NOT_OPTIMIZE(find_sorted(primes, 12, 23)), 10000, 1000);
+    ASSERT_PERCENTILE_BELOW(
+        LKP_DO_NOT_OPTIMIZE(found = find_sorted(primes, 12, 4)), 99, 100000, 1000
+    );
+    ASSERT_INT_EQUAL(found, -1);
+
+    volatile int results[4] = {0};
+    ASSERT_STRESS_PERCENTILE_BELOW(lookup_primes, (void *)results, 4, 1000, 99, 1000000);
+}
+
+/** Sums an array, which only ever looks at each value once. */
+BENCHMARK_CASE(sum_benchmark, n) {
+    int *values = malloc(n * sizeof(int));
+    for (long long i = 0; i < n; i++) {
+        values[i] = (int)i;
+    }
+    MEASURE(
+        long long sum = 0;
+        for (long long i = 0; i < n; i++) {
+            sum += values[i];
+        }
+        LKP_DO_NOT_OPTIMIZE(sum);
+    );
+    free(values);
+}
+
+/** Sorts a reversed array with insertion sort, which is quadratic (expecting failure). */
+BENCHMARK_CASE(insertion_sort_benchmark, n) {
+    int *values = malloc(n * sizeof(int));
+    MEASURE(
+        for (long long i = 0; i < n; i++) {
+            values[i] = (int)(n - i);
+        }
+        for (long long i = 1; i < n; i++) {
+            const int value = values[i];
+            long long j = i - 1;
+            for (; j >= 0 && values[j] > value; j--) {
+                values[j + 1] = values[j];
+            }
+            values[j + 1] = value;
+        }
+        LKP_DO_NOT_OPTIMIZE(values);
+    );
+    free(values);
+}
+
 /** Main entrance point of Lukip unit testing. */
-int main() {
-    LUKIP_INIT();
+int main(int argc, char **argv) {
+    programPath = argv[0];
+#ifdef LKP_POSIX
+    if (getenv(ORDER_DEMO_ENV) != NULL) {
+        return order_demo(argc, argv);
+    }
+#endif
+    LUKIP_INIT_ARGS(argc, argv);
+    ADD_DEPENDENCY("src/lukip_assert.o");
     MAKE_SETUP(set_up2);
     MAKE_TEARDOWN(tear_down2);
 
@@ -102,9 +736,51 @@ int main() {
     TEST(empty_test);
     TEST(bytes_array_test);
     TEST(string_test);
+    TEST(fatal_test);
+    TEST_TIMEOUT(timeout_test, 100);
     TEST(empty_test);
     TEST(string_test2);
 
+    BEGIN_SUITE(TableFixture, table_setup, table_teardown);
+    MAKE_SUITE_FIXTURE(table_test_setup, NULL);
+    TEST_FIXTURE(table_lookup_test);
+    TEST_FIXTURE(table_lookup_test);
+    END_SUITE();
+
+    TEST_PROPERTY(reverse_twice_property, 100000);
+    TEST_PROPERTY(small_number_property, 1000);
+    TEST_FUZZ(parse_pair_fuzz);
+    EXHAUSTIVE_ALLOC_FAILURE(make_pair_test);
+    TEST(out_of_memory_test);
+    TEST(virtual_clock_test);
+    TEST(mock_test);
+    TEST(flaky_test);
+    TEST(cache_empty_test);
+    TEST(cache_fill_test);
+#ifdef LKP_POSIX
+    TEST(fake_files_test);
+    MAKE_FIXTURE(start_ping_server, stop_ping_server);
+    TEST(ping_test);
+    MAKE_FIXTURE(set_up2, tear_down2);
+    TEST(death_test);
+    TEST(leaky_test);
+    TEST(run_order_test);
+    TEST(capture_test);
+#endif
+    TEST(page_faults_test);
+    TEST(latency_test);
+    BENCHMARK_RANGE_AT_MOST(sum_benchmark, 4096, 262144, 2, LKP_O_N);
+    BENCHMARK_RANGE_AT_MOST(insertion_sort_benchmark, 128, 2048, 2, LKP_O_N_LOG_N);
+    TEST_DIFFERENTIAL(checksum_reference, checksum_unrolled, 100000);
+    TEST_PARAMS_CSV(square_row, "tests/data/squares.csv");
+
+    MAKE_ZYGOTE(zygote_setup, zygote_teardown);
+    TEST(zygote_test);
+    TEST(zygote_test);
+    TEST(crash_test);
+    TEST_TIMEOUT(timeout_test, 100);
+    DISABLE_ISOLATION();
+
     printf("Status code: %d (expecting failure).\n", LUKIP_STATUS());
     return 0;
 }
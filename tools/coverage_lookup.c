@@ -0,0 +1,377 @@
+/**
+ * @file coverage_lookup.c
+ * @brief Answers which tests covered a certain line, using the map from a coverage run.
+ * 
+ * Usage: lukip_coverage_lookup <coverage map> [file:line]
+ * Without a file:line, it lists how many blocks every test covered instead.
+ * 
+ * Covered blocks are found in the executable with objdump, and every instruction in them
+ * is resolved with addr2line, so both have to be installed, and the executable which made
+ * the map has to still be there (and built with -g).
+ * 
+ * @author Larmix
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/lukip_dynamic_array.h"
+
+#define LINE_LENGTH 4096 /** Longest text line read from the map (offsets are read separately). */
+#define ADDR2LINE_BATCH 256 /** Amount of addresses passed to one addr2line call. */
+#define ELF_TYPE_OFFSET 16 /** Where e_type is in an ELF header. */
+#define ELF_TYPE_DYNAMIC 3 /** ET_DYN, which position independent executables are. */
+
+/** Array of offsets into the executable. */
+LKP_DECLARE_DA_STRUCT(OffsetArray, uint64_t);
+
+/** A test from the map, and every offset it covered. */
+typedef struct {
+    char *name;
+    OffsetArray offsets;
+} CoveredTest;
+
+/** Array of every test in the map. */
+LKP_DECLARE_DA_STRUCT(CoveredTestArray, CoveredTest);
+
+/** An instruction of instrumented code, and the block it belongs to. */
+typedef struct {
+    uint64_t address;
+    uint64_t block; /** Offset of the block, the way the map records it. */
+    char *location;
+} Instruction;
+
+/** Array of instructions, in the order they're in the executable. */
+LKP_DECLARE_DA_STRUCT(InstructionArray, Instruction);
+
+/** Allocates a copy of a string. */
+static char *copy_string(const char *string) {
+    const size_t length = strlen(string) + 1;
+    char *copy = lkp_allocate((int)length, sizeof(char));
+    memcpy(copy, string, length);
+    return copy;
+}
+
+/** Allocates a string single quoted for the shell, where its own quotes become '\''. */
+static char *quote_argument(const char *string) {
+    size_t quotes = 0;
+    for (const char *c = string; *c != '\0'; c++) {
+        quotes += *c == '\'';
+    }
+    const size_t length = strlen(string) + quotes * 3 + 3;
+    char *quoted = lkp_allocate((int)length, sizeof(char));
+    char *end = quoted;
+    *end++ = '\'';
+    for (const char *c = string; *c != '\0'; c++) {
+        if (*c == '\'') {
+            memcpy(end, "'\\''", 4);
+            end += 4;
+        } else {
+            *end++ = *c;
+        }
+    }
+    *end++ = '\'';
+    *end = '\0';
+    return quoted;
+}
+
+/** Returns whether the executable is position independent, by reading its ELF header. */
+static bool is_position_independent(const char *exePath) {
+    FILE *exe = fopen(exePath, "rb");
+    if (exe == NULL) {
+        return true;
+    }
+    unsigned char header[ELF_TYPE_OFFSET + 2];
+    const bool read = fread(header, 1, sizeof(header), exe) == sizeof(header);
+    fclose(exe);
+    return !read || header[ELF_TYPE_OFFSET] == ELF_TYPE_DYNAMIC;
+}
+
+/** Reads the offsets line of a test, which can be arbitrarily long. */
+static void read_offsets(FILE *map, OffsetArray *offsets) {
+    uint64_t offset;
+    int next;
+    while (fscanf(map, "%" SCNx64, &offset) == 1) {
+        LKP_APPEND_DA(offsets, offset);
+        while ((next = fgetc(map)) == ' ') {
+        }
+        if (next == '\n' || next == EOF) {
+            return;
+        }
+        ungetc(next, map);
+    }
+    while ((next = fgetc(map)) != '\n' && next != EOF) {
+    }
+}
+
+/** Loads the map's header and tests, returning false if it isn't a valid map. */
+static bool load_map(
+    const char *path, char *exePath, uint64_t *base, CoveredTestArray *tests
+) {
+    FILE *map = fopen(path, "r");
+    if (map == NULL) {
+        return false;
+    }
+    char line[LINE_LENGTH];
+    if (fscanf(map, "exe %4095[^\n]\nbase %" SCNx64 "\n", exePath, base) != 2) {
+        fclose(map);
+        return false;
+    }
+    while (fgets(line, LINE_LENGTH, map) != NULL) {
+        if (strncmp(line, "test ", 5) != 0) {
+            continue;
+        }
+        line[strcspn(line, "\n")] = '\0';
+        char *tab = strchr(line, '\t');
+        CoveredTest test = {.name = copy_string(tab == NULL ? line + 5 : tab + 1)};
+        LKP_INIT_DA(&test.offsets);
+        read_offsets(map, &test.offsets);
+        LKP_APPEND_DA(tests, test);
+    }
+    fclose(map);
+    return true;
+}
+
+/** Sorts offsets for qsort and bsearch. */
+static int compare_offsets(const void *left, const void *right) {
+    const uint64_t leftOffset = *(const uint64_t *)left;
+    const uint64_t rightOffset = *(const uint64_t *)right;
+    return leftOffset < rightOffset ? -1 : leftOffset > rightOffset;
+}
+
+/** Sorts offsets and drops the repeated ones. */
+static void sort_unique(OffsetArray *offsets) {
+    if (offsets->length == 0) {
+        return;
+    }
+    qsort(offsets->data, offsets->length, sizeof(uint64_t), compare_offsets);
+    int unique = 1;
+    for (int i = 1; i < offsets->length; i++) {
+        if (offsets->data[i] != offsets->data[unique - 1]) {
+            offsets->data[unique++] = offsets->data[i];
+        }
+    }
+    offsets->length = unique;
+}
+
+/** Returns whether a sorted array has an offset. */
+static bool has_offset(const OffsetArray *offsets, const uint64_t offset) {
+    return offsets->length > 0 && bsearch(
+        &offset, offsets->data, offsets->length, sizeof(uint64_t), compare_offsets
+    ) != NULL;
+}
+
+/** Returns whether a resolved "path:line" is the queried file and line. */
+static bool matches_location(const char *location, const char *file, const int line) {
+    const char *colon = strrchr(location, ':');
+    if (colon == NULL || atoi(colon + 1) != line) {
+        return false;
+    }
+    const size_t pathLength = colon - location;
+    const size_t fileLength = strlen(file);
+    if (pathLength < fileLength) {
+        return false;
+    }
+    // Compilers usually record absolute paths, so compare the end of it.
+    const char *pathEnd = location + pathLength - fileLength;
+    if (strncmp(pathEnd, file, fileLength) != 0) {
+        return false;
+    }
+    return pathEnd == location || pathEnd[-1] == '/';
+}
+
+/** Runs addr2line on a batch of instructions and stores the "file:line" it gives for each. */
+static void resolve_batch(const char *exePath, Instruction *batch, const int length) {
+    char *quotedPath = quote_argument(exePath);
+    const size_t commandLength = strlen(quotedPath) + 32 + (size_t)length * 20;
+    char *command = lkp_allocate((int)commandLength, sizeof(char));
+    int written = snprintf(command, commandLength, "addr2line -e %s", quotedPath);
+    free(quotedPath);
+    for (int i = 0; i < length; i++) {
+        written += snprintf(
+            command + written, commandLength - written, " 0x%" PRIx64, batch[i].address
+        );
+    }
+    FILE *output = popen(command, "r");
+    free(command);
+    if (output == NULL) {
+        return;
+    }
+    char line[LINE_LENGTH];
+    for (int i = 0; i < length && fgets(line, LINE_LENGTH, output) != NULL; i++) {
+        line[strcspn(line, " \n")] = '\0'; // Drops " (discriminator N)".
+        batch[i].location = copy_string(line);
+    }
+    pclose(output);
+}
+
+/**
+ * @brief Gives each instruction of a function the block it runs in, keeping the covered ones.
+ * 
+ * A block starts at its call to __sanitizer_cov_trace_pc() and goes on until the next one,
+ * where the map has the address right after the call. The instructions of the function's
+ * prologue, before its first call, run along with the first block.
+ */
+static void assign_blocks(
+    const InstructionArray *function, const OffsetArray *calls, const uint64_t addressBase,
+    const OffsetArray *covered, InstructionArray *instructions
+) {
+    uint64_t block = 0;
+    for (int i = 0; i + 1 < function->length && block == 0; i++) {
+        if (has_offset(calls, function->data[i].address)) {
+            block = function->data[i + 1].address - addressBase;
+        }
+    }
+    for (int i = 0; i < function->length; i++) {
+        if (i + 1 < function->length && has_offset(calls, function->data[i].address)) {
+            block = function->data[i + 1].address - addressBase;
+        }
+        if (block != 0 && has_offset(covered, block)) {
+            Instruction instruction = function->data[i];
+            instruction.block = block;
+            LKP_APPEND_DA(instructions, instruction);
+        }
+    }
+}
+
+/** Disassembles the executable, and keeps every instruction of the covered blocks. */
+static void find_instructions(
+    const char *exePath, const uint64_t addressBase, const OffsetArray *covered,
+    InstructionArray *instructions
+) {
+    char *quotedPath = quote_argument(exePath);
+    const size_t commandLength = strlen(quotedPath) + 48;
+    char *command = lkp_allocate((int)commandLength, sizeof(char));
+    snprintf(command, commandLength, "objdump -d --no-show-raw-insn %s", quotedPath);
+    free(quotedPath);
+    FILE *output = popen(command, "r");
+    free(command);
+    if (output == NULL) {
+        return;
+    }
+    InstructionArray function;
+    LKP_INIT_DA(&function);
+    OffsetArray calls;
+    LKP_INIT_DA(&calls);
+    char line[LINE_LENGTH];
+    while (fgets(line, LINE_LENGTH, output) != NULL) {
+        uint64_t address;
+        char *end;
+        if (line[0] != ' ') {
+            // Anything that isn't an instruction (like "<address> <function>:") ends a function.
+            assign_blocks(&function, &calls, addressBase, covered, instructions);
+            function.length = 0;
+            calls.length = 0;
+            continue;
+        }
+        address = strtoull(line, &end, 16);
+        if (end == line || *end != ':') {
+            continue;
+        }
+        const Instruction instruction = {.address = address, .block = 0, .location = NULL};
+        LKP_APPEND_DA(&function, instruction);
+        if (strstr(end, "call") != NULL && strstr(end, "<__sanitizer_cov_trace_pc") != NULL) {
+            LKP_APPEND_DA(&calls, address);
+        }
+    }
+    assign_blocks(&function, &calls, addressBase, covered, instructions);
+    pclose(output);
+    LKP_FREE_DA(&function);
+    LKP_FREE_DA(&calls);
+}
+
+/**
+ * @brief Finds the blocks which have an instruction from the queried line.
+ * 
+ * A line can be spread over many blocks (like a loop's condition) and a block over many lines,
+ * so every instruction of every covered block gets resolved, not only where the block starts.
+ */
+static void find_line_blocks(
+    const CoveredTestArray *tests, const char *exePath, const uint64_t base, const char *file,
+    const int line, OffsetArray *lineBlocks
+) {
+    OffsetArray covered;
+    LKP_INIT_DA(&covered);
+    for (int i = 0; i < tests->length; i++) {
+        for (int j = 0; j < tests->data[i].offsets.length; j++) {
+            LKP_APPEND_DA(&covered, tests->data[i].offsets.data[j]);
+        }
+    }
+    sort_unique(&covered);
+
+    // Position independent executables are linked at 0, so offsets are already addresses.
+    const uint64_t addressBase = is_position_independent(exePath) ? 0 : base;
+    InstructionArray instructions;
+    LKP_INIT_DA(&instructions);
+    find_instructions(exePath, addressBase, &covered, &instructions);
+    for (int i = 0; i < instructions.length; i += ADDR2LINE_BATCH) {
+        const int remaining = instructions.length - i;
+        const int length = remaining < ADDR2LINE_BATCH ? remaining : ADDR2LINE_BATCH;
+        resolve_batch(exePath, instructions.data + i, length);
+    }
+    for (int i = 0; i < instructions.length; i++) {
+        const char *location = instructions.data[i].location;
+        if (location != NULL && matches_location(location, file, line)) {
+            LKP_APPEND_DA(lineBlocks, instructions.data[i].block);
+        }
+    }
+    sort_unique(lineBlocks);
+    LKP_FREE_DA(&covered);
+}
+
+/** Returns whether any of the test's offsets is one of the queried line's blocks. */
+static bool test_covers(const CoveredTest *test, const OffsetArray *lineBlocks) {
+    for (int i = 0; i < test->offsets.length; i++) {
+        if (has_offset(lineBlocks, test->offsets.data[i])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/** Loads the map and prints the tests covering the queried line (or a summary without one). */
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <coverage map> [file:line]\n", argv[0]);
+        return 2;
+    }
+    char exePath[LINE_LENGTH];
+    uint64_t base;
+    CoveredTestArray tests;
+    LKP_INIT_DA(&tests);
+    if (!load_map(argv[1], exePath, &base, &tests)) {
+        fprintf(stderr, "Couldn't read coverage map \"%s\".\n", argv[1]);
+        return 1;
+    }
+    if (argc < 3) {
+        for (int i = 0; i < tests.length; i++) {
+            printf("%s: %d blocks\n", tests.data[i].name, tests.data[i].offsets.length);
+        }
+        return 0;
+    }
+
+    char *query = copy_string(argv[2]);
+    char *colon = strrchr(query, ':');
+    if (colon == NULL) {
+        fprintf(stderr, "Expected file:line, got \"%s\".\n", argv[2]);
+        return 2;
+    }
+    *colon = '\0';
+    const int line = atoi(colon + 1);
+
+    OffsetArray lineBlocks;
+    LKP_INIT_DA(&lineBlocks);
+    find_line_blocks(&tests, exePath, base, query, line, &lineBlocks);
+    int found = 0;
+    for (int i = 0; i < tests.length; i++) {
+        if (test_covers(&tests.data[i], &lineBlocks)) {
+            printf("%s\n", tests.data[i].name);
+            found++;
+        }
+    }
+    return found > 0 ? 0 : 1;
+}